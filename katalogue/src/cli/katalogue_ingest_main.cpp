@@ -0,0 +1,146 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <cstdio>
+
+#include "katalogue_database.h"
+#include "katalogue_ingest.h"
+#include "katalogue_version.h"
+
+namespace {
+struct Options {
+    VolumeInfo volume;
+    IngestOptions ingest;
+    bool quiet = false;
+    QString catalogPath;
+    QString inputPath;
+};
+
+void printUsage(QTextStream &out) {
+    out << "Usage: katalogue-ingest [OPTIONS] <catalog-file> [<inventory-file>|-]\n"
+           "Adds a file inventory to the catalog as a new volume without reading the\n"
+           "files it lists. Records are path, size, mtime and type separated by tabs:\n"
+           "  find ROOT -printf '%P\\t%s\\t%T@\\t%y\\0' | katalogue-ingest catalog.kdcatalog\n"
+           "Options:\n"
+           "  --label <label>                Volume label (default: Inventory)\n"
+           "  --description <text>           Volume description\n"
+           "  --physical-hint <text>         Where the inventoried tree lives\n"
+           "  --lines                        Records end with newlines instead of NULs\n"
+           "  --strip-prefix <path>          Drop this prefix from every path (for %p)\n"
+           "  --quiet                        No progress output\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+
+    Options options;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString arg = args.at(i);
+        if (arg == QStringLiteral("--help") || arg == QStringLiteral("-h")) {
+            printUsage(err);
+            return 0;
+        }
+        if (arg == QStringLiteral("--version")) {
+            QTextStream out(stdout);
+            out << "Katalogue ingest tool " << KATALOGUE_VERSION_STRING << Qt::endl;
+            return 0;
+        }
+        if (arg == QStringLiteral("--label") && i + 1 < args.size()) {
+            options.volume.label = args.at(++i);
+            continue;
+        }
+        if (arg == QStringLiteral("--description") && i + 1 < args.size()) {
+            options.volume.description = args.at(++i);
+            continue;
+        }
+        if (arg == QStringLiteral("--physical-hint") && i + 1 < args.size()) {
+            options.volume.physicalHint = args.at(++i);
+            continue;
+        }
+        if (arg == QStringLiteral("--lines")) {
+            options.ingest.separator = '\n';
+            continue;
+        }
+        if (arg == QStringLiteral("--strip-prefix") && i + 1 < args.size()) {
+            options.ingest.stripPrefix = args.at(++i);
+            continue;
+        }
+        if (arg == QStringLiteral("--quiet")) {
+            options.quiet = true;
+            continue;
+        }
+        if (arg.startsWith(QStringLiteral("--"))) {
+            err << "Unknown option: " << arg << '\n';
+            printUsage(err);
+            return 1;
+        }
+        if (options.catalogPath.isEmpty()) {
+            options.catalogPath = arg;
+        } else if (options.inputPath.isEmpty()) {
+            options.inputPath = arg;
+        } else {
+            err << "Unexpected argument: " << arg << '\n';
+            printUsage(err);
+            return 1;
+        }
+    }
+
+    if (options.catalogPath.isEmpty()) {
+        err << "Missing catalog file path.\n";
+        printUsage(err);
+        return 1;
+    }
+
+    QFile input;
+    bool opened = false;
+    if (options.inputPath.isEmpty() || options.inputPath == QStringLiteral("-")) {
+        opened = input.open(stdin, QIODevice::ReadOnly);
+    } else {
+        input.setFileName(options.inputPath);
+        opened = input.open(QIODevice::ReadOnly);
+    }
+    if (!opened) {
+        err << "Failed to open inventory: " << options.inputPath << '\n';
+        return 1;
+    }
+
+    KatalogueDatabase db;
+    if (!db.openProject(options.catalogPath)) {
+        err << "Failed to open catalog: " << options.catalogPath << '\n';
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    auto progress = [&err, &options](const IngestStats &stats) {
+        if (!options.quiet) {
+            err << "\r" << stats.records << " records, " << stats.files << " files, " << stats.directories
+                << " directories" << Qt::flush;
+        }
+        return true;
+    };
+
+    InventoryIngester ingester;
+    const bool ok = ingester.ingest(input, db, options.volume, options.ingest, progress);
+    const IngestStats &stats = ingester.stats();
+    if (!options.quiet) {
+        err << '\n';
+    }
+    if (!ok) {
+        err << "Ingest failed after " << stats.records << " records: " << db.lastErrorString() << '\n';
+        return 1;
+    }
+    if (!options.quiet) {
+        err << "Volume " << ingester.lastVolumeId() << ": " << stats.files << " files, " << stats.directories
+            << " directories, " << stats.totalBytes << " bytes in " << timer.elapsed() << " ms";
+        if (stats.skipped > 0) {
+            err << " (" << stats.skipped << " records skipped)";
+        }
+        err << '\n';
+    }
+    return 0;
+}
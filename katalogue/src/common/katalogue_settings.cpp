@@ -2,6 +2,8 @@
 
 #include <QSettings>
 
+#include "katalogue_device.h"
+
 namespace {
 QSettings &settings() {
     static QSettings s(QSettings::IniFormat,
@@ -51,6 +53,132 @@ void KatalogueSettings::setScannerMaxDepth(int depth) {
     emit scannerSettingsChanged();
 }
 
+int KatalogueSettings::scannerWorkerThreads() const {
+    return settings().value(QStringLiteral("scanner/workerThreads"), 0).toInt();
+}
+
+void KatalogueSettings::setScannerWorkerThreads(int count) {
+    settings().setValue(QStringLiteral("scanner/workerThreads"), count);
+    emit scannerSettingsChanged();
+}
+
+bool KatalogueSettings::scannerIoUring() const {
+    return settings().value(QStringLiteral("scanner/ioUring"), false).toBool();
+}
+
+void KatalogueSettings::setScannerIoUring(bool value) {
+    settings().setValue(QStringLiteral("scanner/ioUring"), value);
+    emit scannerSettingsChanged();
+}
+
+bool KatalogueSettings::scannerIncrementalRescan() const {
+    return settings().value(QStringLiteral("scanner/incrementalRescan"), true).toBool();
+}
+
+void KatalogueSettings::setScannerIncrementalRescan(bool value) {
+    settings().setValue(QStringLiteral("scanner/incrementalRescan"), value);
+    emit scannerSettingsChanged();
+}
+
+bool KatalogueSettings::scannerQuickRescan() const {
+    return settings().value(QStringLiteral("scanner/quickRescan"), false).toBool();
+}
+
+void KatalogueSettings::setScannerQuickRescan(bool value) {
+    settings().setValue(QStringLiteral("scanner/quickRescan"), value);
+    emit scannerSettingsChanged();
+}
+
+QString KatalogueSettings::scannerHashAlgorithm() const {
+    return settings().value(QStringLiteral("scanner/hashAlgorithm"), QStringLiteral("xxh64")).toString();
+}
+
+void KatalogueSettings::setScannerHashAlgorithm(const QString &algorithm) {
+    settings().setValue(QStringLiteral("scanner/hashAlgorithm"), algorithm);
+    emit scannerSettingsChanged();
+}
+
+QString KatalogueSettings::scannerHashMode() const {
+    return settings().value(QStringLiteral("scanner/hashMode"), QStringLiteral("full")).toString();
+}
+
+void KatalogueSettings::setScannerHashMode(const QString &mode) {
+    settings().setValue(QStringLiteral("scanner/hashMode"), mode);
+    emit scannerSettingsChanged();
+}
+
+QString KatalogueSettings::scannerMimeDetection() const {
+    return settings().value(QStringLiteral("scanner/mimeDetection"), QStringLiteral("auto")).toString();
+}
+
+void KatalogueSettings::setScannerMimeDetection(const QString &mode) {
+    settings().setValue(QStringLiteral("scanner/mimeDetection"), mode);
+    emit scannerSettingsChanged();
+}
+
+QString KatalogueSettings::scannerTraversalOrder() const {
+    return settings().value(QStringLiteral("scanner/traversalOrder"), QStringLiteral("auto")).toString();
+}
+
+void KatalogueSettings::setScannerTraversalOrder(const QString &order) {
+    settings().setValue(QStringLiteral("scanner/traversalOrder"), order);
+    emit scannerSettingsChanged();
+}
+
+int KatalogueSettings::scannerSlowDirectoryCount() const {
+    return settings().value(QStringLiteral("scanner/slowDirectoryCount"), 0).toInt();
+}
+
+void KatalogueSettings::setScannerSlowDirectoryCount(int count) {
+    settings().setValue(QStringLiteral("scanner/slowDirectoryCount"), count);
+    emit scannerSettingsChanged();
+}
+
+bool KatalogueSettings::scannerOneFileSystem() const {
+    return settings().value(QStringLiteral("scanner/oneFileSystem"), false).toBool();
+}
+
+void KatalogueSettings::setScannerOneFileSystem(bool value) {
+    settings().setValue(QStringLiteral("scanner/oneFileSystem"), value);
+    emit scannerSettingsChanged();
+}
+
+QStringList KatalogueSettings::scannerSkipFilesystemTypes() const {
+    return settings()
+        .value(QStringLiteral("scanner/skipFilesystemTypes"), defaultSkippedFilesystemTypes())
+        .toStringList();
+}
+
+void KatalogueSettings::setScannerSkipFilesystemTypes(const QStringList &types) {
+    settings().setValue(QStringLiteral("scanner/skipFilesystemTypes"), types);
+    emit scannerSettingsChanged();
+}
+
+int KatalogueSettings::watcherSettleMs() const {
+    return settings().value(QStringLiteral("watcher/settleMs"), 1000).toInt();
+}
+
+void KatalogueSettings::setWatcherSettleMs(int milliseconds) {
+    settings().setValue(QStringLiteral("watcher/settleMs"), milliseconds);
+    emit scannerSettingsChanged();
+}
+
+int KatalogueSettings::databaseReaderThreads() const {
+    return settings().value(QStringLiteral("database/readerThreads"), 4).toInt();
+}
+
+void KatalogueSettings::setDatabaseReaderThreads(int count) {
+    settings().setValue(QStringLiteral("database/readerThreads"), count);
+}
+
+bool KatalogueSettings::databaseSubstringIndex() const {
+    return settings().value(QStringLiteral("database/substringIndex"), false).toBool();
+}
+
+void KatalogueSettings::setDatabaseSubstringIndex(bool enabled) {
+    settings().setValue(QStringLiteral("database/substringIndex"), enabled);
+}
+
 QStringList KatalogueSettings::scannerExcludePatterns() const {
     return settings().value(QStringLiteral("scanner/excludePatterns"), QStringList()).toStringList();
 }
@@ -21,6 +21,39 @@ public:
     int scannerMaxDepth() const;
     void setScannerMaxDepth(int depth);
 
+    int scannerWorkerThreads() const;
+    void setScannerWorkerThreads(int count);
+    bool scannerIoUring() const;
+    void setScannerIoUring(bool value);
+    bool scannerIncrementalRescan() const;
+    void setScannerIncrementalRescan(bool value);
+    bool scannerQuickRescan() const;
+    void setScannerQuickRescan(bool value);
+    QString scannerHashAlgorithm() const;
+    void setScannerHashAlgorithm(const QString &algorithm);
+    QString scannerHashMode() const;
+    void setScannerHashMode(const QString &mode);
+    QString scannerMimeDetection() const;
+    void setScannerMimeDetection(const QString &mode);
+    QString scannerTraversalOrder() const;
+    void setScannerTraversalOrder(const QString &order);
+    int scannerSlowDirectoryCount() const;
+    void setScannerSlowDirectoryCount(int count);
+    bool scannerOneFileSystem() const;
+    void setScannerOneFileSystem(bool value);
+    QStringList scannerSkipFilesystemTypes() const;
+    void setScannerSkipFilesystemTypes(const QStringList &types);
+    int watcherSettleMs() const;
+    void setWatcherSettleMs(int milliseconds);
+    // Threads (each with its own catalog connection) serving the daemon's
+    // browse and search calls; read at startup.
+    int databaseReaderThreads() const;
+    void setDatabaseReaderThreads(int count);
+    // Whether catalogs created by the daemon get the trigram file name
+    // index; existing catalogs keep theirs (see SetSubstringIndex).
+    bool databaseSubstringIndex() const;
+    void setDatabaseSubstringIndex(bool enabled);
+
     QStringList scannerExcludePatterns() const;
     void setScannerExcludePatterns(const QStringList &patterns);
 
@@ -1,15 +1,27 @@
 #include "katalogue_database.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <utility>
+#include <vector>
+
 #include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
+#include <QHash>
 #include <QList>
+#include <QRegularExpression>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QThread>
 #include <QVariant>
 #include <QDebug>
 
 namespace {
-constexpr int CURRENT_SCHEMA_VERSION = 3;
+constexpr int CURRENT_SCHEMA_VERSION = 10;
 
 bool execStatements(QSqlDatabase &db, const QList<QString> &statements) {
     QSqlQuery query(db);
@@ -50,6 +62,63 @@ bool tableExists(const QSqlDatabase &db, const QString &name) {
     return query.next();
 }
 
+// Expects the columns id, volume_id, parent_id, name, full_path, mtime, inode.
+DirectoryInfo directoryFromQuery(const QSqlQuery &query) {
+    DirectoryInfo info;
+    info.id = query.value(0).toInt();
+    info.volumeId = query.value(1).toInt();
+    info.parentId = query.value(2).isNull() ? -1 : query.value(2).toInt();
+    info.name = query.value(3).toString();
+    info.fullPath = query.value(4).toString();
+    if (!query.value(5).isNull()) {
+        info.mtime = QDateTime::fromSecsSinceEpoch(query.value(5).toLongLong(), Qt::UTC);
+    }
+    info.inode = static_cast<quint64>(query.value(6).toLongLong());
+    return info;
+}
+
+// Expects the columns id, directory_id, name, size, mtime, ctime, file_type,
+// hash, attrs, fingerprint, inode, link_count; fullPath is left to the caller.
+FileInfo fileFromQuery(const QSqlQuery &query) {
+    FileInfo info;
+    info.id = query.value(0).toInt();
+    info.directoryId = query.value(1).toInt();
+    info.name = query.value(2).toString();
+    info.size = query.value(3).toLongLong();
+    if (!query.value(4).isNull()) {
+        info.mtime = QDateTime::fromSecsSinceEpoch(query.value(4).toLongLong(), Qt::UTC);
+    }
+    if (!query.value(5).isNull()) {
+        info.ctime = QDateTime::fromSecsSinceEpoch(query.value(5).toLongLong(), Qt::UTC);
+    }
+    info.fileType = query.value(6).toString();
+    info.hash = query.value(7).toString();
+    info.attrs = static_cast<quint32>(query.value(8).toUInt());
+    info.fingerprint = query.value(9).toString();
+    info.inode = static_cast<quint64>(query.value(10).toLongLong());
+    info.linkCount = query.value(11).toUInt();
+    return info;
+}
+
+// Unknown stat fields (0) are stored as NULL.
+QVariant integerOrNull(quint64 value) {
+    return value > 0 ? QVariant(static_cast<qint64>(value)) : QVariant(QVariant::LongLong);
+}
+
+// Rows per multi-row INSERT; keeps the widest one (files, 11 columns) under
+// the 999 bound parameters older SQLite builds allow.
+constexpr qsizetype bulkRowsPerStatement = 64;
+
+// "(?, ?), (?, ?), ..." for rows rows of columns columns.
+QString valuesPlaceholders(qsizetype rows, int columns) {
+    const QString row = QLatin1Char('(') + QStringLiteral("?, ").repeated(columns - 1) + QStringLiteral("?)");
+    return QStringList(rows, row).join(QStringLiteral(", "));
+}
+
+QVariant secsOrNull(const QDateTime &time) {
+    return time.isValid() ? QVariant(time.toSecsSinceEpoch()) : QVariant(QVariant::LongLong);
+}
+
 bool setSchemaInfoVersion(QSqlDatabase &db, int version) {
     QSqlQuery query(db);
     if (!query.exec(QStringLiteral(
@@ -70,9 +139,115 @@ bool setSchemaInfoVersion(QSqlDatabase &db, int version) {
 }
 } // namespace
 
+// Ticket lock around batch transactions, shared by every connection to one
+// catalog file. SQLite's busy handler only polls, so a writer that commits
+// and immediately begins its next batch would keep winning the file lock.
+class CatalogWriteTurns {
+public:
+    static std::shared_ptr<CatalogWriteTurns> forPath(const QString &path) {
+        static std::mutex registryMutex;
+        static QHash<QString, std::weak_ptr<CatalogWriteTurns>> registry;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto turns = registry.value(path).lock();
+        if (!turns) {
+            turns = std::make_shared<CatalogWriteTurns>();
+            registry.insert(path, turns);
+        }
+        return turns;
+    }
+
+    void acquire() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const quint64 ticket = m_nextTicket++;
+        m_turnChanged.wait(lock, [this, ticket]() { return m_serving == ticket; });
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_serving;
+        }
+        m_turnChanged.notify_all();
+    }
+
+    // Whether a connection is queued behind the turn being served.
+    bool hasWaiters() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_nextTicket > m_serving + 1;
+    }
+
+    // Bumped by writers that add or drop optional tables, so connections
+    // can cache what they found.
+    void schemaChanged() { m_schemaGeneration.fetch_add(1, std::memory_order_relaxed); }
+    quint64 schemaGeneration() const { return m_schemaGeneration.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_turnChanged;
+    quint64 m_nextTicket = 0;
+    quint64 m_serving = 0;
+    std::atomic<quint64> m_schemaGeneration{0};
+};
+
+// Read-only connections to one catalog, one per thread that queries a
+// KatalogueDatabase it did not open (QSqlDatabase connections must stay on
+// the thread that created them). A connection is dropped when its thread
+// finishes; the rest go with the pool.
+class CatalogReaders {
+public:
+    CatalogReaders(const QString &path, const QString &connectionPrefix)
+        : m_path(path)
+        , m_connectionPrefix(connectionPrefix) {}
+
+    ~CatalogReaders() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Removing the last handle closes the connection, from any thread.
+        for (const QString &name : std::as_const(m_connections)) {
+            QSqlDatabase::removeDatabase(name);
+        }
+    }
+
+    QSqlDatabase forCurrentThread() {
+        QThread *thread = QThread::currentThread();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const QString known = m_connections.value(thread);
+        if (!known.isEmpty()) {
+            return QSqlDatabase::database(known, false);
+        }
+
+        const QString name = QStringLiteral("%1_reader_%2").arg(m_connectionPrefix).arg(++m_opened);
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), name);
+        db.setDatabaseName(m_path);
+        db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=30000"));
+        if (!db.open()) {
+            qWarning() << "Failed to open catalog reader" << db.lastError();
+        }
+        m_connections.insert(thread, name);
+        QObject::connect(thread, &QThread::finished, &m_context, [this, thread]() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            QSqlDatabase::removeDatabase(m_connections.take(thread));
+        }, Qt::DirectConnection);
+        return db;
+    }
+
+private:
+    const QString m_path;
+    const QString m_connectionPrefix;
+    std::mutex m_mutex;
+    QHash<QThread *, QString> m_connections;
+    int m_opened = 0;
+    // Disconnects the thread-finished handlers when the pool goes away.
+    QObject m_context;
+};
+
 KatalogueDatabase::KatalogueDatabase() = default;
 
 KatalogueDatabase::~KatalogueDatabase() {
+    if (m_inBatch) {
+        endBatch();
+    }
+    m_readers.reset();
+    m_statements.clear();
     if (m_db.isOpen()) {
         m_db.close();
     }
@@ -82,6 +257,12 @@ KatalogueDatabase::~KatalogueDatabase() {
 }
 
 bool KatalogueDatabase::openProject(const QString &path) {
+    if (m_inBatch) {
+        endBatch();
+    }
+    m_readers.reset();
+    m_statements.clear();
+    m_substringIndex.store(-1, std::memory_order_relaxed);
     if (m_db.isOpen()) {
         m_db.close();
     }
@@ -99,6 +280,10 @@ bool KatalogueDatabase::openProject(const QString &path) {
     }
 
     m_db.setDatabaseName(path);
+    // Several scans may write the catalog at once, each through its own
+    // connection; wait for the write lock instead of failing right away.
+    m_db.setConnectOptions(QStringLiteral("QSQLITE_BUSY_TIMEOUT=30000"));
+    m_writeTurns = CatalogWriteTurns::forPath(QFileInfo(path).absoluteFilePath());
     if (!m_db.open()) {
         qWarning() << "Failed to open database" << m_db.lastError();
         m_lastErrorString = m_db.lastError().text();
@@ -109,6 +294,16 @@ bool KatalogueDatabase::openProject(const QString &path) {
     if (!pragma.exec(QStringLiteral("PRAGMA foreign_keys = ON"))) {
         qWarning() << "Failed to enable foreign keys" << pragma.lastError();
     }
+    // Readers then work from the last commit while a scan batch is open,
+    // and commits append to the log instead of rewriting pages in place.
+    // Network filesystems without shared memory stay in rollback mode.
+    const bool memory = path == QLatin1String(":memory:");
+    if (!memory && (!pragma.exec(QStringLiteral("PRAGMA journal_mode = WAL")) || !pragma.next()
+                    || pragma.value(0).toString() != QLatin1String("wal"))) {
+        qWarning() << "Catalog stays in rollback journal mode" << pragma.lastError();
+    } else if (!memory && !pragma.exec(QStringLiteral("PRAGMA synchronous = NORMAL"))) {
+        qWarning() << "Failed to relax catalog syncs" << pragma.lastError();
+    }
 
     if (!tableExists(m_db, QStringLiteral("schema_info"))) {
         if (!initializeSchema()) {
@@ -116,6 +311,13 @@ bool KatalogueDatabase::openProject(const QString &path) {
             m_db.close();
             return false;
         }
+    } else {
+        const int version = schemaVersion();
+        if (version > 0 && version < CURRENT_SCHEMA_VERSION && !initializeSchema()) {
+            m_lastErrorString = QStringLiteral("Failed to migrate catalog schema");
+            m_db.close();
+            return false;
+        }
     }
 
     const auto status = checkSchema();
@@ -127,6 +329,10 @@ bool KatalogueDatabase::openProject(const QString &path) {
         return false;
     }
 
+    m_writerThread = QThread::currentThread();
+    if (!memory) {
+        m_readers = std::make_unique<CatalogReaders>(path, m_connectionName);
+    }
     return true;
 }
 
@@ -320,6 +526,220 @@ bool KatalogueDatabase::initializeSchema() {
         version = 3;
     }
 
+    if (version == 3) {
+        const QList<QString> schemaStatements = {
+            QStringLiteral("ALTER TABLE directories ADD COLUMN mtime INTEGER;"),
+            QStringLiteral("ALTER TABLE directories ADD COLUMN inode INTEGER;")
+        };
+
+        if (!execStatements(m_db, schemaStatements)) {
+            m_db.rollback();
+            return false;
+        }
+
+        if (!setSchemaVersion(m_db, 4)) {
+            m_db.rollback();
+            return false;
+        }
+        version = 4;
+    }
+
+    if (version == 4) {
+        const QList<QString> schemaStatements = {
+            QStringLiteral("ALTER TABLE files ADD COLUMN fingerprint TEXT;"),
+            QStringLiteral(
+                "CREATE INDEX IF NOT EXISTS files_fingerprint_idx "
+                "ON files(fingerprint) WHERE fingerprint IS NOT NULL AND fingerprint <> '';")
+        };
+
+        if (!execStatements(m_db, schemaStatements)) {
+            m_db.rollback();
+            return false;
+        }
+
+        if (!setSchemaVersion(m_db, 5)) {
+            m_db.rollback();
+            return false;
+        }
+        version = 5;
+    }
+
+    if (version == 5) {
+        const QList<QString> schemaStatements = {
+            QStringLiteral(
+                "CREATE TABLE IF NOT EXISTS scan_checkpoints ("
+                "volume_id INTEGER PRIMARY KEY REFERENCES volumes(id) ON DELETE CASCADE,"
+                "root_path TEXT NOT NULL,"
+                "directories INTEGER NOT NULL DEFAULT 0,"
+                "files INTEGER NOT NULL DEFAULT 0,"
+                "total_bytes INTEGER NOT NULL DEFAULT 0,"
+                "updated_at INTEGER"
+                ");"),
+            QStringLiteral(
+                "CREATE TABLE IF NOT EXISTS scan_checkpoint_directories ("
+                "directory_id INTEGER PRIMARY KEY REFERENCES directories(id) ON DELETE CASCADE,"
+                "volume_id INTEGER NOT NULL REFERENCES scan_checkpoints(volume_id) ON DELETE CASCADE,"
+                "depth INTEGER NOT NULL"
+                ");"),
+            QStringLiteral(
+                "CREATE INDEX IF NOT EXISTS scan_checkpoint_directories_volume_idx "
+                "ON scan_checkpoint_directories(volume_id);")
+        };
+
+        if (!execStatements(m_db, schemaStatements)) {
+            m_db.rollback();
+            return false;
+        }
+
+        if (!setSchemaVersion(m_db, 6)) {
+            m_db.rollback();
+            return false;
+        }
+        version = 6;
+    }
+
+    if (version == 6) {
+        const QList<QString> schemaStatements = {
+            QStringLiteral("ALTER TABLE files ADD COLUMN inode INTEGER;"),
+            QStringLiteral("ALTER TABLE files ADD COLUMN link_count INTEGER;"),
+            QStringLiteral("ALTER TABLE scan_checkpoints ADD COLUMN unique_bytes INTEGER NOT NULL DEFAULT 0;"),
+            QStringLiteral(
+                "CREATE INDEX IF NOT EXISTS files_hardlink_idx "
+                "ON files(inode) WHERE link_count > 1;")
+        };
+
+        if (!execStatements(m_db, schemaStatements)) {
+            m_db.rollback();
+            return false;
+        }
+
+        if (!setSchemaVersion(m_db, 7)) {
+            m_db.rollback();
+            return false;
+        }
+        version = 7;
+    }
+
+    // Version 8 was a first take on deferred indexing that this one
+    // replaces; catalogs at 7 or 8 both go straight to 9.
+    if (version == 7 || version == 8) {
+        // file_fts becomes an external-content index over file_fts_source,
+        // so names and paths are no longer stored a second time. Deletes
+        // must hand FTS5 the exact values that were indexed, which is why
+        // directories_bd drops the rows of files a directory cascade is
+        // about to take away, and why marking a volume stale (fts_stale_ai)
+        // drops all of its rows up front. The index is rebuilt in full, so
+        // no volume stays marked. fts_stale is empty unless a volume is
+        // being bulk-loaded, so the triggers only look up a row's volume
+        // while one is.
+        const QList<QString> schemaStatements = {
+            QStringLiteral("DROP TRIGGER IF EXISTS files_ai;"),
+            QStringLiteral("DROP TRIGGER IF EXISTS files_au;"),
+            QStringLiteral("DROP TRIGGER IF EXISTS files_ad;"),
+            QStringLiteral("DROP TRIGGER IF EXISTS directories_au;"),
+            QStringLiteral("DROP TABLE IF EXISTS file_fts;"),
+            QStringLiteral("DROP TABLE IF EXISTS fts_stale;"),
+            QStringLiteral(
+                "CREATE VIEW IF NOT EXISTS file_fts_source AS "
+                "SELECT files.id AS id, directories.volume_id AS volume_id, files.name AS name, "
+                "directories.full_path || '/' || files.name AS full_path "
+                "FROM files JOIN directories ON directories.id = files.directory_id;"),
+            QStringLiteral(
+                "CREATE VIRTUAL TABLE file_fts USING fts5("
+                "name,"
+                "full_path,"
+                "content='file_fts_source',"
+                "content_rowid='id',"
+                "tokenize='porter'"
+                ");"),
+            QStringLiteral(
+                "CREATE TABLE fts_stale ("
+                "volume_id INTEGER PRIMARY KEY,"
+                "since INTEGER NOT NULL"
+                ");"),
+            QStringLiteral(
+                "CREATE TRIGGER files_ai AFTER INSERT ON files "
+                "WHEN NOT EXISTS (SELECT 1 FROM fts_stale) OR NOT EXISTS (SELECT 1 FROM fts_stale WHERE volume_id = "
+                "(SELECT volume_id FROM directories WHERE id = new.directory_id)) BEGIN "
+                "INSERT INTO file_fts(rowid, name, full_path) "
+                "SELECT new.id, new.name, full_path || '/' || new.name FROM directories WHERE id = new.directory_id; "
+                "END;"),
+            QStringLiteral(
+                "CREATE TRIGGER files_au AFTER UPDATE OF name, directory_id ON files "
+                "WHEN NOT EXISTS (SELECT 1 FROM fts_stale) OR NOT EXISTS (SELECT 1 FROM fts_stale WHERE volume_id = "
+                "(SELECT volume_id FROM directories WHERE id = new.directory_id)) BEGIN "
+                "INSERT INTO file_fts(file_fts, rowid, name, full_path) "
+                "SELECT 'delete', old.id, old.name, full_path || '/' || old.name FROM directories WHERE id = old.directory_id; "
+                "INSERT INTO file_fts(rowid, name, full_path) "
+                "SELECT new.id, new.name, full_path || '/' || new.name FROM directories WHERE id = new.directory_id; "
+                "END;"),
+            QStringLiteral(
+                "CREATE TRIGGER files_ad AFTER DELETE ON files "
+                "WHEN NOT EXISTS (SELECT 1 FROM fts_stale) OR NOT EXISTS (SELECT 1 FROM fts_stale WHERE volume_id = "
+                "(SELECT volume_id FROM directories WHERE id = old.directory_id)) BEGIN "
+                "INSERT INTO file_fts(file_fts, rowid, name, full_path) "
+                "SELECT 'delete', old.id, old.name, full_path || '/' || old.name FROM directories WHERE id = old.directory_id; "
+                "END;"),
+            QStringLiteral(
+                "CREATE TRIGGER directories_au AFTER UPDATE OF full_path ON directories "
+                "WHEN NOT EXISTS (SELECT 1 FROM fts_stale) OR NOT EXISTS (SELECT 1 FROM fts_stale WHERE volume_id = new.volume_id) BEGIN "
+                "INSERT INTO file_fts(file_fts, rowid, name, full_path) "
+                "SELECT 'delete', id, name, old.full_path || '/' || name FROM files WHERE directory_id = new.id; "
+                "INSERT INTO file_fts(rowid, name, full_path) "
+                "SELECT id, name, new.full_path || '/' || name FROM files WHERE directory_id = new.id; "
+                "END;"),
+            QStringLiteral(
+                "CREATE TRIGGER directories_bd BEFORE DELETE ON directories "
+                "WHEN NOT EXISTS (SELECT 1 FROM fts_stale) OR NOT EXISTS (SELECT 1 FROM fts_stale WHERE volume_id = old.volume_id) BEGIN "
+                "INSERT INTO file_fts(file_fts, rowid, name, full_path) "
+                "SELECT 'delete', id, name, old.full_path || '/' || name FROM files WHERE directory_id = old.id; "
+                "END;"),
+            QStringLiteral(
+                "CREATE TRIGGER fts_stale_ai AFTER INSERT ON fts_stale BEGIN "
+                "INSERT INTO file_fts(file_fts, rowid, name, full_path) "
+                "SELECT 'delete', id, name, full_path FROM file_fts_source WHERE volume_id = new.volume_id; "
+                "END;"),
+            // After the directory cascade, so directories_bd still sees the mark.
+            QStringLiteral(
+                "CREATE TRIGGER volumes_ad AFTER DELETE ON volumes BEGIN "
+                "DELETE FROM fts_stale WHERE volume_id = old.id; "
+                "END;"),
+            QStringLiteral("INSERT INTO file_fts(file_fts) VALUES ('rebuild');")
+        };
+
+        if (!execStatements(m_db, schemaStatements)) {
+            m_db.rollback();
+            return false;
+        }
+
+        if (!setSchemaVersion(m_db, 9)) {
+            m_db.rollback();
+            return false;
+        }
+        version = 9;
+    }
+
+    if (version == 9) {
+        // The scan root gets a column of its own; physical_hint is free text
+        // ("Shelf A"). Hints that look like absolute paths were set from
+        // the scan root by earlier versions.
+        const QList<QString> schemaStatements = {
+            QStringLiteral("ALTER TABLE volumes ADD COLUMN root_path TEXT;"),
+            QStringLiteral("UPDATE volumes SET root_path = physical_hint WHERE substr(physical_hint, 1, 1) = '/';")
+        };
+
+        if (!execStatements(m_db, schemaStatements)) {
+            m_db.rollback();
+            return false;
+        }
+
+        if (!setSchemaVersion(m_db, 10)) {
+            m_db.rollback();
+            return false;
+        }
+        version = 10;
+    }
+
     if (!setSchemaInfoVersion(m_db, CURRENT_SCHEMA_VERSION)) {
         m_db.rollback();
         return false;
@@ -399,12 +819,13 @@ int KatalogueDatabase::upsertVolume(const VolumeInfo &info) {
     if (info.id >= 0) {
         QSqlQuery update(m_db);
         update.prepare("UPDATE volumes SET label = ?, description = ?, fs_uuid = ?, fs_type = ?, "
-                       "physical_hint = ?, total_size = ?, created_at = ?, updated_at = ? WHERE id = ?");
+                       "physical_hint = ?, root_path = ?, total_size = ?, created_at = ?, updated_at = ? WHERE id = ?");
         update.addBindValue(info.label);
         update.addBindValue(info.description);
         update.addBindValue(info.fsUuid);
         update.addBindValue(info.fsType);
         update.addBindValue(info.physicalHint);
+        update.addBindValue(info.rootPath.isEmpty() ? QVariant(QVariant::String) : QVariant(info.rootPath));
         update.addBindValue(info.totalSize);
         update.addBindValue(info.createdAt.isValid() ? info.createdAt.toSecsSinceEpoch()
                                                     : QDateTime::currentDateTimeUtc().toSecsSinceEpoch());
@@ -419,13 +840,14 @@ int KatalogueDatabase::upsertVolume(const VolumeInfo &info) {
     }
 
     QSqlQuery insert(m_db);
-    insert.prepare("INSERT INTO volumes (label, description, fs_uuid, fs_type, physical_hint, total_size, "
-                   "created_at, updated_at) VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    insert.prepare("INSERT INTO volumes (label, description, fs_uuid, fs_type, physical_hint, root_path, "
+                   "total_size, created_at, updated_at) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
     insert.addBindValue(info.label);
     insert.addBindValue(info.description);
     insert.addBindValue(info.fsUuid);
     insert.addBindValue(info.fsType);
     insert.addBindValue(info.physicalHint);
+    insert.addBindValue(info.rootPath.isEmpty() ? QVariant(QVariant::String) : QVariant(info.rootPath));
     insert.addBindValue(info.totalSize);
     insert.addBindValue(info.createdAt.isValid() ? info.createdAt.toSecsSinceEpoch()
                                                 : QDateTime::currentDateTimeUtc().toSecsSinceEpoch());
@@ -445,9 +867,9 @@ std::optional<VolumeInfo> KatalogueDatabase::findVolumeByFsUuid(const QString &f
         return std::nullopt;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     query.prepare("SELECT id, label, description, fs_uuid, fs_type, physical_hint, total_size, "
-                  "created_at, updated_at FROM volumes WHERE fs_uuid = ? LIMIT 1");
+                  "created_at, updated_at, root_path FROM volumes WHERE fs_uuid = ? LIMIT 1");
     query.addBindValue(fsUuid);
     if (!query.exec()) {
         qWarning() << "Failed to find volume by fs_uuid" << query.lastError();
@@ -467,6 +889,7 @@ std::optional<VolumeInfo> KatalogueDatabase::findVolumeByFsUuid(const QString &f
     info.totalSize = query.value(6).toLongLong();
     info.createdAt = QDateTime::fromSecsSinceEpoch(query.value(7).toLongLong(), Qt::UTC);
     info.updatedAt = QDateTime::fromSecsSinceEpoch(query.value(8).toLongLong(), Qt::UTC);
+    info.rootPath = query.value(9).toString();
     return info;
 }
 
@@ -475,8 +898,7 @@ bool KatalogueDatabase::clearVolumeContents(int volumeId) {
         return false;
     }
 
-    if (!m_db.transaction()) {
-        qWarning() << "Failed to start clear volume transaction" << m_db.lastError();
+    if (!beginBatch()) {
         return false;
     }
 
@@ -486,7 +908,7 @@ bool KatalogueDatabase::clearVolumeContents(int volumeId) {
     deleteFiles.addBindValue(volumeId);
     if (!deleteFiles.exec()) {
         qWarning() << "Failed to clear files for volume" << deleteFiles.lastError();
-        m_db.rollback();
+        abortBatch();
         return false;
     }
 
@@ -495,18 +917,223 @@ bool KatalogueDatabase::clearVolumeContents(int volumeId) {
     deleteDirs.addBindValue(volumeId);
     if (!deleteDirs.exec()) {
         qWarning() << "Failed to clear directories for volume" << deleteDirs.lastError();
-        m_db.rollback();
+        abortBatch();
         return false;
     }
 
-    if (!m_db.commit()) {
-        qWarning() << "Failed to commit clear volume" << m_db.lastError();
+    return endBatch();
+}
+
+bool KatalogueDatabase::deleteVolume(int volumeId) {
+    if (!m_db.isOpen() || volumeId < 0) {
+        return false;
+    }
+
+    if (!beginBatch()) {
+        return false;
+    }
+
+    // Files first, like deleteDirectory(), so their index rows go with them.
+    QSqlQuery deleteFiles(m_db);
+    deleteFiles.prepare("DELETE FROM files WHERE directory_id IN "
+                        "(SELECT id FROM directories WHERE volume_id = ?)");
+    deleteFiles.addBindValue(volumeId);
+    if (!deleteFiles.exec()) {
+        qWarning() << "Failed to delete files of volume" << deleteFiles.lastError();
+        abortBatch();
         return false;
     }
 
+    QSqlQuery deleteVolumeRow(m_db);
+    deleteVolumeRow.prepare("DELETE FROM volumes WHERE id = ?");
+    deleteVolumeRow.addBindValue(volumeId);
+    if (!deleteVolumeRow.exec()) {
+        qWarning() << "Failed to delete volume" << deleteVolumeRow.lastError();
+        abortBatch();
+        return false;
+    }
+
+    return endBatch();
+}
+
+bool KatalogueDatabase::setSearchIndexStale(int volumeId) {
+    if (!m_db.isOpen() || volumeId < 0) {
+        return false;
+    }
+    // fts_stale_ai drops the volume's index rows; an existing mark is kept.
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR IGNORE INTO fts_stale (volume_id, since) VALUES (?, ?)");
+    query.addBindValue(volumeId);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    if (!query.exec()) {
+        qWarning() << "Failed to mark search index stale" << query.lastError();
+        return false;
+    }
     return true;
 }
 
+QList<int> KatalogueDatabase::staleSearchIndexVolumes() const {
+    QList<int> volumes;
+    if (!m_db.isOpen()) {
+        return volumes;
+    }
+    QSqlQuery query(reader());
+    if (!query.exec(QStringLiteral("SELECT volume_id FROM fts_stale ORDER BY volume_id"))) {
+        qWarning() << "Failed to list stale search indexes" << query.lastError();
+        return volumes;
+    }
+    while (query.next()) {
+        volumes.append(query.value(0).toInt());
+    }
+    return volumes;
+}
+
+bool KatalogueDatabase::rebuildSearchIndex(int volumeId) {
+    if (!m_db.isOpen() || volumeId < 0) {
+        return false;
+    }
+
+    QSqlQuery state(m_db);
+    state.prepare("SELECT 1 FROM fts_stale WHERE volume_id = ?");
+    state.addBindValue(volumeId);
+    if (!state.exec()) {
+        qWarning() << "Failed to read search index state" << state.lastError();
+        return false;
+    }
+    if (!state.next()) {
+        return true;
+    }
+    state.finish();
+
+    if (!beginBatch()) {
+        return false;
+    }
+
+    // Marking the volume emptied its part of the index, so this only adds.
+    QSqlQuery fill(m_db);
+    fill.prepare("INSERT INTO file_fts(rowid, name, full_path) "
+                 "SELECT id, name, full_path FROM file_fts_source WHERE volume_id = ? ORDER BY id");
+    fill.addBindValue(volumeId);
+    if (!fill.exec()) {
+        qWarning() << "Failed to rebuild search index" << fill.lastError();
+        abortBatch();
+        return false;
+    }
+    if (hasSubstringIndex()) {
+        QSqlQuery fillNames(m_db);
+        fillNames.prepare("INSERT INTO file_name_trigram(rowid, name) "
+                          "SELECT id, name FROM file_fts_source WHERE volume_id = ? ORDER BY id");
+        fillNames.addBindValue(volumeId);
+        if (!fillNames.exec()) {
+            qWarning() << "Failed to rebuild substring index" << fillNames.lastError();
+            abortBatch();
+            return false;
+        }
+    }
+
+    QSqlQuery unmark(m_db);
+    unmark.prepare("DELETE FROM fts_stale WHERE volume_id = ?");
+    unmark.addBindValue(volumeId);
+    if (!unmark.exec()) {
+        qWarning() << "Failed to clear search index mark" << unmark.lastError();
+        abortBatch();
+        return false;
+    }
+
+    return endBatch();
+}
+
+bool KatalogueDatabase::setSubstringIndex(bool enabled) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+    if (hasSubstringIndex() == enabled) {
+        return true;
+    }
+
+    // Same rules as file_fts: deletes pass the indexed name, stale volumes
+    // are left out until rebuildSearchIndex().
+    const QList<QString> statements = enabled
+        ? QList<QString>{
+              QStringLiteral(
+                  "CREATE VIRTUAL TABLE file_name_trigram USING fts5("
+                  "name,"
+                  "content='file_fts_source',"
+                  "content_rowid='id',"
+                  "tokenize='trigram'"
+                  ");"),
+              QStringLiteral(
+                  "CREATE TRIGGER files_trigram_ai AFTER INSERT ON files "
+                  "WHEN NOT EXISTS (SELECT 1 FROM fts_stale) OR NOT EXISTS (SELECT 1 FROM fts_stale WHERE volume_id = "
+                  "(SELECT volume_id FROM directories WHERE id = new.directory_id)) BEGIN "
+                  "INSERT INTO file_name_trigram(rowid, name) VALUES (new.id, new.name); "
+                  "END;"),
+              QStringLiteral(
+                  "CREATE TRIGGER files_trigram_au AFTER UPDATE OF name ON files "
+                  "WHEN NOT EXISTS (SELECT 1 FROM fts_stale) OR NOT EXISTS (SELECT 1 FROM fts_stale WHERE volume_id = "
+                  "(SELECT volume_id FROM directories WHERE id = new.directory_id)) BEGIN "
+                  "INSERT INTO file_name_trigram(file_name_trigram, rowid, name) VALUES ('delete', old.id, old.name); "
+                  "INSERT INTO file_name_trigram(rowid, name) VALUES (new.id, new.name); "
+                  "END;"),
+              QStringLiteral(
+                  "CREATE TRIGGER files_trigram_ad AFTER DELETE ON files "
+                  "WHEN NOT EXISTS (SELECT 1 FROM fts_stale) OR NOT EXISTS (SELECT 1 FROM fts_stale WHERE volume_id = "
+                  "(SELECT volume_id FROM directories WHERE id = old.directory_id)) BEGIN "
+                  "INSERT INTO file_name_trigram(file_name_trigram, rowid, name) "
+                  "SELECT 'delete', old.id, old.name FROM directories WHERE id = old.directory_id; "
+                  "END;"),
+              QStringLiteral(
+                  "CREATE TRIGGER directories_trigram_bd BEFORE DELETE ON directories "
+                  "WHEN NOT EXISTS (SELECT 1 FROM fts_stale) OR NOT EXISTS (SELECT 1 FROM fts_stale WHERE volume_id = old.volume_id) BEGIN "
+                  "INSERT INTO file_name_trigram(file_name_trigram, rowid, name) "
+                  "SELECT 'delete', id, name FROM files WHERE directory_id = old.id; "
+                  "END;"),
+              QStringLiteral(
+                  "CREATE TRIGGER fts_stale_trigram_ai AFTER INSERT ON fts_stale BEGIN "
+                  "INSERT INTO file_name_trigram(file_name_trigram, rowid, name) "
+                  "SELECT 'delete', id, name FROM file_fts_source WHERE volume_id = new.volume_id; "
+                  "END;"),
+              QStringLiteral(
+                  "INSERT INTO file_name_trigram(rowid, name) "
+                  "SELECT id, name FROM file_fts_source "
+                  "WHERE volume_id NOT IN (SELECT volume_id FROM fts_stale) ORDER BY id;")}
+        : QList<QString>{
+              QStringLiteral("DROP TRIGGER IF EXISTS files_trigram_ai;"),
+              QStringLiteral("DROP TRIGGER IF EXISTS files_trigram_au;"),
+              QStringLiteral("DROP TRIGGER IF EXISTS files_trigram_ad;"),
+              QStringLiteral("DROP TRIGGER IF EXISTS directories_trigram_bd;"),
+              QStringLiteral("DROP TRIGGER IF EXISTS fts_stale_trigram_ai;"),
+              QStringLiteral("DROP TABLE IF EXISTS file_name_trigram;")};
+
+    if (!beginBatch()) {
+        return false;
+    }
+    // The trigram tokenizer needs SQLite 3.34 or later.
+    if (!execStatements(m_db, statements)) {
+        abortBatch();
+        return false;
+    }
+    const bool changed = endBatch();
+    m_writeTurns->schemaChanged();
+    return changed;
+}
+
+bool KatalogueDatabase::hasSubstringIndex() const {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+    // Cached with the catalog's schema generation, so a change through
+    // another connection is picked up on the next call.
+    const qint64 generation = static_cast<qint64>(m_writeTurns->schemaGeneration());
+    const qint64 cached = m_substringIndex.load(std::memory_order_relaxed);
+    if (cached >= 0 && cached >> 1 == generation) {
+        return cached & 1;
+    }
+    const bool exists = tableExists(reader(), QStringLiteral("file_name_trigram"));
+    m_substringIndex.store(generation << 1 | (exists ? 1 : 0), std::memory_order_relaxed);
+    return exists;
+}
+
 int KatalogueDatabase::upsertDirectory(const DirectoryInfo &info) {
     if (!m_db.isOpen()) {
         return -1;
@@ -514,12 +1141,14 @@ int KatalogueDatabase::upsertDirectory(const DirectoryInfo &info) {
 
     if (info.id >= 0) {
         QSqlQuery update(m_db);
-        update.prepare("UPDATE directories SET volume_id = ?, parent_id = ?, name = ?, full_path = ? "
-                       "WHERE id = ?");
+        update.prepare("UPDATE directories SET volume_id = ?, parent_id = ?, name = ?, full_path = ?, "
+                       "mtime = ?, inode = ? WHERE id = ?");
         update.addBindValue(info.volumeId);
         update.addBindValue(info.parentId >= 0 ? QVariant(info.parentId) : QVariant(QVariant::Int));
         update.addBindValue(info.name);
         update.addBindValue(info.fullPath);
+        update.addBindValue(info.mtime.isValid() ? info.mtime.toSecsSinceEpoch() : QVariant(QVariant::LongLong));
+        update.addBindValue(info.inode > 0 ? QVariant(static_cast<qint64>(info.inode)) : QVariant(QVariant::LongLong));
         update.addBindValue(info.id);
         if (!update.exec()) {
             qWarning() << "Failed to update directory" << update.lastError();
@@ -529,11 +1158,14 @@ int KatalogueDatabase::upsertDirectory(const DirectoryInfo &info) {
     }
 
     QSqlQuery insert(m_db);
-    insert.prepare("INSERT INTO directories (volume_id, parent_id, name, full_path) VALUES (?, ?, ?, ?)");
+    insert.prepare("INSERT INTO directories (volume_id, parent_id, name, full_path, mtime, inode) "
+                   "VALUES (?, ?, ?, ?, ?, ?)");
     insert.addBindValue(info.volumeId);
     insert.addBindValue(info.parentId >= 0 ? QVariant(info.parentId) : QVariant(QVariant::Int));
     insert.addBindValue(info.name);
     insert.addBindValue(info.fullPath);
+    insert.addBindValue(info.mtime.isValid() ? info.mtime.toSecsSinceEpoch() : QVariant(QVariant::LongLong));
+    insert.addBindValue(info.inode > 0 ? QVariant(static_cast<qint64>(info.inode)) : QVariant(QVariant::LongLong));
 
     if (!insert.exec()) {
         if (insert.lastError().isValid()) {
@@ -552,6 +1184,109 @@ int KatalogueDatabase::upsertDirectory(const DirectoryInfo &info) {
     return insert.lastInsertId().toInt();
 }
 
+bool KatalogueDatabase::insertDirectories(std::span<DirectoryInfo> directories) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+    std::vector<qsizetype> order(directories.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&directories](qsizetype a, qsizetype b) {
+        const DirectoryInfo &left = directories[a];
+        const DirectoryInfo &right = directories[b];
+        return left.volumeId != right.volumeId ? left.volumeId < right.volumeId : left.fullPath < right.fullPath;
+    });
+
+    for (qsizetype start = 0; start < static_cast<qsizetype>(order.size()); start += bulkRowsPerStatement) {
+        const qsizetype rows = qMin(bulkRowsPerStatement, static_cast<qsizetype>(order.size()) - start);
+        // DO NOTHING would return no row for an existing directory.
+        QSqlQuery &insert = cachedQuery(
+            QStringLiteral("INSERT INTO directories (volume_id, parent_id, name, full_path, mtime, inode) VALUES %1 "
+                           "ON CONFLICT(volume_id, full_path) DO UPDATE SET parent_id = excluded.parent_id "
+                           "RETURNING id, volume_id, full_path")
+                .arg(valuesPlaceholders(rows, 6)));
+        int column = 0;
+        for (qsizetype row = start; row < start + rows; ++row) {
+            const DirectoryInfo &info = directories[order[row]];
+            insert.bindValue(column++, info.volumeId);
+            insert.bindValue(column++, info.parentId >= 0 ? QVariant(info.parentId) : QVariant(QVariant::Int));
+            insert.bindValue(column++, info.name);
+            insert.bindValue(column++, info.fullPath);
+            insert.bindValue(column++, secsOrNull(info.mtime));
+            insert.bindValue(column++, integerOrNull(info.inode));
+        }
+        if (!insert.exec()) {
+            qWarning() << "Failed to insert directories" << insert.lastError();
+            return false;
+        }
+        // RETURNING does not promise the VALUES order.
+        QHash<std::pair<int, QString>, int> ids;
+        while (insert.next()) {
+            ids.insert({insert.value(1).toInt(), insert.value(2).toString()}, insert.value(0).toInt());
+        }
+        insert.finish();
+        for (qsizetype row = start; row < start + rows; ++row) {
+            DirectoryInfo &info = directories[order[row]];
+            info.id = ids.value({info.volumeId, info.fullPath}, -1);
+        }
+    }
+    return true;
+}
+
+bool KatalogueDatabase::insertFiles(std::span<FileInfo> files) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+    std::vector<qsizetype> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&files](qsizetype a, qsizetype b) {
+        const FileInfo &left = files[a];
+        const FileInfo &right = files[b];
+        return left.directoryId != right.directoryId ? left.directoryId < right.directoryId : left.name < right.name;
+    });
+
+    for (qsizetype start = 0; start < static_cast<qsizetype>(order.size()); start += bulkRowsPerStatement) {
+        const qsizetype rows = qMin(bulkRowsPerStatement, static_cast<qsizetype>(order.size()) - start);
+        QSqlQuery &insert = cachedQuery(
+            QStringLiteral("INSERT INTO files (directory_id, name, size, mtime, ctime, file_type, hash, fingerprint, "
+                           "attrs, inode, link_count) VALUES %1 "
+                           "ON CONFLICT(directory_id, name) DO UPDATE SET size = excluded.size, "
+                           "mtime = excluded.mtime, ctime = excluded.ctime, file_type = excluded.file_type, "
+                           "hash = excluded.hash, fingerprint = excluded.fingerprint, attrs = excluded.attrs, "
+                           "inode = excluded.inode, link_count = excluded.link_count "
+                           "RETURNING id, directory_id, name")
+                .arg(valuesPlaceholders(rows, 11)));
+        int column = 0;
+        for (qsizetype row = start; row < start + rows; ++row) {
+            const FileInfo &info = files[order[row]];
+            insert.bindValue(column++, info.directoryId);
+            insert.bindValue(column++, info.name);
+            insert.bindValue(column++, info.size);
+            insert.bindValue(column++, secsOrNull(info.mtime));
+            insert.bindValue(column++, secsOrNull(info.ctime));
+            insert.bindValue(column++, info.fileType);
+            insert.bindValue(column++, info.hash);
+            insert.bindValue(column++, info.fingerprint);
+            insert.bindValue(column++, info.attrs);
+            insert.bindValue(column++, integerOrNull(info.inode));
+            insert.bindValue(column++, integerOrNull(info.linkCount));
+        }
+        if (!insert.exec()) {
+            qWarning() << "Failed to insert files" << insert.lastError();
+            return false;
+        }
+        QHash<std::pair<int, QString>, int> ids;
+        while (insert.next()) {
+            ids.insert({insert.value(1).toInt(), insert.value(2).toString()}, insert.value(0).toInt());
+        }
+        insert.finish();
+        for (qsizetype row = start; row < start + rows; ++row) {
+            FileInfo &info = files[order[row]];
+            info.id = ids.value({info.directoryId, info.name}, -1);
+        }
+    }
+    return true;
+}
+
 int KatalogueDatabase::insertFile(const FileInfo &info) {
     return upsertFile(info);
 }
@@ -564,7 +1299,8 @@ int KatalogueDatabase::upsertFile(const FileInfo &info) {
     if (info.id >= 0) {
         QSqlQuery update(m_db);
         update.prepare("UPDATE files SET directory_id = ?, name = ?, size = ?, mtime = ?, ctime = ?, "
-                       "file_type = ?, hash = ?, attrs = ? WHERE id = ?");
+                       "file_type = ?, hash = ?, fingerprint = ?, attrs = ?, inode = ?, link_count = ? "
+                       "WHERE id = ?");
         update.addBindValue(info.directoryId);
         update.addBindValue(info.name);
         update.addBindValue(info.size);
@@ -572,7 +1308,10 @@ int KatalogueDatabase::upsertFile(const FileInfo &info) {
         update.addBindValue(info.ctime.isValid() ? info.ctime.toSecsSinceEpoch() : QVariant(QVariant::LongLong));
         update.addBindValue(info.fileType);
         update.addBindValue(info.hash);
+        update.addBindValue(info.fingerprint);
         update.addBindValue(info.attrs);
+        update.addBindValue(integerOrNull(info.inode));
+        update.addBindValue(integerOrNull(info.linkCount));
         update.addBindValue(info.id);
         if (!update.exec()) {
             qWarning() << "Failed to update file" << update.lastError();
@@ -582,8 +1321,9 @@ int KatalogueDatabase::upsertFile(const FileInfo &info) {
     }
 
     QSqlQuery insert(m_db);
-    insert.prepare("INSERT INTO files (directory_id, name, size, mtime, ctime, file_type, hash, attrs) "
-                   "VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    insert.prepare("INSERT INTO files (directory_id, name, size, mtime, ctime, file_type, hash, fingerprint, attrs, "
+                   "inode, link_count) "
+                   "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
     insert.addBindValue(info.directoryId);
     insert.addBindValue(info.name);
     insert.addBindValue(info.size);
@@ -591,19 +1331,26 @@ int KatalogueDatabase::upsertFile(const FileInfo &info) {
     insert.addBindValue(info.ctime.isValid() ? info.ctime.toSecsSinceEpoch() : QVariant(QVariant::LongLong));
     insert.addBindValue(info.fileType);
     insert.addBindValue(info.hash);
+    insert.addBindValue(info.fingerprint);
     insert.addBindValue(info.attrs);
+    insert.addBindValue(integerOrNull(info.inode));
+    insert.addBindValue(integerOrNull(info.linkCount));
 
     if (!insert.exec()) {
         if (insert.lastError().isValid()) {
             QSqlQuery update(m_db);
-            update.prepare("UPDATE files SET size = ?, mtime = ?, ctime = ?, file_type = ?, hash = ?, attrs = ? "
+            update.prepare("UPDATE files SET size = ?, mtime = ?, ctime = ?, file_type = ?, hash = ?, "
+                           "fingerprint = ?, attrs = ?, inode = ?, link_count = ? "
                            "WHERE directory_id = ? AND name = ?");
             update.addBindValue(info.size);
             update.addBindValue(info.mtime.isValid() ? info.mtime.toSecsSinceEpoch() : QVariant(QVariant::LongLong));
             update.addBindValue(info.ctime.isValid() ? info.ctime.toSecsSinceEpoch() : QVariant(QVariant::LongLong));
             update.addBindValue(info.fileType);
             update.addBindValue(info.hash);
+            update.addBindValue(info.fingerprint);
             update.addBindValue(info.attrs);
+            update.addBindValue(integerOrNull(info.inode));
+            update.addBindValue(integerOrNull(info.linkCount));
             update.addBindValue(info.directoryId);
             update.addBindValue(info.name);
             if (!update.exec()) {
@@ -626,16 +1373,127 @@ int KatalogueDatabase::upsertFile(const FileInfo &info) {
     return insert.lastInsertId().toInt();
 }
 
-bool KatalogueDatabase::deleteFile(int fileId) {
+bool KatalogueDatabase::deleteFile(int fileId) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM files WHERE id = ?");
+    query.addBindValue(fileId);
+    if (!query.exec()) {
+        qWarning() << "Failed to delete file" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool KatalogueDatabase::setFileHash(int fileId, const QString &hash) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE files SET hash = ? WHERE id = ?");
+    query.addBindValue(hash);
+    query.addBindValue(fileId);
+    if (!query.exec()) {
+        qWarning() << "Failed to store file hash" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool KatalogueDatabase::setFileFingerprint(int fileId, const QString &fingerprint) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE files SET fingerprint = ? WHERE id = ?");
+    query.addBindValue(fingerprint);
+    query.addBindValue(fileId);
+    if (!query.exec()) {
+        qWarning() << "Failed to store file fingerprint" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+// Files without a full hash whose sampled fingerprint matches another file.
+// Local paths are rebuilt from the volume's scan root; files of volumes
+// that were never scanned from a path are left out.
+QList<KatalogueDatabase::HashCandidate> KatalogueDatabase::fingerprintCollisions(int limit, int offset) const {
+    QList<HashCandidate> candidates;
+    if (!m_db.isOpen()) {
+        return candidates;
+    }
+
+    // Hardlinks of one inode share a fingerprint without colliding.
+    QSqlQuery query(reader());
+    query.prepare("SELECT files.id, volumes.root_path, directories.full_path, files.name "
+                  "FROM files "
+                  "JOIN directories ON directories.id = files.directory_id "
+                  "JOIN volumes ON volumes.id = directories.volume_id "
+                  "WHERE (files.hash IS NULL OR files.hash = '') AND volumes.root_path IS NOT NULL "
+                  "AND files.fingerprint IN (SELECT f.fingerprint FROM files f "
+                  "JOIN directories d ON d.id = f.directory_id "
+                  "WHERE f.fingerprint IS NOT NULL AND f.fingerprint <> '' "
+                  "GROUP BY f.fingerprint HAVING COUNT(DISTINCT CASE WHEN f.link_count > 1 "
+                  "THEN d.volume_id || ':' || f.inode ELSE 'file:' || f.id END) > 1) "
+                  "ORDER BY files.id LIMIT ? OFFSET ?");
+    query.addBindValue(limit);
+    query.addBindValue(offset);
+    if (!query.exec()) {
+        qWarning() << "Failed to list fingerprint collisions" << query.lastError();
+        return candidates;
+    }
+
+    while (query.next()) {
+        const QString directoryPath = query.value(2).toString();
+        HashCandidate candidate;
+        candidate.fileId = query.value(0).toInt();
+        candidate.localPath = query.value(1).toString()
+                              + (directoryPath == QStringLiteral("/") ? QString() : directoryPath)
+                              + QLatin1Char('/') + query.value(3).toString();
+        candidates.append(candidate);
+    }
+    return candidates;
+}
+
+// Removes a directory together with everything below it. Files go first so
+// their FTS rows are dropped by files_ad before the directory cascade runs.
+bool KatalogueDatabase::deleteDirectory(int directoryId) {
     if (!m_db.isOpen()) {
         return false;
     }
 
-    QSqlQuery query(m_db);
-    query.prepare("DELETE FROM files WHERE id = ?");
-    query.addBindValue(fileId);
-    if (!query.exec()) {
-        qWarning() << "Failed to delete file" << query.lastError();
+    const auto directory = getDirectory(directoryId);
+    if (!directory) {
+        return false;
+    }
+    const QString prefix = directory->fullPath == QStringLiteral("/")
+                               ? directory->fullPath
+                               : directory->fullPath + QLatin1Char('/');
+
+    QSqlQuery deleteFiles(m_db);
+    deleteFiles.prepare("DELETE FROM files WHERE directory_id IN "
+                        "(SELECT id FROM directories WHERE volume_id = ? "
+                        "AND (id = ? OR substr(full_path, 1, ?) = ?))");
+    deleteFiles.addBindValue(directory->volumeId);
+    deleteFiles.addBindValue(directoryId);
+    deleteFiles.addBindValue(prefix.size());
+    deleteFiles.addBindValue(prefix);
+    if (!deleteFiles.exec()) {
+        qWarning() << "Failed to delete files under directory" << deleteFiles.lastError();
+        return false;
+    }
+
+    QSqlQuery deleteDir(m_db);
+    deleteDir.prepare("DELETE FROM directories WHERE id = ?");
+    deleteDir.addBindValue(directoryId);
+    if (!deleteDir.exec()) {
+        qWarning() << "Failed to delete directory" << deleteDir.lastError();
         return false;
     }
     return true;
@@ -647,9 +1505,9 @@ QList<VolumeInfo> KatalogueDatabase::listVolumes() const {
         return volumes;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     if (!query.exec("SELECT id, label, description, fs_uuid, fs_type, physical_hint, total_size, "
-                    "created_at, updated_at FROM volumes")) {
+                    "created_at, updated_at, root_path FROM volumes")) {
         qWarning() << "Failed to list volumes" << query.lastError();
         return volumes;
     }
@@ -665,6 +1523,7 @@ QList<VolumeInfo> KatalogueDatabase::listVolumes() const {
         info.totalSize = query.value(6).toLongLong();
         info.createdAt = QDateTime::fromSecsSinceEpoch(query.value(7).toLongLong(), Qt::UTC);
         info.updatedAt = QDateTime::fromSecsSinceEpoch(query.value(8).toLongLong(), Qt::UTC);
+        info.rootPath = query.value(9).toString();
         volumes.append(info);
     }
 
@@ -678,7 +1537,7 @@ std::optional<KatalogueDatabase::ProjectStats> KatalogueDatabase::projectStats()
 
     ProjectStats stats;
 
-    QSqlQuery volumesQuery(m_db);
+    QSqlQuery volumesQuery(reader());
     if (!volumesQuery.exec("SELECT COUNT(*) FROM volumes")) {
         qWarning() << "Failed to count volumes" << volumesQuery.lastError();
         return std::nullopt;
@@ -687,7 +1546,7 @@ std::optional<KatalogueDatabase::ProjectStats> KatalogueDatabase::projectStats()
         stats.volumeCount = volumesQuery.value(0).toInt();
     }
 
-    QSqlQuery filesQuery(m_db);
+    QSqlQuery filesQuery(reader());
     if (!filesQuery.exec("SELECT COUNT(*) FROM files")) {
         qWarning() << "Failed to count files" << filesQuery.lastError();
         return std::nullopt;
@@ -696,7 +1555,7 @@ std::optional<KatalogueDatabase::ProjectStats> KatalogueDatabase::projectStats()
         stats.fileCount = filesQuery.value(0).toLongLong();
     }
 
-    QSqlQuery bytesQuery(m_db);
+    QSqlQuery bytesQuery(reader());
     if (!bytesQuery.exec("SELECT COALESCE(SUM(size), 0) FROM files")) {
         qWarning() << "Failed to sum file sizes" << bytesQuery.lastError();
         return std::nullopt;
@@ -705,6 +1564,24 @@ std::optional<KatalogueDatabase::ProjectStats> KatalogueDatabase::projectStats()
         stats.totalBytes = bytesQuery.value(0).toLongLong();
     }
 
+    // Inode numbers are only unique within a filesystem, so hardlinks are
+    // grouped per volume.
+    QSqlQuery uniqueQuery(reader());
+    if (!uniqueQuery.exec("SELECT "
+                          "(SELECT COALESCE(SUM(size), 0) FROM files "
+                          " WHERE inode IS NULL OR link_count IS NULL OR link_count <= 1) + "
+                          "(SELECT COALESCE(SUM(size), 0) FROM ("
+                          " SELECT MAX(files.size) AS size FROM files "
+                          " JOIN directories ON directories.id = files.directory_id "
+                          " WHERE files.inode IS NOT NULL AND files.link_count > 1 "
+                          " GROUP BY directories.volume_id, files.inode))")) {
+        qWarning() << "Failed to sum unique file sizes" << uniqueQuery.lastError();
+        return std::nullopt;
+    }
+    if (uniqueQuery.next()) {
+        stats.uniqueBytes = uniqueQuery.value(0).toLongLong();
+    }
+
     return stats;
 }
 
@@ -722,46 +1599,88 @@ QList<SearchResult> KatalogueDatabase::search(const QString &queryText,
         return results;
     }
 
-    QString statement =
-        "SELECT files.id, files.directory_id, directories.volume_id, files.name, "
-        "directories.full_path || '/' || files.name AS full_path, "
-        "volumes.label, files.file_type, files.size, files.mtime "
-        "FROM file_fts "
-        "JOIN files ON files.id = file_fts.rowid "
-        "JOIN directories ON directories.id = files.directory_id "
-        "JOIN volumes ON volumes.id = directories.volume_id "
-        "WHERE file_fts MATCH ? ";
-
+    // Plain words of three or more code points are also looked up anywhere
+    // inside file names when the catalog has a trigram index. Queries using
+    // FTS syntax (quotes, wildcards, groups, column filters, operators) and
+    // shorter words only go to the word index.
+    static const QRegularExpression whitespace(QStringLiteral("\\s+"));
+    const QStringList terms = trimmed.split(whitespace, Qt::SkipEmptyParts);
+    static const QRegularExpression ftsSyntax(QStringLiteral("[\"*()^:+{}]"));
+    const bool substring =
+        !trimmed.contains(ftsSyntax)
+        && std::all_of(terms.cbegin(), terms.cend(), [](const QString &term) {
+               return term.toUcs4().size() >= 3 && term != QLatin1String("AND") && term != QLatin1String("OR")
+                      && term != QLatin1String("NOT") && term != QLatin1String("NEAR");
+           })
+        && hasSubstringIndex();
+
+    QString filterClause;
+    QVariantList filterValues;
     if (filters.volumeId.has_value()) {
-        statement += "AND directories.volume_id = ? ";
+        filterClause += "AND directories.volume_id = ? ";
+        filterValues.append(filters.volumeId.value());
     }
 
-    bool hasFileTypeFilter = false;
-    QString fileTypeValue;
     if (filters.fileType.has_value()) {
-        fileTypeValue = filters.fileType->trimmed().toLower();
+        const QString fileTypeValue = filters.fileType->trimmed().toLower();
         if (!fileTypeValue.isEmpty()) {
-            hasFileTypeFilter = true;
-            statement += "AND files.file_type LIKE ? ";
+            filterClause += "AND files.file_type LIKE ? ";
+            filterValues.append(fileTypeValue.contains('/') ? fileTypeValue : QStringLiteral("%/") + fileTypeValue);
         }
     }
 
+    QString statement =
+        "SELECT files.id, files.directory_id, directories.volume_id, files.name, "
+        "directories.full_path || '/' || files.name AS full_path, "
+        "volumes.label, files.file_type, files.size, files.mtime ";
+    if (substring) {
+        // Each index contributes only its own first limit + offset rows, so
+        // short, common substrings do not sort every match before LIMIT.
+        const QString candidates =
+            QStringLiteral("SELECT id FROM (SELECT files.id FROM %1 "
+                           "JOIN files ON files.id = %1.rowid "
+                           "JOIN directories ON directories.id = files.directory_id "
+                           "WHERE %1 MATCH ? ")
+            + filterClause + QStringLiteral("ORDER BY files.mtime DESC LIMIT ?)");
+        statement +=
+            "FROM files "
+            "JOIN directories ON directories.id = files.directory_id "
+            "JOIN volumes ON volumes.id = directories.volume_id "
+            "WHERE files.id IN (" + candidates.arg(QStringLiteral("file_name_trigram"))
+            + " UNION ALL " + candidates.arg(QStringLiteral("file_fts")) + ") ";
+    } else {
+        statement +=
+            "FROM file_fts "
+            "JOIN files ON files.id = file_fts.rowid "
+            "JOIN directories ON directories.id = files.directory_id "
+            "JOIN volumes ON volumes.id = directories.volume_id "
+            "WHERE file_fts MATCH ? " + filterClause;
+    }
+
     statement += "ORDER BY files.mtime DESC LIMIT ? OFFSET ?";
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     query.prepare(statement);
-    const QString matchQuery = trimmed + '*';
-    query.addBindValue(matchQuery);
-
-    if (filters.volumeId.has_value()) {
-        query.addBindValue(filters.volumeId.value());
-    }
-
-    if (hasFileTypeFilter) {
-        const QString pattern = fileTypeValue.contains('/')
-                                    ? fileTypeValue
-                                    : QStringLiteral("%/") + fileTypeValue;
-        query.addBindValue(pattern);
+    auto bindFilters = [&query, &filterValues]() {
+        for (const QVariant &value : std::as_const(filterValues)) {
+            query.addBindValue(value);
+        }
+    };
+    if (substring) {
+        // Quoted, so punctuation such as '-' or '.' inside a word is a
+        // phrase separator rather than a syntax error.
+        const QString quoted = QLatin1Char('"') + terms.join(QStringLiteral("\" \"")) + QLatin1Char('"');
+        const int candidateLimit = limit < 0 ? -1 : limit + qMax(0, offset);
+        query.addBindValue(quoted);
+        bindFilters();
+        query.addBindValue(candidateLimit);
+        query.addBindValue(quoted + QLatin1Char('*'));
+        bindFilters();
+        query.addBindValue(candidateLimit);
+    } else {
+        const QString matchQuery = trimmed + '*';
+        query.addBindValue(matchQuery);
+        bindFilters();
     }
 
     query.addBindValue(limit);
@@ -795,14 +1714,14 @@ QList<DirectoryInfo> KatalogueDatabase::listDirectories(int volumeId, int parent
         return directories;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     if (parentId < 0) {
-        query.prepare("SELECT id, volume_id, parent_id, name, full_path "
+        query.prepare("SELECT id, volume_id, parent_id, name, full_path, mtime, inode "
                       "FROM directories WHERE volume_id = ? AND (parent_id IS NULL OR parent_id = -1) "
                       "ORDER BY name");
         query.addBindValue(volumeId);
     } else {
-        query.prepare("SELECT id, volume_id, parent_id, name, full_path "
+        query.prepare("SELECT id, volume_id, parent_id, name, full_path, mtime, inode "
                       "FROM directories WHERE volume_id = ? AND parent_id = ? "
                       "ORDER BY name");
         query.addBindValue(volumeId);
@@ -815,13 +1734,7 @@ QList<DirectoryInfo> KatalogueDatabase::listDirectories(int volumeId, int parent
     }
 
     while (query.next()) {
-        DirectoryInfo info;
-        info.id = query.value(0).toInt();
-        info.volumeId = query.value(1).toInt();
-        info.parentId = query.value(2).isNull() ? -1 : query.value(2).toInt();
-        info.name = query.value(3).toString();
-        info.fullPath = query.value(4).toString();
-        directories.append(info);
+        directories.append(directoryFromQuery(query));
     }
 
     return directories;
@@ -835,8 +1748,9 @@ QList<FileInfo> KatalogueDatabase::listFilesInDirectory(int directoryId) const {
 
     const QString basePath = directoryFullPath(directoryId);
 
-    QSqlQuery query(m_db);
-    query.prepare("SELECT id, directory_id, name, size, mtime, ctime, file_type, hash, attrs "
+    QSqlQuery query(reader());
+    query.prepare("SELECT id, directory_id, name, size, mtime, ctime, file_type, hash, attrs, fingerprint, "
+                  "inode, link_count "
                   "FROM files WHERE directory_id = ? "
                   "ORDER BY name");
     query.addBindValue(directoryId);
@@ -847,23 +1761,10 @@ QList<FileInfo> KatalogueDatabase::listFilesInDirectory(int directoryId) const {
     }
 
     while (query.next()) {
-        FileInfo info;
-        info.id = query.value(0).toInt();
-        info.directoryId = query.value(1).toInt();
-        info.name = query.value(2).toString();
+        FileInfo info = fileFromQuery(query);
         info.fullPath = basePath.isEmpty()
                             ? info.name
                             : QDir::cleanPath(basePath + '/' + info.name);
-        info.size = query.value(3).toLongLong();
-        if (!query.value(4).isNull()) {
-            info.mtime = QDateTime::fromSecsSinceEpoch(query.value(4).toLongLong(), Qt::UTC);
-        }
-        if (!query.value(5).isNull()) {
-            info.ctime = QDateTime::fromSecsSinceEpoch(query.value(5).toLongLong(), Qt::UTC);
-        }
-        info.fileType = query.value(6).toString();
-        info.hash = query.value(7).toString();
-        info.attrs = static_cast<quint32>(query.value(8).toUInt());
         files.append(info);
     }
 
@@ -875,8 +1776,8 @@ std::optional<DirectoryInfo> KatalogueDatabase::getDirectory(int directoryId) co
         return std::nullopt;
     }
 
-    QSqlQuery query(m_db);
-    query.prepare("SELECT id, volume_id, parent_id, name, full_path FROM directories WHERE id = ?");
+    QSqlQuery query(reader());
+    query.prepare("SELECT id, volume_id, parent_id, name, full_path, mtime, inode FROM directories WHERE id = ?");
     query.addBindValue(directoryId);
     if (!query.exec()) {
         qWarning() << "Failed to get directory" << query.lastError();
@@ -886,13 +1787,254 @@ std::optional<DirectoryInfo> KatalogueDatabase::getDirectory(int directoryId) co
         return std::nullopt;
     }
 
-    DirectoryInfo info;
-    info.id = query.value(0).toInt();
-    info.volumeId = query.value(1).toInt();
-    info.parentId = query.value(2).isNull() ? -1 : query.value(2).toInt();
-    info.name = query.value(3).toString();
-    info.fullPath = query.value(4).toString();
-    return info;
+    return directoryFromQuery(query);
+}
+
+std::optional<DirectoryInfo> KatalogueDatabase::findDirectoryByPath(int volumeId, const QString &fullPath) const {
+    if (!m_db.isOpen()) {
+        return std::nullopt;
+    }
+
+    QSqlQuery query(reader());
+    query.prepare("SELECT id, volume_id, parent_id, name, full_path, mtime, inode FROM directories "
+                  "WHERE volume_id = ? AND full_path = ?");
+    query.addBindValue(volumeId);
+    query.addBindValue(fullPath);
+    if (!query.exec()) {
+        qWarning() << "Failed to find directory" << query.lastError();
+        return std::nullopt;
+    }
+    if (!query.next()) {
+        return std::nullopt;
+    }
+
+    return directoryFromQuery(query);
+}
+
+std::optional<FileInfo> KatalogueDatabase::findFile(int directoryId, const QString &name) const {
+    if (!m_db.isOpen()) {
+        return std::nullopt;
+    }
+
+    QSqlQuery query(reader());
+    query.prepare("SELECT id, directory_id, name, size, mtime, ctime, file_type, hash, attrs, fingerprint, "
+                  "inode, link_count "
+                  "FROM files WHERE directory_id = ? AND name = ?");
+    query.addBindValue(directoryId);
+    query.addBindValue(name);
+    if (!query.exec()) {
+        qWarning() << "Failed to find file" << query.lastError();
+        return std::nullopt;
+    }
+    if (!query.next()) {
+        return std::nullopt;
+    }
+
+    return fileFromQuery(query);
+}
+
+QList<DirectoryInfo> KatalogueDatabase::listVolumeDirectories(int volumeId) const {
+    QList<DirectoryInfo> directories;
+    visitVolumeDirectories(volumeId, [&directories](const DirectoryInfo &directory) {
+        directories.append(directory);
+    });
+    return directories;
+}
+
+bool KatalogueDatabase::visitVolumeDirectories(int volumeId,
+                                               const std::function<void(const DirectoryInfo &)> &visitor) const {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(reader());
+    query.setForwardOnly(true);
+    query.prepare("SELECT id, volume_id, parent_id, name, full_path, mtime, inode "
+                  "FROM directories WHERE volume_id = ?");
+    query.addBindValue(volumeId);
+    if (!query.exec()) {
+        qWarning() << "Failed to list volume directories" << query.lastError();
+        return false;
+    }
+
+    while (query.next()) {
+        visitor(directoryFromQuery(query));
+    }
+    return true;
+}
+
+bool KatalogueDatabase::setDirectoryStamp(int directoryId, const QDateTime &mtime, quint64 inode) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE directories SET mtime = ?, inode = ? WHERE id = ?");
+    query.addBindValue(mtime.isValid() ? mtime.toSecsSinceEpoch() : QVariant(QVariant::LongLong));
+    query.addBindValue(inode > 0 ? QVariant(static_cast<qint64>(inode)) : QVariant(QVariant::LongLong));
+    query.addBindValue(directoryId);
+    if (!query.exec()) {
+        qWarning() << "Failed to update directory stamp" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool KatalogueDatabase::beginScanCheckpoint(int volumeId, const QString &rootPath, int rootDirectoryId) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    if (!beginBatch()) {
+        return false;
+    }
+
+    QSqlQuery clear(m_db);
+    clear.prepare("DELETE FROM scan_checkpoints WHERE volume_id = ?");
+    clear.addBindValue(volumeId);
+
+    QSqlQuery insert(m_db);
+    insert.prepare("INSERT INTO scan_checkpoints (volume_id, root_path, updated_at) VALUES (?, ?, ?)");
+    insert.addBindValue(volumeId);
+    insert.addBindValue(rootPath);
+    insert.addBindValue(QDateTime::currentSecsSinceEpoch());
+
+    if (!clear.exec() || !insert.exec() || !addCheckpointDirectory(volumeId, rootDirectoryId, 0)) {
+        qWarning() << "Failed to create scan checkpoint" << clear.lastError() << insert.lastError();
+        abortBatch();
+        return false;
+    }
+
+    return endBatch();
+}
+
+bool KatalogueDatabase::addCheckpointDirectory(int volumeId, int directoryId, int depth) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR IGNORE INTO scan_checkpoint_directories (directory_id, volume_id, depth) "
+                  "VALUES (?, ?, ?)");
+    query.addBindValue(directoryId);
+    query.addBindValue(volumeId);
+    query.addBindValue(depth);
+    if (!query.exec()) {
+        qWarning() << "Failed to add checkpoint directory" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool KatalogueDatabase::removeCheckpointDirectory(int directoryId) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM scan_checkpoint_directories WHERE directory_id = ?");
+    query.addBindValue(directoryId);
+    if (!query.exec()) {
+        qWarning() << "Failed to remove checkpoint directory" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool KatalogueDatabase::updateScanCheckpoint(int volumeId,
+                                             int directories,
+                                             int files,
+                                             qint64 totalBytes,
+                                             qint64 uniqueBytes) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE scan_checkpoints SET directories = ?, files = ?, total_bytes = ?, unique_bytes = ?, "
+                  "updated_at = ? WHERE volume_id = ?");
+    query.addBindValue(directories);
+    query.addBindValue(files);
+    query.addBindValue(totalBytes);
+    query.addBindValue(uniqueBytes);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    query.addBindValue(volumeId);
+    if (!query.exec()) {
+        qWarning() << "Failed to update scan checkpoint" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool KatalogueDatabase::clearScanCheckpoint(int volumeId) {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM scan_checkpoints WHERE volume_id = ?");
+    query.addBindValue(volumeId);
+    if (!query.exec()) {
+        qWarning() << "Failed to clear scan checkpoint" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+std::optional<ScanCheckpoint> KatalogueDatabase::scanCheckpoint(int volumeId) const {
+    if (!m_db.isOpen()) {
+        return std::nullopt;
+    }
+
+    QSqlQuery query(reader());
+    query.prepare("SELECT volume_id, root_path, directories, files, total_bytes, updated_at, unique_bytes "
+                  "FROM scan_checkpoints WHERE volume_id = ?");
+    query.addBindValue(volumeId);
+    if (!query.exec()) {
+        qWarning() << "Failed to read scan checkpoint" << query.lastError();
+        return std::nullopt;
+    }
+    if (!query.next()) {
+        return std::nullopt;
+    }
+
+    ScanCheckpoint checkpoint;
+    checkpoint.volumeId = query.value(0).toInt();
+    checkpoint.rootPath = query.value(1).toString();
+    checkpoint.directories = query.value(2).toInt();
+    checkpoint.files = query.value(3).toInt();
+    checkpoint.totalBytes = query.value(4).toLongLong();
+    if (!query.value(5).isNull()) {
+        checkpoint.updatedAt = QDateTime::fromSecsSinceEpoch(query.value(5).toLongLong(), Qt::UTC);
+    }
+    checkpoint.uniqueBytes = query.value(6).toLongLong();
+    return checkpoint;
+}
+
+bool KatalogueDatabase::visitCheckpointDirectories(
+    int volumeId,
+    const std::function<void(const DirectoryInfo &, int depth)> &visitor) const {
+    if (!m_db.isOpen()) {
+        return false;
+    }
+
+    QSqlQuery query(reader());
+    query.setForwardOnly(true);
+    query.prepare("SELECT directories.id, directories.volume_id, directories.parent_id, directories.name, "
+                  "directories.full_path, directories.mtime, directories.inode, scan_checkpoint_directories.depth "
+                  "FROM scan_checkpoint_directories "
+                  "JOIN directories ON directories.id = scan_checkpoint_directories.directory_id "
+                  "WHERE scan_checkpoint_directories.volume_id = ?");
+    query.addBindValue(volumeId);
+    if (!query.exec()) {
+        qWarning() << "Failed to list checkpoint directories" << query.lastError();
+        return false;
+    }
+
+    while (query.next()) {
+        visitor(directoryFromQuery(query), query.value(7).toInt());
+    }
+    return true;
 }
 
 std::optional<QString> KatalogueDatabase::getVolumeLabel(int volumeId) const {
@@ -900,7 +2042,7 @@ std::optional<QString> KatalogueDatabase::getVolumeLabel(int volumeId) const {
         return std::nullopt;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     query.prepare("SELECT label FROM volumes WHERE id = ?");
     query.addBindValue(volumeId);
     if (!query.exec()) {
@@ -923,7 +2065,7 @@ std::optional<QString> KatalogueDatabase::getNoteForFile(int fileId) const {
         return std::nullopt;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     query.prepare("SELECT content FROM notes WHERE target_type = ? AND target_id = ?");
     query.addBindValue(QStringLiteral("file"));
     query.addBindValue(fileId);
@@ -942,7 +2084,7 @@ std::optional<QString> KatalogueDatabase::getNoteForDirectory(int directoryId) c
         return std::nullopt;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     query.prepare("SELECT content FROM notes WHERE target_type = ? AND target_id = ?");
     query.addBindValue(QStringLiteral("directory"));
     query.addBindValue(directoryId);
@@ -1138,7 +2280,7 @@ QList<QPair<QString, QString>> KatalogueDatabase::tagsForFile(int fileId) const
         return tags;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     query.prepare("SELECT tags.key, tags.value "
                   "FROM tags "
                   "JOIN file_tags ON file_tags.tag_id = tags.id "
@@ -1181,7 +2323,7 @@ QList<SearchResult> KatalogueDatabase::listAllFiles(const std::optional<int> &vo
         return results;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     if (volumeId.has_value()) {
         query.prepare(
             "SELECT files.id, files.directory_id, directories.volume_id, files.name, "
@@ -1289,7 +2431,7 @@ QList<VirtualFolderInfo> KatalogueDatabase::listVirtualFolders(int parentId) con
         return folders;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     if (parentId < 0) {
         query.prepare("SELECT id, parent_id, name FROM virtual_folders "
                       "WHERE parent_id IS NULL OR parent_id = -1 "
@@ -1318,7 +2460,7 @@ std::optional<VirtualFolderInfo> KatalogueDatabase::getVirtualFolder(int folderI
     if (!m_db.isOpen() || folderId < 0) {
         return std::nullopt;
     }
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     query.prepare("SELECT id, parent_id, name FROM virtual_folders WHERE id = ?");
     query.addBindValue(folderId);
     if (!query.exec()) {
@@ -1371,7 +2513,7 @@ QList<SearchResult> KatalogueDatabase::listVirtualFolderItems(int folderId) cons
         return results;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     query.prepare(
         "SELECT files.id, files.directory_id, directories.volume_id, files.name, "
         "directories.full_path || '/' || files.name AS full_path, "
@@ -1408,8 +2550,13 @@ bool KatalogueDatabase::beginBatch() {
     if (!m_db.isOpen() || m_inBatch) {
         return false;
     }
-    if (!m_db.transaction()) {
-        qWarning() << "Failed to begin batch transaction" << m_db.lastError();
+    // Take the write lock up front: a deferred transaction that has already
+    // read cannot wait for another connection's writes without deadlocking.
+    m_writeTurns->acquire();
+    QSqlQuery query(m_db);
+    if (!query.exec(QStringLiteral("BEGIN IMMEDIATE"))) {
+        qWarning() << "Failed to begin batch transaction" << query.lastError();
+        m_writeTurns->release();
         return false;
     }
     m_inBatch = true;
@@ -1421,16 +2568,88 @@ bool KatalogueDatabase::endBatch() {
         return false;
     }
     m_inBatch = false;
-    if (!m_db.commit()) {
+    const bool committed = m_db.commit();
+    if (!committed) {
         qWarning() << "Failed to commit batch transaction" << m_db.lastError();
         m_db.rollback();
+    }
+    m_writeTurns->release();
+    return committed;
+}
+
+qint64 KatalogueDatabase::reclaimableBytes() const {
+    if (!m_db.isOpen()) {
+        return -1;
+    }
+
+    QSqlQuery query(reader());
+    if (!query.exec(QStringLiteral("PRAGMA freelist_count")) || !query.next()) {
+        qWarning() << "Failed to count free pages" << query.lastError();
+        return -1;
+    }
+    const qint64 pages = query.value(0).toLongLong();
+    if (!query.exec(QStringLiteral("PRAGMA page_size")) || !query.next()) {
+        qWarning() << "Failed to read page size" << query.lastError();
+        return -1;
+    }
+    return pages * query.value(0).toLongLong();
+}
+
+bool KatalogueDatabase::compact() {
+    if (!m_db.isOpen() || m_inBatch) {
         return false;
     }
-    return true;
+    // VACUUM fails while any statement on the connection is still active.
+    m_statements.clear();
+    m_writeTurns->acquire();
+    QSqlQuery query(m_db);
+    const bool compacted = query.exec(QStringLiteral("VACUUM"));
+    if (!compacted) {
+        qWarning() << "Failed to compact catalog" << query.lastError();
+    }
+    m_writeTurns->release();
+    return compacted;
+}
+
+bool KatalogueDatabase::inBatch() const {
+    return m_inBatch;
+}
+
+bool KatalogueDatabase::hasWaitingWriters() const {
+    return m_writeTurns && m_writeTurns->hasWaiters();
+}
+
+void KatalogueDatabase::abortBatch() {
+    if (!m_inBatch) {
+        return;
+    }
+    m_inBatch = false;
+    m_db.rollback();
+    m_writeTurns->release();
+}
+
+QSqlQuery &KatalogueDatabase::cachedQuery(const QString &statement) {
+    auto it = m_statements.find(statement);
+    if (it == m_statements.end()) {
+        QSqlQuery query(m_db);
+        query.setForwardOnly(true);
+        if (!query.prepare(statement)) {
+            qWarning() << "Failed to prepare statement" << query.lastError();
+        }
+        it = m_statements.insert(statement, query);
+    }
+    return *it;
+}
+
+QSqlDatabase KatalogueDatabase::reader() const {
+    if (!m_readers || QThread::currentThread() == m_writerThread) {
+        return m_db;
+    }
+    return m_readers->forCurrentThread();
 }
 
 QString KatalogueDatabase::directoryFullPath(int directoryId) const {
-    QSqlQuery query(m_db);
+    QSqlQuery query(reader());
     query.prepare("SELECT full_path FROM directories WHERE id = ?");
     query.addBindValue(directoryId);
     if (!query.exec()) {
@@ -1,9 +1,20 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <span>
+
+#include <QHash>
 #include <QSqlDatabase>
+#include <QSqlQuery>
 
 #include "katalogue_types.h"
 
+class CatalogReaders;
+class CatalogWriteTurns;
+class QThread;
+
 class KatalogueDatabase {
 public:
     KatalogueDatabase();
@@ -19,9 +30,22 @@ public:
     struct ProjectStats {
         int volumeCount = 0;
         qint64 fileCount = 0;
+        // Sum of file sizes; uniqueBytes counts each hardlinked inode of a
+        // volume only once.
         qint64 totalBytes = 0;
+        qint64 uniqueBytes = 0;
+    };
+
+    struct HashCandidate {
+        int fileId = -1;
+        QString localPath;
     };
 
+    // Opens the catalog in WAL mode where the filesystem allows it. The
+    // const queries below may also be called from other threads: those get a
+    // read-only connection of their own, which sees the last committed state
+    // instead of waiting for an open batch. Calls from the opening thread
+    // keep using the writer connection and see its uncommitted rows.
     bool openProject(const QString &path);
     bool isOpen() const;
     SchemaStatus checkSchema() const;
@@ -31,16 +55,70 @@ public:
     int upsertVolume(const VolumeInfo &info);
     std::optional<VolumeInfo> findVolumeByFsUuid(const QString &fsUuid) const;
     bool clearVolumeContents(int volumeId);
+    // Removes the volume with everything catalogued on it.
+    bool deleteVolume(int volumeId);
     int upsertDirectory(const DirectoryInfo &info);
     int insertFile(const FileInfo &info);
     int upsertFile(const FileInfo &info);
+    // Bulk forms of upsertDirectory()/upsertFile() for new rows: one
+    // multi-row INSERT ... ON CONFLICT DO UPDATE ... RETURNING per chunk, in
+    // key order ((volume_id, full_path) and (directory_id, name)) so the
+    // B-tree pages being filled stay hot. Rows that already exist are
+    // updated (directories keep their stamps). Sets the id of every element.
+    bool insertDirectories(std::span<DirectoryInfo> directories);
+    bool insertFiles(std::span<FileInfo> files);
     bool deleteFile(int fileId);
+    bool setFileHash(int fileId, const QString &hash);
+    bool setFileFingerprint(int fileId, const QString &fingerprint);
+    QList<HashCandidate> fingerprintCollisions(int limit, int offset = 0) const;
+    bool deleteDirectory(int directoryId);
 
     QList<VolumeInfo> listVolumes() const;
     std::optional<ProjectStats> projectStats() const;
     QList<DirectoryInfo> listDirectories(int volumeId, int parentId) const;
     QList<FileInfo> listFilesInDirectory(int directoryId) const;
     std::optional<DirectoryInfo> getDirectory(int directoryId) const;
+    std::optional<DirectoryInfo> findDirectoryByPath(int volumeId, const QString &fullPath) const;
+    std::optional<FileInfo> findFile(int directoryId, const QString &name) const;
+    QList<DirectoryInfo> listVolumeDirectories(int volumeId) const;
+    // Streams the rows instead of materializing them; for volume-sized walks.
+    bool visitVolumeDirectories(int volumeId,
+                                const std::function<void(const DirectoryInfo &)> &visitor) const;
+    bool setDirectoryStamp(int directoryId, const QDateTime &mtime, quint64 inode);
+
+    // Bulk loads: marking a volume stale drops its files from the full-text
+    // index, and until it is rebuilt search() misses the whole volume.
+    // rebuildSearchIndex() indexes the whole volume in one statement and
+    // clears the mark in a batch of its own, so it must not run inside one.
+    bool setSearchIndexStale(int volumeId);
+    QList<int> staleSearchIndexVolumes() const;
+    bool rebuildSearchIndex(int volumeId);
+
+    // Optional trigram index over file names, chosen per catalog. With it,
+    // search() also matches plain words of three or more characters
+    // anywhere inside a name. Enabling indexes every file that is not
+    // stale, so it takes a while on large catalogs; runs as a batch of its
+    // own.
+    bool setSubstringIndex(bool enabled);
+    bool hasSubstringIndex() const;
+
+    // Space held by free pages, e.g. those of the search index dropped by
+    // the v9 migration. compact() hands it back to the filesystem by
+    // rewriting the whole catalog: slow on large catalogs, needs about the
+    // catalog's size in free disk space, and must not run inside a batch.
+    qint64 reclaimableBytes() const;
+    bool compact();
+
+    // Scan checkpoints: the frontier of directories whose listing has not
+    // been committed yet, maintained in the same transactions as the rows.
+    bool beginScanCheckpoint(int volumeId, const QString &rootPath, int rootDirectoryId);
+    bool addCheckpointDirectory(int volumeId, int directoryId, int depth);
+    bool removeCheckpointDirectory(int directoryId);
+    bool updateScanCheckpoint(int volumeId, int directories, int files, qint64 totalBytes, qint64 uniqueBytes);
+    bool clearScanCheckpoint(int volumeId);
+    std::optional<ScanCheckpoint> scanCheckpoint(int volumeId) const;
+    bool visitCheckpointDirectories(int volumeId,
+                                    const std::function<void(const DirectoryInfo &, int depth)> &visitor) const;
     std::optional<QString> getVolumeLabel(int volumeId) const;
 
     struct SearchFilters {
@@ -78,15 +156,34 @@ public:
     bool removeFileFromVirtualFolder(int folderId, int fileId);
     QList<SearchResult> listVirtualFolderItems(int folderId) const;
 
+    // Batches are write transactions. Connections to the same catalog in
+    // this process take turns in arrival order, so concurrent scans
+    // interleave their batches instead of starving each other.
     bool beginBatch();
     bool endBatch();
+    // Rolls back the open batch and hands the write turn on.
+    void abortBatch();
+    bool inBatch() const;
+    // Another connection to the catalog is waiting for the write turn.
+    bool hasWaitingWriters() const;
 
 private:
     bool initializeSchema();
     QString directoryFullPath(int directoryId) const;
+    // Connection for queries from the calling thread.
+    QSqlDatabase reader() const;
+    // Prepared once per writer connection and reused.
+    QSqlQuery &cachedQuery(const QString &statement);
 
     QSqlDatabase m_db;
     QString m_connectionName;
     mutable QString m_lastErrorString;
+    std::shared_ptr<CatalogWriteTurns> m_writeTurns;
+    std::unique_ptr<CatalogReaders> m_readers;
+    QHash<QString, QSqlQuery> m_statements;
+    QThread *m_writerThread = nullptr;
     bool m_inBatch = false;
+    // Schema generation << 1 | whether the trigram index exists; -1 until
+    // first asked.
+    mutable std::atomic<qint64> m_substringIndex{-1};
 };
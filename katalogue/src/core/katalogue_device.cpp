@@ -0,0 +1,132 @@
+#include "katalogue_device.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QStorageInfo>
+
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/sysmacros.h>
+#endif
+
+#if defined(__linux__)
+namespace {
+// Whole-disk name for a block device number, or an empty string when the
+// number is not a block device known to sysfs.
+QString diskForDevice(dev_t device) {
+    QString path = QFileInfo(QStringLiteral("/sys/dev/block/%1:%2").arg(major(device)).arg(minor(device)))
+                       .canonicalFilePath();
+    if (path.isEmpty()) {
+        return {};
+    }
+    // .../block/sda/sda1 -> .../block/sda
+    if (QFileInfo::exists(path + QStringLiteral("/partition"))) {
+        path = QFileInfo(path).path();
+    }
+    return QFileInfo(path).fileName();
+}
+
+// Disk behind a path: its own device number first, then the mount source
+// for filesystems with anonymous device numbers.
+QString diskForPath(const QString &path, const struct stat &st) {
+    QString disk = diskForDevice(st.st_dev);
+    if (disk.isEmpty()) {
+        const QByteArray source = QStorageInfo(path).device();
+        struct stat sourceStat;
+        if (source.startsWith("/dev/") && ::stat(source.constData(), &sourceStat) == 0
+            && S_ISBLK(sourceStat.st_mode)) {
+            disk = diskForDevice(sourceStat.st_rdev);
+        }
+    }
+    return disk;
+}
+} // namespace
+#endif
+
+QString deviceKeyForPath(const QString &path) {
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0) {
+        return {};
+    }
+#if defined(__linux__)
+    const QString disk = diskForPath(path, st);
+    if (!disk.isEmpty()) {
+        return QStringLiteral("block:") + disk;
+    }
+    return QStringLiteral("dev:%1:%2").arg(major(st.st_dev)).arg(minor(st.st_dev));
+#else
+    return QStringLiteral("dev:%1").arg(static_cast<qulonglong>(st.st_dev));
+#endif
+}
+
+bool isRotationalPath(const QString &path) {
+#if defined(__linux__)
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0) {
+        return false;
+    }
+    const QString disk = diskForPath(path, st);
+    if (disk.isEmpty()) {
+        return false;
+    }
+    QFile flag(QStringLiteral("/sys/block/%1/queue/rotational").arg(disk));
+    return flag.open(QIODevice::ReadOnly) && flag.readAll().trimmed() == "1";
+#else
+    Q_UNUSED(path);
+    return false;
+#endif
+}
+
+QStringList defaultSkippedFilesystemTypes() {
+    return {QStringLiteral("proc"), QStringLiteral("sysfs"), QStringLiteral("cgroup"), QStringLiteral("cgroup2"),
+            QStringLiteral("devpts"), QStringLiteral("devtmpfs"), QStringLiteral("debugfs"),
+            QStringLiteral("tracefs"), QStringLiteral("securityfs"), QStringLiteral("pstore"),
+            QStringLiteral("bpf"), QStringLiteral("configfs"), QStringLiteral("efivarfs"),
+            QStringLiteral("mqueue"), QStringLiteral("hugetlbfs"), QStringLiteral("binfmt_misc"),
+            QStringLiteral("autofs"), QStringLiteral("fusectl"), QStringLiteral("nsfs"),
+            QStringLiteral("rpc_pipefs"), QStringLiteral("fuse.*")};
+}
+
+MountTable::MountTable() {
+#if defined(__linux__)
+    // "36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw"; the
+    // optional fields end at " - ", after which comes the type.
+    QFile mountInfo(QStringLiteral("/proc/self/mountinfo"));
+    if (!mountInfo.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+    while (!mountInfo.atEnd()) {
+        const QByteArray line = mountInfo.readLine();
+        const QList<QByteArray> fields = line.split(' ');
+        const qsizetype separator = fields.indexOf(QByteArrayLiteral("-"));
+        if (fields.size() < 3 || separator < 0 || separator + 1 >= fields.size()) {
+            continue;
+        }
+        const QList<QByteArray> numbers = fields.at(2).split(':');
+        bool majorOk = false;
+        bool minorOk = false;
+        const unsigned int deviceMajor = numbers.value(0).toUInt(&majorOk);
+        const unsigned int deviceMinor = numbers.value(1).toUInt(&minorOk);
+        if (majorOk && minorOk) {
+            m_types.insert(static_cast<quint64>(makedev(deviceMajor, deviceMinor)),
+                           QString::fromUtf8(fields.at(separator + 1)));
+        }
+    }
+#endif
+}
+
+QString MountTable::filesystemType(quint64 device) const {
+    return m_types.value(device);
+}
+
+bool MountTable::matchesType(const QString &fsType, const QStringList &types) {
+    if (fsType.isEmpty()) {
+        return false;
+    }
+    for (const QString &type : types) {
+        if (type.endsWith(QLatin1Char('*')) ? fsType.startsWith(QStringView(type).chopped(1)) : fsType == type) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+// Identifies the physical device a path lives on, so scans of the same disk
+// can be serialized while different disks are scanned in parallel.
+// Partitions resolve to their whole disk through sysfs ("block:sda");
+// filesystems with anonymous device numbers (btrfs subvolumes, overlays)
+// go through their mount source, and anything without a block device
+// (network and virtual filesystems) is keyed by st_dev ("dev:0:52").
+// Returns an empty string when the path cannot be stat'ed.
+QString deviceKeyForPath(const QString &path);
+
+// True when the disk behind path reports itself as rotational in sysfs
+// (queue/rotational), as hard disks and optical drives do. False for
+// solid-state media and whenever it cannot be determined.
+bool isRotationalPath(const QString &path);
+
+// Kernel and virtual filesystems a scan never wants to descend into, plus
+// FUSE mounts (fuse.*), which are often slow or remote.
+QStringList defaultSkippedFilesystemTypes();
+
+// Filesystem type per device number (st_dev) from /proc/self/mountinfo,
+// read once. Always empty on other systems.
+class MountTable {
+public:
+    MountTable();
+
+    bool isEmpty() const { return m_types.isEmpty(); }
+    // Empty when the device is not mounted (or has an anonymous number,
+    // as btrfs subvolumes do).
+    QString filesystemType(quint64 device) const;
+    // types may end in '*' to match a prefix, as in "fuse.*".
+    static bool matchesType(const QString &fsType, const QStringList &types);
+
+private:
+    QHash<quint64, QString> m_types;
+};
@@ -0,0 +1,146 @@
+#include "katalogue_exclude.h"
+
+namespace {
+bool hasWildcard(QStringView glob) {
+    return glob.contains(QLatin1Char('*')) || glob.contains(QLatin1Char('?')) || glob.contains(QLatin1Char('['));
+}
+
+QString globToExpression(QStringView glob) {
+    QString expression;
+    for (qsizetype i = 0; i < glob.size(); ++i) {
+        const QChar c = glob[i];
+        if (c == QLatin1Char('*')) {
+            if (i + 1 < glob.size() && glob[i + 1] == QLatin1Char('*')) {
+                ++i;
+                if (i + 1 < glob.size() && glob[i + 1] == QLatin1Char('/')) {
+                    // "**/" also matches no directory at all.
+                    ++i;
+                    expression += QStringLiteral("(?:.*/)?");
+                } else {
+                    expression += QStringLiteral(".*");
+                }
+            } else {
+                expression += QStringLiteral("[^/]*");
+            }
+        } else if (c == QLatin1Char('?')) {
+            expression += QStringLiteral("[^/]");
+        } else if (c == QLatin1Char('[')) {
+            qsizetype j = i + 1;
+            const bool negated = j < glob.size() && (glob[j] == QLatin1Char('!') || glob[j] == QLatin1Char('^'));
+            if (negated) {
+                ++j;
+            }
+            if (j < glob.size() && glob[j] == QLatin1Char(']')) {
+                ++j;
+            }
+            const qsizetype close = glob.indexOf(QLatin1Char(']'), j);
+            if (close < 0) {
+                expression += QStringLiteral("\\[");
+                continue;
+            }
+            const qsizetype start = i + 1 + (negated ? 1 : 0);
+            QString set = glob.mid(start, close - start).toString();
+            set.replace(QLatin1Char('\\'), QStringLiteral("\\\\"));
+            set.replace(QLatin1Char('['), QStringLiteral("\\["));
+            expression += QLatin1Char('[') + (negated ? QStringLiteral("^") : QString()) + set + QLatin1Char(']');
+            i = close;
+        } else {
+            expression += QRegularExpression::escape(QString(c));
+        }
+    }
+    return expression;
+}
+
+QRegularExpression compileAlternation(const QStringList &expressions) {
+    if (expressions.isEmpty()) {
+        return {};
+    }
+    QRegularExpression regex(QRegularExpression::anchoredPattern(QStringLiteral("(?:")
+                                                                 + expressions.join(QStringLiteral(")|(?:"))
+                                                                 + QLatin1Char(')')),
+                             QRegularExpression::CaseInsensitiveOption);
+    regex.optimize();
+    return regex;
+}
+
+bool isSet(const QRegularExpression &regex) {
+    return !regex.pattern().isEmpty() && regex.isValid();
+}
+} // namespace
+
+ExcludeMatcher::ExcludeMatcher(const QStringList &patterns) {
+    QStringList nameExpressions;
+    QStringList pathExpressions;
+    QStringList contentsExpressions;
+
+    for (QString pattern : patterns) {
+        pattern = pattern.trimmed();
+        while (pattern.endsWith(QLatin1Char('/'))) {
+            pattern.chop(1);
+        }
+        while (pattern.startsWith(QLatin1Char('/'))) {
+            pattern.remove(0, 1);
+        }
+        if (pattern.isEmpty()) {
+            continue;
+        }
+        m_empty = false;
+
+        if (!pattern.contains(QLatin1Char('/'))) {
+            const QStringView extension = QStringView(pattern).mid(2);
+            if (!hasWildcard(pattern)) {
+                m_names.insert(pattern.toCaseFolded());
+            } else if (pattern.startsWith(QLatin1String("*.")) && !hasWildcard(extension)
+                       && !extension.contains(QLatin1Char('.'))) {
+                m_suffixes.insert(extension.toString().toCaseFolded());
+            } else {
+                nameExpressions.append(globToExpression(pattern));
+            }
+            continue;
+        }
+
+        pathExpressions.append(globToExpression(pattern));
+        for (const QLatin1String tail : {QLatin1String("/**"), QLatin1String("/*")}) {
+            if (pattern.endsWith(tail)) {
+                contentsExpressions.append(globToExpression(QStringView(pattern).chopped(tail.size())));
+                break;
+            }
+        }
+    }
+
+    m_nameExpression = compileAlternation(nameExpressions);
+    m_pathExpression = compileAlternation(pathExpressions);
+    m_contentsExpression = compileAlternation(contentsExpressions);
+}
+
+bool ExcludeMatcher::isEmpty() const {
+    return m_empty;
+}
+
+bool ExcludeMatcher::hasPathPatterns() const {
+    return isSet(m_pathExpression);
+}
+
+bool ExcludeMatcher::isExcluded(const QString &relativePath, const QString &name) const {
+    if (m_empty) {
+        return false;
+    }
+    if (!m_names.isEmpty() && m_names.contains(name.toCaseFolded())) {
+        return true;
+    }
+    if (!m_suffixes.isEmpty()) {
+        const qsizetype dot = name.lastIndexOf(QLatin1Char('.'));
+        if (dot >= 0 && m_suffixes.contains(name.mid(dot + 1).toCaseFolded())) {
+            return true;
+        }
+    }
+    if (isSet(m_nameExpression) && m_nameExpression.match(name).hasMatch()) {
+        return true;
+    }
+    return isSet(m_pathExpression) && !relativePath.isEmpty() && m_pathExpression.match(relativePath).hasMatch();
+}
+
+bool ExcludeMatcher::excludesContents(const QString &relativePath) const {
+    return isSet(m_contentsExpression) && !relativePath.isEmpty()
+           && m_contentsExpression.match(relativePath).hasMatch();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+// Scanner exclude patterns, compiled once per scan. Patterns without a '/'
+// match an entry's name at any depth; patterns containing one are anchored
+// at the scan root and match the entry's relative path. Like QDir::match()
+// matching is case-insensitive and '*'/'?' never cross a '/'; "**" does.
+class ExcludeMatcher {
+public:
+    explicit ExcludeMatcher(const QStringList &patterns = {});
+
+    bool isEmpty() const;
+    // Only path patterns need the relative path, so listers can skip building it.
+    bool hasPathPatterns() const;
+
+    bool isExcluded(const QString &relativePath, const QString &name) const;
+    // True when a pattern such as "build/*" drops everything below the
+    // directory, which can then be recorded without being listed.
+    bool excludesContents(const QString &relativePath) const;
+
+private:
+    // Literal names and "*.ext" suffixes are set lookups; everything else
+    // goes into one alternation per kind.
+    QSet<QString> m_names;
+    QSet<QString> m_suffixes;
+    QRegularExpression m_nameExpression;
+    QRegularExpression m_pathExpression;
+    QRegularExpression m_contentsExpression;
+    bool m_empty = true;
+};
@@ -0,0 +1,377 @@
+#include "katalogue_hasher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <QCryptographicHash>
+#include <QThread>
+
+#include "katalogue_xxh64.h"
+
+namespace {
+int openForHashing(const QByteArray &path) {
+    const int flags = O_RDONLY | O_CLOEXEC;
+#ifdef O_NOATIME
+    // Hashing should not bump atimes on the volume; O_NOATIME is refused for
+    // files we do not own, so retry without it.
+    const int fd = ::open(path.constData(), flags | O_NOATIME);
+    if (fd >= 0 || errno != EPERM) {
+        return fd;
+    }
+#endif
+    return ::open(path.constData(), flags);
+}
+
+void adviseSequential(int fd) {
+#ifdef POSIX_FADV_SEQUENTIAL
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    Q_UNUSED(fd);
+#endif
+}
+
+void adviseWillNeed(int fd, qint64 offset, qint64 length) {
+#ifdef POSIX_FADV_WILLNEED
+    ::posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+#endif
+}
+
+// Hashed data is not read again soon; keep it from evicting the page cache.
+void adviseDontNeed(int fd) {
+#ifdef POSIX_FADV_DONTNEED
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+    Q_UNUSED(fd);
+#endif
+}
+constexpr qint64 fingerprintBlock = 64 * 1024;
+
+bool readFully(int fd, char *data, qint64 length, qint64 offset) {
+    while (length > 0) {
+        const ssize_t n = ::pread(fd, data, static_cast<size_t>(length), offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= n;
+        offset += n;
+    }
+    return true;
+}
+
+QString formatDigest(HashAlgorithm algorithm, const QString &hex) {
+    return FileHasher::algorithmName(algorithm) + QLatin1Char(':') + hex;
+}
+
+QString xxhHex(std::uint64_t digest) {
+    return QStringLiteral("%1").arg(digest, 16, 16, QLatin1Char('0'));
+}
+} // namespace
+
+FileHasher::FileHasher(const Options &options)
+    : m_options(options) {
+    m_options.chunkSize = std::max<qint64>(m_options.chunkSize, 64 * 1024);
+    m_options.maxInFlightBytes = std::max(m_options.maxInFlightBytes, m_options.chunkSize);
+    m_options.maxQueuedJobs = std::max(m_options.maxQueuedJobs, 1);
+
+    const int threads = effectiveThreadCount(m_options);
+    m_threads.reserve(static_cast<size_t>(threads));
+    for (int i = 0; i < threads; ++i) {
+        m_threads.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+FileHasher::~FileHasher() {
+    cancel();
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+int FileHasher::effectiveThreadCount(const Options &options) {
+    if (options.threads > 0) {
+        return options.threads;
+    }
+    // Hashing is bound by the source device long before the CPU, so a few
+    // readers are enough to keep it busy.
+    return std::clamp(QThread::idealThreadCount() / 2, 1, 4);
+}
+
+bool FileHasher::submit(Job job) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobTaken.wait(lock, [this]() {
+        return m_stopping || static_cast<int>(queuedJobs()) < m_options.maxQueuedJobs;
+    });
+    if (m_stopping) {
+        return false;
+    }
+    pushJob(std::move(job));
+    m_jobAvailable.notify_one();
+    return true;
+}
+
+size_t FileHasher::queuedJobs() const {
+    return m_options.ordered ? m_orderedJobs.size() : m_jobs.size();
+}
+
+void FileHasher::pushJob(Job job) {
+    if (m_options.ordered) {
+        const quint64 key = job.sortKey;
+        m_orderedJobs.emplace(key, std::move(job));
+    } else {
+        m_jobs.push_back(std::move(job));
+    }
+}
+
+FileHasher::Job FileHasher::popJob() {
+    if (m_options.ordered) {
+        auto next = m_orderedJobs.lower_bound(m_sweepPosition);
+        if (next == m_orderedJobs.end()) {
+            next = m_orderedJobs.begin();
+        }
+        m_sweepPosition = next->first;
+        Job job = std::move(next->second);
+        m_orderedJobs.erase(next);
+        return job;
+    }
+    Job job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    return job;
+}
+
+void FileHasher::takeResults(std::vector<Result> &out) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (out.empty()) {
+        out.swap(m_results);
+        return;
+    }
+    std::move(m_results.begin(), m_results.end(), std::back_inserter(out));
+    m_results.clear();
+}
+
+bool FileHasher::waitForIdle(int timeoutMs) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_idle.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() {
+        return m_stopping || (queuedJobs() == 0 && m_active == 0);
+    });
+}
+
+void FileHasher::cancel() {
+    m_cancelled.store(true);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_jobs.clear();
+        m_orderedJobs.clear();
+    }
+    m_jobAvailable.notify_all();
+    m_jobTaken.notify_all();
+    m_idle.notify_all();
+    m_budgetAvailable.notify_all();
+}
+
+bool FileHasher::acquireBytes(qint64 bytes) {
+    std::unique_lock<std::mutex> lock(m_budgetMutex);
+    m_budgetAvailable.wait(lock, [this, bytes]() {
+        return m_cancelled.load() || m_bytesInFlight + bytes <= m_options.maxInFlightBytes;
+    });
+    if (m_cancelled.load()) {
+        return false;
+    }
+    m_bytesInFlight += bytes;
+    return true;
+}
+
+void FileHasher::releaseBytes(qint64 bytes) {
+    {
+        std::lock_guard<std::mutex> lock(m_budgetMutex);
+        m_bytesInFlight -= bytes;
+    }
+    m_budgetAvailable.notify_all();
+}
+
+void FileHasher::workerLoop() {
+    if (m_options.threadSetup) {
+        m_options.threadSetup();
+    }
+    std::vector<char> buffer(static_cast<size_t>(m_options.chunkSize));
+    // One chunk being hashed plus one being read ahead by the kernel.
+    const qint64 reservation = std::min(m_options.chunkSize * 2, m_options.maxInFlightBytes);
+    auto shouldStop = [this]() { return m_cancelled.load(std::memory_order_relaxed); };
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobAvailable.wait(lock, [this]() { return m_stopping || queuedJobs() > 0; });
+            if (m_stopping) {
+                return;
+            }
+            job = popJob();
+            ++m_active;
+        }
+        m_jobTaken.notify_one();
+
+        Result result;
+        result.key = job.key;
+        if (acquireBytes(reservation)) {
+            if (job.sampled) {
+                result.fingerprint = fingerprintFile(job.path, m_options.algorithm, buffer,
+                                                     &result.hash, &result.bytes);
+            } else {
+                result.hash = hashFile(job.path, m_options.algorithm, buffer, shouldStop, &result.bytes);
+            }
+            releaseBytes(reservation);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_results.push_back(std::move(result));
+            --m_active;
+        }
+        m_idle.notify_all();
+    }
+}
+
+QString FileHasher::hashFile(const QByteArray &path,
+                             HashAlgorithm algorithm,
+                             std::vector<char> &buffer,
+                             const std::function<bool()> &shouldStop,
+                             qint64 *bytesRead) {
+    if (buffer.empty()) {
+        buffer.resize(1024 * 1024);
+    }
+
+    const int fd = openForHashing(path);
+    if (fd < 0) {
+        return {};
+    }
+    adviseSequential(fd);
+
+    Xxh64 xxh;
+    QCryptographicHash blake(QCryptographicHash::Blake2b_256);
+    const qint64 chunk = static_cast<qint64>(buffer.size());
+    qint64 offset = 0;
+    bool ok = true;
+
+    for (;;) {
+        if (shouldStop && shouldStop()) {
+            ok = false;
+            break;
+        }
+        adviseWillNeed(fd, offset + chunk, chunk);
+        const ssize_t n = ::read(fd, buffer.data(), buffer.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (algorithm == HashAlgorithm::Blake2b) {
+            blake.addData(QByteArrayView(buffer.data(), static_cast<qsizetype>(n)));
+        } else {
+            xxh.update(buffer.data(), static_cast<size_t>(n));
+        }
+        offset += n;
+    }
+
+    adviseDontNeed(fd);
+    ::close(fd);
+
+    if (bytesRead) {
+        *bytesRead = offset;
+    }
+    if (!ok) {
+        return {};
+    }
+
+    return formatDigest(algorithm, algorithm == HashAlgorithm::Blake2b ? QString::fromLatin1(blake.result().toHex())
+                                                                       : xxhHex(xxh.digest()));
+}
+
+QString FileHasher::fingerprintFile(const QByteArray &path,
+                                    HashAlgorithm algorithm,
+                                    std::vector<char> &buffer,
+                                    QString *fullHash,
+                                    qint64 *bytesRead) {
+    if (buffer.size() < static_cast<size_t>(fingerprintBlock * 3)) {
+        buffer.resize(static_cast<size_t>(fingerprintBlock * 3));
+    }
+
+    const int fd = openForHashing(path);
+    if (fd < 0) {
+        return {};
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return {};
+    }
+    const qint64 size = static_cast<qint64>(st.st_size);
+
+    // Small files are read whole, which also yields their full hash for free.
+    const bool whole = size <= fingerprintBlock * 3;
+    qint64 read = 0;
+    bool ok = true;
+    Xxh64 xxh;
+    if (whole) {
+        ok = readFully(fd, buffer.data(), size, 0);
+        xxh.update(buffer.data(), static_cast<size_t>(size));
+        read = size;
+    } else {
+        const qint64 offsets[] = {0, size / 2 - fingerprintBlock / 2, size - fingerprintBlock};
+        for (const qint64 offset : offsets) {
+            if (!readFully(fd, buffer.data(), fingerprintBlock, offset)) {
+                ok = false;
+                break;
+            }
+            xxh.update(buffer.data(), static_cast<size_t>(fingerprintBlock));
+            read += fingerprintBlock;
+        }
+    }
+    ::close(fd);
+
+    if (bytesRead) {
+        *bytesRead = read;
+    }
+    if (!ok) {
+        return {};
+    }
+
+    if (whole && fullHash) {
+        *fullHash = formatDigest(algorithm,
+                                 algorithm == HashAlgorithm::Blake2b
+                                     ? QString::fromLatin1(QCryptographicHash::hash(
+                                           QByteArrayView(buffer.data(), static_cast<qsizetype>(size)),
+                                           QCryptographicHash::Blake2b_256).toHex())
+                                     : xxhHex(xxh.digest()));
+    }
+    return QString::number(size) + QLatin1Char(':') + xxhHex(xxh.digest());
+}
+
+QString FileHasher::algorithmName(HashAlgorithm algorithm) {
+    switch (algorithm) {
+    case HashAlgorithm::Blake2b:
+        return QStringLiteral("blake2b");
+    case HashAlgorithm::Xxh64:
+        break;
+    }
+    return QStringLiteral("xxh64");
+}
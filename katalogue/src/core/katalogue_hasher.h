@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+enum class HashAlgorithm {
+    Xxh64,
+    Blake2b
+};
+
+// Content hashing for the scanner. Files are streamed in large sequential
+// chunks on a small thread pool; the total size of the chunk buffers in use
+// is capped so hashing a volume of large files cannot balloon memory.
+class FileHasher {
+public:
+    struct Options {
+        // 0 picks a small default based on QThread::idealThreadCount().
+        int threads = 0;
+        qint64 chunkSize = 1024 * 1024;
+        qint64 maxInFlightBytes = 64 * 1024 * 1024;
+        int maxQueuedJobs = 4096;
+        HashAlgorithm algorithm = HashAlgorithm::Xxh64;
+        // Runs first on every hashing thread, e.g. to lower its I/O priority.
+        std::function<void()> threadSetup;
+        // Hand queued jobs out in one ascending sweep over Job::sortKey
+        // (wrapping at the end) instead of in submission order, for
+        // rotational media.
+        bool ordered = false;
+    };
+
+    struct Job {
+        qint64 key = -1;
+        QByteArray path;
+        // Only compute the sampled fingerprint instead of reading the whole file.
+        bool sampled = false;
+        // Inode or physical offset; only used with Options::ordered.
+        quint64 sortKey = 0;
+    };
+
+    struct Result {
+        qint64 key = -1;
+        // Empty when the file could not be read or hashing was cancelled.
+        // Sampled jobs leave hash empty unless the file was small enough to
+        // be read completely anyway.
+        QString hash;
+        QString fingerprint;
+        qint64 bytes = 0;
+    };
+
+    explicit FileHasher(const Options &options);
+    ~FileHasher();
+
+    FileHasher(const FileHasher &) = delete;
+    FileHasher &operator=(const FileHasher &) = delete;
+
+    // Blocks while maxQueuedJobs are already waiting. Returns false once cancelled.
+    bool submit(Job job);
+    // Moves finished results into out without blocking.
+    void takeResults(std::vector<Result> &out);
+    // Waits up to timeoutMs for every submitted job to finish.
+    bool waitForIdle(int timeoutMs);
+    void cancel();
+
+    static int effectiveThreadCount(const Options &options);
+
+    // Hashes one file; returns an empty string on error or when shouldStop()
+    // turns true between chunks. Formatted as "<algorithm>:<hex digest>".
+    static QString hashFile(const QByteArray &path,
+                            HashAlgorithm algorithm,
+                            std::vector<char> &buffer,
+                            const std::function<bool()> &shouldStop = {},
+                            qint64 *bytesRead = nullptr);
+    // Cheap identity check for large files: size plus an XXH64 over the head,
+    // middle and tail blocks, formatted as "<size>:<hex>". Equal fingerprints
+    // only mean the files might be equal; a full hash settles it.
+    static QString fingerprintFile(const QByteArray &path,
+                                   HashAlgorithm algorithm,
+                                   std::vector<char> &buffer,
+                                   QString *fullHash = nullptr,
+                                   qint64 *bytesRead = nullptr);
+    static QString algorithmName(HashAlgorithm algorithm);
+
+private:
+    void workerLoop();
+    bool acquireBytes(qint64 bytes);
+    void releaseBytes(qint64 bytes);
+    // Callers hold m_mutex.
+    size_t queuedJobs() const;
+    void pushJob(Job job);
+    Job popJob();
+
+    Options m_options;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::condition_variable m_jobTaken;
+    std::condition_variable m_idle;
+    std::deque<Job> m_jobs;
+    // Used instead of m_jobs with Options::ordered.
+    std::multimap<quint64, Job> m_orderedJobs;
+    quint64 m_sweepPosition = 0;
+    std::vector<Result> m_results;
+    int m_active = 0;
+    bool m_stopping = false;
+
+    std::mutex m_budgetMutex;
+    std::condition_variable m_budgetAvailable;
+    qint64 m_bytesInFlight = 0;
+
+    std::atomic_bool m_cancelled{false};
+};
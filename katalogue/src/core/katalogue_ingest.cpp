@@ -0,0 +1,277 @@
+#include "katalogue_ingest.h"
+
+#include <cmath>
+#include <vector>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QIODevice>
+
+#include "katalogue_database.h"
+#include "katalogue_mime.h"
+
+namespace {
+constexpr qint64 readChunkSize = 1 << 20;
+// Rows per write transaction; large enough that commits stay out of the way.
+constexpr qint64 batchRecords = 20000;
+
+struct InventoryRecord {
+    QByteArray path;
+    qint64 size = 0;
+    qint64 mtime = -1;
+    char type = 0;
+};
+
+bool parseRecord(const QByteArray &record, InventoryRecord &parsed) {
+    qsizetype end = record.size();
+    if (end > 0 && record.at(end - 1) == '\r') {
+        --end;
+    }
+    const qsizetype typeTab = record.lastIndexOf('\t', end - 1);
+    if (typeTab < 0 || end - typeTab != 2) {
+        return false;
+    }
+    const qsizetype mtimeTab = typeTab > 0 ? record.lastIndexOf('\t', typeTab - 1) : -1;
+    const qsizetype sizeTab = mtimeTab > 0 ? record.lastIndexOf('\t', mtimeTab - 1) : -1;
+    if (sizeTab < 0) {
+        return false;
+    }
+
+    bool ok = false;
+    parsed.size = record.mid(sizeTab + 1, mtimeTab - sizeTab - 1).toLongLong(&ok);
+    if (!ok || parsed.size < 0) {
+        return false;
+    }
+    const double mtime = record.mid(mtimeTab + 1, typeTab - mtimeTab - 1).toDouble(&ok);
+    parsed.mtime = ok && mtime >= 0 ? static_cast<qint64>(std::floor(mtime)) : -1;
+    parsed.type = record.at(typeTab + 1);
+    parsed.path = record.left(sizeTab);
+    return true;
+}
+
+QString parentPath(const QString &path) {
+    const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+    return slash <= 0 ? QStringLiteral("/") : path.left(slash);
+}
+} // namespace
+
+bool InventoryIngester::ingest(QIODevice &input,
+                               KatalogueDatabase &db,
+                               VolumeInfo volume,
+                               const IngestOptions &options,
+                               ProgressCallback progress) {
+    m_lastVolumeId = -1;
+    m_stats = {};
+    if (!db.isOpen() || !input.isReadable()) {
+        return false;
+    }
+
+    if (volume.label.trimmed().isEmpty()) {
+        volume.label = QStringLiteral("Inventory");
+    }
+    volume.id = -1;
+    if (!volume.createdAt.isValid()) {
+        volume.createdAt = QDateTime::currentDateTimeUtc();
+    }
+    volume.updatedAt = QDateTime::currentDateTimeUtc();
+    const int volumeId = db.upsertVolume(volume);
+    if (volumeId < 0) {
+        return false;
+    }
+    m_lastVolumeId = volumeId;
+    // Batches commit as the inventory streams in, so a failed or cancelled
+    // ingest takes its volume out again instead of leaving part of it.
+    auto discardVolume = [&]() {
+        db.deleteVolume(volumeId);
+        m_lastVolumeId = -1;
+        return false;
+    };
+    // Indexed for search in one pass at the end.
+    if (!db.setSearchIndexStale(volumeId)) {
+        return discardVolume();
+    }
+
+    DirectoryInfo rootDir;
+    rootDir.volumeId = volumeId;
+    rootDir.name = QStringLiteral("/");
+    rootDir.fullPath = QStringLiteral("/");
+    const int rootId = db.upsertDirectory(rootDir);
+    if (rootId < 0) {
+        return discardVolume();
+    }
+
+    // Catalog path -> row id of every directory created so far. Ingested
+    // directories get no mtime/inode stamp: nothing here was listed, so a
+    // quick rescan must not trust them.
+    QHash<QString, int> directoryIds;
+    directoryIds.insert(QStringLiteral("/"), rootId);
+    auto ensureDirectory = [&](const QString &path) {
+        auto known = directoryIds.constFind(path);
+        if (known != directoryIds.constEnd()) {
+            return *known;
+        }
+        QStringList missing{path};
+        for (;;) {
+            known = directoryIds.constFind(parentPath(missing.last()));
+            if (known != directoryIds.constEnd()) {
+                break;
+            }
+            missing.append(parentPath(missing.last()));
+        }
+        int parentId = *known;
+        for (auto it = missing.crbegin(); it != missing.crend(); ++it) {
+            DirectoryInfo dirInfo;
+            dirInfo.volumeId = volumeId;
+            dirInfo.parentId = parentId;
+            dirInfo.name = it->mid(it->lastIndexOf(QLatin1Char('/')) + 1);
+            dirInfo.fullPath = *it;
+            parentId = db.upsertDirectory(dirInfo);
+            if (parentId < 0) {
+                return -1;
+            }
+            directoryIds.insert(*it, parentId);
+            m_stats.directories += 1;
+        }
+        return parentId;
+    };
+
+    QString prefix = options.stripPrefix.isEmpty() ? QString() : QDir::cleanPath(options.stripPrefix);
+    if (prefix == QStringLiteral("/")) {
+        prefix.clear();
+    }
+    auto catalogPath = [&prefix](const QByteArray &rawPath) {
+        QString path = QFile::decodeName(rawPath);
+        if (!prefix.isEmpty()) {
+            if (path == prefix) {
+                path.clear();
+            } else if (path.startsWith(prefix) && path.at(prefix.size()) == QLatin1Char('/')) {
+                path = path.mid(prefix.size());
+            } else {
+                return QString();
+            }
+        }
+        path = QDir::cleanPath(QLatin1Char('/') + path);
+        return path.startsWith(QStringLiteral("/..")) ? QString() : path;
+    };
+
+    MimeTypeCache mimeTypes(MimeDetection::Extension);
+    // Files go in through the bulk insert once per batch.
+    std::vector<FileInfo> pendingFiles;
+    auto flushFiles = [&]() {
+        const bool flushed = db.insertFiles(pendingFiles);
+        pendingFiles.clear();
+        return flushed;
+    };
+    InventoryRecord parsed;
+    auto ingestRecord = [&](const QByteArray &record) {
+        m_stats.records += 1;
+        if (!parseRecord(record, parsed) || (parsed.type != 'f' && parsed.type != 'd')) {
+            m_stats.skipped += 1;
+            return true;
+        }
+        const QString path = catalogPath(parsed.path);
+        if (path.isEmpty()) {
+            m_stats.skipped += 1;
+            return true;
+        }
+        if (parsed.type == 'd') {
+            return ensureDirectory(path) >= 0;
+        }
+        if (path == QStringLiteral("/")) {
+            m_stats.skipped += 1;
+            return true;
+        }
+
+        FileInfo fileInfo;
+        fileInfo.directoryId = ensureDirectory(parentPath(path));
+        if (fileInfo.directoryId < 0) {
+            return false;
+        }
+        fileInfo.name = path.mid(path.lastIndexOf(QLatin1Char('/')) + 1);
+        fileInfo.size = parsed.size;
+        if (parsed.mtime >= 0) {
+            fileInfo.mtime = QDateTime::fromSecsSinceEpoch(parsed.mtime, Qt::UTC);
+        }
+        fileInfo.fileType = mimeTypes.forName(fileInfo.name);
+        pendingFiles.push_back(std::move(fileInfo));
+        m_stats.files += 1;
+        m_stats.totalBytes += parsed.size;
+        return true;
+    };
+
+    if (!db.beginBatch()) {
+        return discardVolume();
+    }
+    QByteArray buffer;
+    qint64 pendingRecords = 0;
+    bool ok = true;
+    bool finished = false;
+    while (ok && !finished) {
+        const qsizetype buffered = buffer.size();
+        buffer.resize(buffered + readChunkSize);
+        const qint64 read = input.read(buffer.data() + buffered, readChunkSize);
+        buffer.resize(buffered + qMax<qint64>(read, 0));
+        if (read < 0) {
+            ok = false;
+            break;
+        }
+        if (read == 0) {
+            if (!input.isSequential() || input.atEnd() || !input.waitForReadyRead(-1)) {
+                finished = true;
+                // A final record without its terminator.
+                if (!buffer.isEmpty()) {
+                    buffer.append(options.separator);
+                }
+            }
+        }
+
+        qsizetype start = 0;
+        for (;;) {
+            const qsizetype end = buffer.indexOf(options.separator, start);
+            if (end < 0) {
+                break;
+            }
+            if (end > start
+                && !ingestRecord(QByteArray::fromRawData(buffer.constData() + start, end - start))) {
+                ok = false;
+                break;
+            }
+            start = end + 1;
+            if (++pendingRecords >= batchRecords) {
+                pendingRecords = 0;
+                if (!flushFiles()) {
+                    ok = false;
+                    break;
+                }
+                if (!db.endBatch()) {
+                    ok = false;
+                    break;
+                }
+                if (progress && !progress(m_stats)) {
+                    return discardVolume();
+                }
+                if (!db.beginBatch()) {
+                    return discardVolume();
+                }
+            }
+        }
+        buffer.remove(0, start);
+    }
+    if (ok && !flushFiles()) {
+        ok = false;
+    }
+    if (!ok) {
+        db.abortBatch();
+        return discardVolume();
+    }
+    if (!db.endBatch() || !db.rebuildSearchIndex(volumeId)) {
+        return discardVolume();
+    }
+
+    if (progress) {
+        progress(m_stats);
+    }
+    return true;
+}
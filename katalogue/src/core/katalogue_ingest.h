@@ -0,0 +1,59 @@
+#pragma once
+
+// Loads file inventories produced elsewhere (find, fd, a remote shell) into
+// the catalog as a new volume, without touching the filesystem they
+// describe.
+
+#include <functional>
+
+#include <QString>
+
+#include "katalogue_types.h"
+
+class KatalogueDatabase;
+class QIODevice;
+
+struct IngestOptions {
+    // Record terminator: '\0' for find -printf '...\0', '\n' for line lists.
+    char separator = '\0';
+    // Dropped from the front of every path, e.g. the directory find was
+    // started in when %p was used instead of %P.
+    QString stripPrefix;
+};
+
+struct IngestStats {
+    qint64 records = 0;
+    int directories = 0;
+    qint64 files = 0;
+    qint64 totalBytes = 0;
+    // Malformed records and entries that are neither files nor directories.
+    qint64 skipped = 0;
+};
+
+// Records are "path<TAB>size<TAB>mtime<TAB>type", as written by
+//   find ROOT -printf '%P\t%s\t%T@\t%y\0'
+// The fields after the path are split off from the right, so tabs in names
+// are kept. mtime is in (fractional) seconds since the epoch and type is
+// find's %y letter: 'f' files, 'd' directories, anything else is skipped.
+// Missing parent directories are created on the fly, so the order of the
+// records does not matter.
+class InventoryIngester {
+public:
+    using ProgressCallback = std::function<bool(const IngestStats &stats)>;
+
+    // Adds volume (label, hint, ...) and everything read from input to db.
+    // Returns false on a catalog error or when progress returned false;
+    // the volume is then removed again.
+    bool ingest(QIODevice &input,
+                KatalogueDatabase &db,
+                VolumeInfo volume,
+                const IngestOptions &options,
+                ProgressCallback progress = {});
+
+    int lastVolumeId() const { return m_lastVolumeId; }
+    const IngestStats &stats() const { return m_stats; }
+
+private:
+    int m_lastVolumeId = -1;
+    IngestStats m_stats;
+};
@@ -0,0 +1,87 @@
+#include "katalogue_mime.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <QMimeType>
+
+namespace {
+// The memo key is the last extension, or the last two for compound ones
+// such as "tar.gz". Names without an extension are resolved uncached since
+// their globs match whole file names.
+QString extensionKey(const QString &fileName) {
+    const qsizetype dot = fileName.lastIndexOf(QLatin1Char('.'));
+    if (dot <= 0 || dot == fileName.size() - 1) {
+        return {};
+    }
+    const qsizetype previous = fileName.lastIndexOf(QLatin1Char('.'), dot - 1);
+    if (previous > 0) {
+        const QStringView inner = QStringView(fileName).mid(previous + 1, dot - previous - 1);
+        const bool shortWord = !inner.isEmpty() && inner.size() <= 4
+                               && std::all_of(inner.begin(), inner.end(), [](QChar c) { return c.isLetter(); });
+        if (shortWord) {
+            return fileName.mid(previous + 1);
+        }
+    }
+    return fileName.mid(dot + 1);
+}
+} // namespace
+
+MimeTypeCache::MimeTypeCache(MimeDetection detection)
+    : m_detection(detection) {}
+
+QString MimeTypeCache::forName(const QString &fileName) {
+    if (m_detection == MimeDetection::Content) {
+        return {};
+    }
+    const QString key = extensionKey(fileName);
+    const Entry entry = key.isEmpty() ? resolve(fileName) : lookup(key);
+    if (m_detection == MimeDetection::Auto && entry.ambiguous) {
+        return {};
+    }
+    return entry.name;
+}
+
+QString MimeTypeCache::forFile(const QString &localPath, const QString &fileName) {
+    switch (m_detection) {
+    case MimeDetection::Extension:
+        return forName(fileName);
+    case MimeDetection::Auto:
+        return m_db.mimeTypeForFile(localPath).name();
+    case MimeDetection::Content:
+        break;
+    }
+
+    const QString key = extensionKey(fileName);
+    const QString byName = (key.isEmpty() ? resolve(fileName) : lookup(key)).name;
+    const QMimeType byContent = m_db.mimeTypeForFile(localPath, QMimeDatabase::MatchContent);
+    // Magic only knows broad families like text/plain; keep the name's
+    // more specific type when it belongs to the sniffed one.
+    if (byContent.isDefault() || m_db.mimeTypeForName(byName).inherits(byContent.name())) {
+        return byName;
+    }
+    return byContent.name();
+}
+
+MimeTypeCache::Entry MimeTypeCache::lookup(const QString &extension) {
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        const auto it = m_extensions.constFind(extension);
+        if (it != m_extensions.constEnd()) {
+            return *it;
+        }
+    }
+
+    const Entry entry = resolve(QStringLiteral("x.") + extension);
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_extensions.insert(extension, entry);
+    return entry;
+}
+
+MimeTypeCache::Entry MimeTypeCache::resolve(const QString &fileName) const {
+    const QList<QMimeType> matches = m_db.mimeTypesForFileName(fileName);
+    Entry entry;
+    entry.ambiguous = matches.size() != 1;
+    entry.name = matches.isEmpty() ? QStringLiteral("application/octet-stream") : matches.first().name();
+    return entry;
+}
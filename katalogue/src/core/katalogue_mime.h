@@ -0,0 +1,45 @@
+#pragma once
+
+#include <shared_mutex>
+
+#include <QHash>
+#include <QMimeDatabase>
+#include <QString>
+
+enum class MimeDetection {
+    // File name only; never opens a file.
+    Extension,
+    // File name, sniffing the contents only when the name is ambiguous or unknown.
+    Auto,
+    // Always sniff the contents; the name only refines a generic match.
+    Content
+};
+
+// Extension -> MIME type memo shared by the scanner's traversal workers, so
+// each distinct extension goes through QMimeDatabase once per scan.
+class MimeTypeCache {
+public:
+    explicit MimeTypeCache(MimeDetection detection);
+
+    MimeTypeCache(const MimeTypeCache &) = delete;
+    MimeTypeCache &operator=(const MimeTypeCache &) = delete;
+
+    // Type for fileName, or an empty string when the contents have to be
+    // sniffed with forFile(). Never empty in Extension mode.
+    QString forName(const QString &fileName);
+    QString forFile(const QString &localPath, const QString &fileName);
+
+private:
+    struct Entry {
+        QString name;
+        bool ambiguous = false;
+    };
+
+    Entry lookup(const QString &extension);
+    Entry resolve(const QString &fileName) const;
+
+    MimeDetection m_detection;
+    QMimeDatabase m_db;
+    std::shared_mutex m_mutex;
+    QHash<QString, Entry> m_extensions;
+};
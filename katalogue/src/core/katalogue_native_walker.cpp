@@ -0,0 +1,207 @@
+#include "katalogue_native_walker.h"
+
+#ifdef KATALOGUE_HAVE_NATIVE_WALKER
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+namespace {
+// Layout returned by getdents64(2).
+struct LinuxDirent64 {
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+NativeEntryType typeFromDirent(unsigned char type) {
+    switch (type) {
+    case DT_DIR:
+        return NativeEntryType::Directory;
+    case DT_REG:
+        return NativeEntryType::Regular;
+    case DT_LNK:
+        return NativeEntryType::Symlink;
+    case DT_UNKNOWN:
+        return NativeEntryType::Unknown;
+    default:
+        return NativeEntryType::Other;
+    }
+}
+
+NativeEntryType typeFromMode(mode_t mode) {
+    if (S_ISDIR(mode)) {
+        return NativeEntryType::Directory;
+    }
+    if (S_ISREG(mode)) {
+        return NativeEntryType::Regular;
+    }
+    if (S_ISLNK(mode)) {
+        return NativeEntryType::Symlink;
+    }
+    return NativeEntryType::Other;
+}
+
+void nativeStatFromStat(const struct stat &st, NativeStat &out) {
+    out.type = typeFromMode(st.st_mode);
+    out.size = static_cast<std::int64_t>(st.st_size);
+    out.mtime = st.st_mtim.tv_sec;
+    out.ctime = st.st_ctim.tv_sec;
+    out.btime = -1;
+    out.inode = st.st_ino;
+    out.device = st.st_dev;
+    out.linkCount = static_cast<std::uint32_t>(st.st_nlink);
+}
+
+#ifdef STATX_BASIC_STATS
+constexpr unsigned int nativeStatxMask = STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_CTIME
+                                         | STATX_BTIME | STATX_INO | STATX_NLINK;
+std::atomic_bool statxUnsupported{false};
+#endif
+} // namespace
+
+NativeDirectoryReader::NativeDirectoryReader(std::size_t bufferSize)
+    : m_buffer(bufferSize) {}
+
+NativeDirectoryReader::~NativeDirectoryReader() {
+    close();
+}
+
+bool NativeDirectoryReader::open(const char *path) {
+    close();
+    m_fd = ::open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return m_fd >= 0;
+}
+
+void NativeDirectoryReader::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_offset = 0;
+    m_length = 0;
+    m_failed = false;
+}
+
+bool NativeDirectoryReader::fill() {
+    for (;;) {
+        const long read = ::syscall(SYS_getdents64, m_fd, m_buffer.data(), m_buffer.size());
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            m_failed = read < 0;
+            m_offset = 0;
+            m_length = 0;
+            return false;
+        }
+        m_offset = 0;
+        m_length = static_cast<std::size_t>(read);
+        return true;
+    }
+}
+
+bool NativeDirectoryReader::next(NativeDirEntry &entry) {
+    if (m_fd < 0) {
+        return false;
+    }
+    for (;;) {
+        if (m_offset >= m_length && !fill()) {
+            return false;
+        }
+        const auto *dirent = reinterpret_cast<const LinuxDirent64 *>(m_buffer.data() + m_offset);
+        m_offset += dirent->d_reclen;
+
+        const char *name = dirent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        entry.name = name;
+        entry.nameLength = std::strlen(name);
+        entry.inode = dirent->d_ino;
+        entry.type = typeFromDirent(dirent->d_type);
+        return true;
+    }
+}
+
+#ifdef STATX_BASIC_STATS
+void nativeStatFromStatx(const struct statx &stx, NativeStat &out) {
+    out.type = typeFromMode(stx.stx_mode);
+    out.size = static_cast<std::int64_t>(stx.stx_size);
+    out.mtime = (stx.stx_mask & STATX_MTIME) ? stx.stx_mtime.tv_sec : -1;
+    out.ctime = (stx.stx_mask & STATX_CTIME) ? stx.stx_ctime.tv_sec : -1;
+    out.btime = (stx.stx_mask & STATX_BTIME) ? stx.stx_btime.tv_sec : -1;
+    out.inode = stx.stx_ino;
+    out.device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    out.linkCount = stx.stx_nlink;
+}
+#endif
+
+bool nativeStatAt(int dirFd, const char *name, bool followSymlinks, NativeStat &out) {
+    const int flags = (followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW) | AT_NO_AUTOMOUNT;
+
+#ifdef STATX_BASIC_STATS
+    if (!statxUnsupported.load(std::memory_order_relaxed)) {
+        struct statx stx;
+        if (::statx(dirFd, name, flags, nativeStatxMask, &stx) == 0) {
+            nativeStatFromStatx(stx, out);
+            return true;
+        }
+        if (errno != ENOSYS) {
+            return false;
+        }
+        statxUnsupported.store(true, std::memory_order_relaxed);
+    }
+#endif
+
+    struct stat st;
+    if (::fstatat(dirFd, name, &st, flags) != 0) {
+        return false;
+    }
+    nativeStatFromStat(st, out);
+    return true;
+}
+
+bool nativeStatFd(int fd, NativeStat &out) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        return false;
+    }
+    nativeStatFromStat(st, out);
+    return true;
+}
+
+bool nativePhysicalOffset(int dirFd, const char *name, std::uint64_t &offset) {
+    const int fd = ::openat(dirFd, name, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    // One extent is all we need: where the data starts.
+    alignas(struct fiemap) char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] = {};
+    auto *map = reinterpret_cast<struct fiemap *>(buffer);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    // Delayed-allocation extents have no location yet.
+    const bool ok = ::ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents > 0
+                    && !(map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN);
+    if (ok) {
+        offset = map->fm_extents[0].fe_physical;
+    }
+    ::close(fd);
+    return ok;
+}
+
+#endif // KATALOGUE_HAVE_NATIVE_WALKER
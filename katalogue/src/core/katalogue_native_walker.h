@@ -0,0 +1,84 @@
+#pragma once
+
+// Thin Linux syscall layer used by KatalogueScanner: getdents64 directory
+// reads and dirfd-relative statx lookups. Deliberately free of Qt types so
+// the hot loop does not allocate per entry.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__linux__)
+#define KATALOGUE_HAVE_NATIVE_WALKER 1
+#endif
+
+enum class NativeEntryType : std::uint8_t {
+    Unknown,
+    Directory,
+    Regular,
+    Symlink,
+    Other
+};
+
+struct NativeDirEntry {
+    const char *name = nullptr;
+    std::size_t nameLength = 0;
+    std::uint64_t inode = 0;
+    NativeEntryType type = NativeEntryType::Unknown;
+};
+
+struct NativeStat {
+    NativeEntryType type = NativeEntryType::Unknown;
+    std::int64_t size = 0;
+    std::int64_t mtime = -1;
+    std::int64_t ctime = -1;
+    std::int64_t btime = -1;
+    std::uint64_t inode = 0;
+    std::uint64_t device = 0;
+    std::uint32_t linkCount = 0;
+};
+
+// Reads one directory at a time through a buffer reused across directories.
+class NativeDirectoryReader {
+public:
+    explicit NativeDirectoryReader(std::size_t bufferSize = 64 * 1024);
+    ~NativeDirectoryReader();
+
+    NativeDirectoryReader(const NativeDirectoryReader &) = delete;
+    NativeDirectoryReader &operator=(const NativeDirectoryReader &) = delete;
+
+    bool open(const char *path);
+    void close();
+    int fd() const { return m_fd; }
+
+    // Returns false once the directory is exhausted or unreadable.
+    // The name pointer stays valid until the next call.
+    bool next(NativeDirEntry &entry);
+    // True when the last read stopped on an error rather than end of directory.
+    bool failed() const { return m_failed; }
+
+private:
+    bool fill();
+
+    std::vector<char> m_buffer;
+    std::size_t m_offset = 0;
+    std::size_t m_length = 0;
+    int m_fd = -1;
+    bool m_failed = false;
+};
+
+struct statx;
+
+// Converts a filled statx buffer; shared with the io_uring batch path.
+void nativeStatFromStatx(const struct statx &stx, NativeStat &out);
+
+// statx() relative to an open directory; falls back to fstatat() on kernels without statx.
+bool nativeStatAt(int dirFd, const char *name, bool followSymlinks, NativeStat &out);
+
+// fstat() of an already open descriptor, e.g. the directory being listed.
+bool nativeStatFd(int fd, NativeStat &out);
+
+// Physical byte offset of the first extent of name (relative to dirFd),
+// used to order reads on rotational media. False where FIEMAP is not
+// supported or the file has no allocated extents.
+bool nativePhysicalOffset(int dirFd, const char *name, std::uint64_t &offset);
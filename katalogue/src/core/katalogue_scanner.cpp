@@ -1,23 +1,1037 @@
 #include "katalogue_scanner.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include <QDateTime>
+#include <QDebug>
 #include <QDir>
-#include <QDirIterator>
+#include <QFile>
 #include <QFileInfo>
-#include <QMimeDatabase>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
 #include <QStorageInfo>
+#include <QThread>
+
+#include "katalogue_device.h"
+#include "katalogue_exclude.h"
+#include "katalogue_mime.h"
+#include "katalogue_native_walker.h"
+#include "katalogue_uring.h"
+#include "katalogue_xxh64.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#endif
+
+namespace {
+// Catalog row of a directory. Only the writer reads or writes the fields;
+// workers just hand the pointer from a directory entry to the listing of
+// that directory, so parent ids resolve without a path -> id table and
+// memory stays bounded by the directories currently in flight.
+struct DirectoryRecord {
+    int id = -1;
+    // Stamp stored by the previous scan, for incremental scans.
+    qint64 storedMtime = -1;
+    quint64 storedInode = 0;
+};
+using DirectoryRecordPtr = std::shared_ptr<DirectoryRecord>;
+
+// A directory waiting to be listed by one of the traversal workers.
+// localPath is the absolute path in filesystem encoding; relativePath is only
+// filled in when exclude patterns need it.
+struct ScanWorkItem {
+    QByteArray localPath;
+    QString relativePath;
+    QString catalogPath;
+    DirectoryRecordPtr record;
+    int depth = 0;
+    // Inode or physical offset for ordered traversals.
+    quint64 sortKey = 0;
+    // st_dev of the directory this one was found in; 0 for the root.
+    quint64 parentDevice = 0;
+};
+
+struct ScannedEntry {
+    QString name;
+    bool isDir = false;
+    qint64 size = 0;
+    qint64 mtime = -1;
+    qint64 ctime = -1;
+    QString fileType;
+    // Set for directories that will be listed too; the writer fills it in
+    // once the row exists.
+    DirectoryRecordPtr record;
+    quint64 sortKey = 0;
+    // Native walker only; 0 otherwise.
+    quint64 inode = 0;
+    quint64 device = 0;
+    quint32 linkCount = 0;
+};
+
+// Everything a worker found in one directory, handed to the writer in one piece.
+struct DirectoryListing {
+    QByteArray localPath;
+    QString catalogPath;
+    DirectoryRecordPtr record;
+    int depth = 0;
+    std::vector<ScannedEntry> entries;
+    // Set once every entry of the directory was read; incremental scans only
+    // delete catalog rows missing from complete listings.
+    bool complete = false;
+    // The directory's own mtime/inode, and whether its files were left out
+    // because a quick rescan found the directory unchanged.
+    qint64 mtime = -1;
+    quint64 inode = 0;
+    quint64 device = 0;
+    bool filesSkipped = false;
+    // A mount point that was left out (ScanOptions::oneFileSystem,
+    // skipFilesystemTypes); it keeps its own row but gets no entries.
+    bool mountSkipped = false;
+    // What listing the directory cost the worker.
+    ScanPhaseStats phases;
+    qint64 wallNs = 0;
+};
+
+// Identifies a file across its hardlinks: (st_dev, st_ino).
+using InodeKey = std::pair<quint64, quint64>;
+
+// MIME types already sniffed for files with more than one link, shared by
+// the traversal workers so each inode's content is read once per scan.
+class HardlinkTypes {
+public:
+    bool find(const InodeKey &key, QString &fileType) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_types.constFind(key);
+        if (it == m_types.constEnd()) {
+            return false;
+        }
+        fileType = *it;
+        return true;
+    }
+
+    void insert(const InodeKey &key, const QString &fileType) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_types.insert(key, fileType);
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    QHash<InodeKey, QString> m_types;
+};
+
+// Directory stamps already in the catalog for quick rescans, keyed by a
+// 64-bit hash of the catalog path rather than the path itself. Filled before
+// the workers start and only read afterwards.
+struct KnownDirectory {
+    qint64 mtime = -1;
+    quint64 inode = 0;
+};
+using KnownDirectories = QHash<quint64, KnownDirectory>;
+
+quint64 catalogPathKey(const QString &catalogPath) {
+    return Xxh64::hash(catalogPath.constData(), static_cast<size_t>(catalogPath.size()) * sizeof(QChar));
+}
+
+// Per-worker deques: the owner pushes and pops at the back (depth-first),
+// idle workers steal from the front of somebody else's deque. Ordered
+// traversals keep everything in one map by sort key instead and sweep it
+// like an elevator: the next item is the lowest key at or above the last
+// one handed out, wrapping around once the end is reached.
+class WorkStealingQueues {
+public:
+    WorkStealingQueues(int workerCount, bool ordered)
+        : m_deques(static_cast<size_t>(workerCount))
+        , m_ordered(ordered) {}
+
+    void push(int worker, ScanWorkItem item) {
+        m_pending.fetch_add(1);
+        if (m_ordered) {
+            {
+                std::lock_guard<std::mutex> lock(m_sweepMutex);
+                const quint64 key = item.sortKey;
+                m_sweep.emplace(key, std::move(item));
+            }
+            m_idleCondition.notify_one();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_deques[static_cast<size_t>(worker)].mutex);
+            m_deques[static_cast<size_t>(worker)].items.push_back(std::move(item));
+        }
+        m_idleCondition.notify_one();
+    }
+
+    bool pop(int worker, ScanWorkItem &item) {
+        if (m_ordered) {
+            std::lock_guard<std::mutex> lock(m_sweepMutex);
+            if (m_sweep.empty()) {
+                return false;
+            }
+            auto next = m_sweep.lower_bound(m_sweepPosition);
+            if (next == m_sweep.end()) {
+                next = m_sweep.begin();
+            }
+            m_sweepPosition = next->first;
+            item = std::move(next->second);
+            m_sweep.erase(next);
+            return true;
+        }
+        {
+            auto &own = m_deques[static_cast<size_t>(worker)];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.items.empty()) {
+                item = std::move(own.items.back());
+                own.items.pop_back();
+                return true;
+            }
+        }
+
+        const size_t count = m_deques.size();
+        for (size_t offset = 1; offset < count; ++offset) {
+            auto &victim = m_deques[(static_cast<size_t>(worker) + offset) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.items.empty()) {
+                item = std::move(victim.items.front());
+                victim.items.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Called once the popped item and all of its children have been pushed.
+    void finishItem() {
+        if (m_pending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(m_idleMutex);
+            m_idleCondition.notify_all();
+        }
+    }
+
+    bool isDrained() const {
+        return m_pending.load() == 0;
+    }
+
+    void waitForWork() {
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_idleCondition.wait_for(lock, std::chrono::milliseconds(2));
+    }
+
+    void wakeAll() {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_idleCondition.notify_all();
+    }
+
+private:
+    struct Deque {
+        std::mutex mutex;
+        std::deque<ScanWorkItem> items;
+    };
+
+    std::vector<Deque> m_deques;
+    const bool m_ordered;
+    std::mutex m_sweepMutex;
+    std::multimap<quint64, ScanWorkItem> m_sweep;
+    quint64 m_sweepPosition = 0;
+    std::atomic<qint64> m_pending{0};
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCondition;
+};
+
+// Bounded hand-off from the traversal workers to the single database writer.
+class ListingQueue {
+public:
+    explicit ListingQueue(size_t capacity)
+        : m_capacity(capacity) {}
+
+    bool push(DirectoryListing listing) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this]() { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed) {
+            return false;
+        }
+        m_items.push_back(std::move(listing));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    enum class PopResult {
+        Item,
+        TimedOut,
+        Drained
+    };
+
+    // Waits at most timeout for a listing, so the writer can report
+    // progress while slow media keeps the workers busy.
+    PopResult pop(DirectoryListing &listing, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const bool ready = m_notEmpty.wait_for(lock, timeout, [this]() {
+            return m_closed || !m_items.empty() || m_activeProducers == 0;
+        });
+        if (!ready) {
+            return PopResult::TimedOut;
+        }
+        if (m_items.empty()) {
+            return PopResult::Drained;
+        }
+        listing = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return PopResult::Item;
+    }
+
+    bool tryPop(DirectoryListing &listing) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.empty()) {
+            return false;
+        }
+        listing = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void setProducers(int count) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_activeProducers = count;
+    }
+
+    void producerFinished() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_activeProducers -= 1;
+        m_notEmpty.notify_all();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque<DirectoryListing> m_items;
+    size_t m_capacity;
+    int m_activeProducers = 0;
+    bool m_closed = false;
+};
+
+// Paces the progress callback by time instead of by rows written and fills
+// in the rates and the estimate of ScanStats.
+class ProgressReporter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ProgressReporter(const QString &rootPath, bool wholeVolume, int intervalMs, const ScanStats &initial)
+        : m_interval(std::max(intervalMs, 0))
+        , m_started(Clock::now())
+        , m_next(m_started + m_interval)
+        , m_initialFiles(initial.files)
+        , m_initialBytes(initial.totalBytes) {
+        // The filesystem's usage only describes the scan when it starts at
+        // the mount point.
+        const QStorageInfo storage(rootPath);
+        if (!wholeVolume || !storage.isValid()
+            || storage.rootPath() != QFileInfo(rootPath).canonicalFilePath()) {
+            return;
+        }
+        m_usedBytes = storage.bytesTotal() - storage.bytesFree();
+#if defined(__linux__)
+        struct statvfs fs;
+        if (::statvfs(QFile::encodeName(rootPath).constData(), &fs) == 0 && fs.f_files > 0) {
+            m_usedInodes = static_cast<qint64>(fs.f_files - fs.f_ffree);
+        }
+#endif
+        m_initialFraction = std::max(shareDone(initial), 0.0);
+    }
+
+    bool isDue() const { return Clock::now() >= m_next; }
+
+    std::chrono::milliseconds untilDue() const {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(m_next - Clock::now());
+        return std::max(remaining, std::chrono::milliseconds(1));
+    }
+
+    // finished pins the estimate to done once the scan completed.
+    void update(ScanStats &stats, bool finished = false) {
+        const auto now = Clock::now();
+        m_next = now + m_interval;
+        stats.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_started).count();
+        if (stats.elapsedMs <= 0) {
+            return;
+        }
+        const double seconds = static_cast<double>(stats.elapsedMs) / 1000.0;
+        stats.filesPerSecond = static_cast<double>(stats.files - m_initialFiles) / seconds;
+        stats.bytesPerSecond = static_cast<double>(stats.totalBytes - m_initialBytes) / seconds;
+
+        const double fraction = shareDone(stats);
+        if (fraction < 0) {
+            return;
+        }
+        stats.fractionDone = finished ? 1.0 : std::min(fraction, 0.99);
+        // Only extrapolate from what this run did; a resumed scan's
+        // checkpointed counters took an unknown time.
+        const double runFraction = stats.fractionDone - m_initialFraction;
+        if (finished) {
+            stats.etaSeconds = 0;
+        } else if (runFraction > 0 && seconds >= 1) {
+            stats.etaSeconds = static_cast<qint64>(seconds * (1.0 - stats.fractionDone) / runFraction);
+        }
+    }
+
+private:
+    // Mean of whichever shares are known, -1 if none is; filesystems
+    // without inode accounting (btrfs) report f_files as 0.
+    double shareDone(const ScanStats &stats) const {
+        double fraction = 0;
+        int parts = 0;
+        if (m_usedInodes > 0) {
+            fraction += static_cast<double>(stats.directories + stats.files) / static_cast<double>(m_usedInodes);
+            ++parts;
+        }
+        if (m_usedBytes > 0) {
+            fraction += static_cast<double>(stats.uniqueBytes) / static_cast<double>(m_usedBytes);
+            ++parts;
+        }
+        return parts > 0 ? fraction / parts : -1;
+    }
+
+    std::chrono::milliseconds m_interval;
+    Clock::time_point m_started;
+    Clock::time_point m_next;
+    int m_initialFiles = 0;
+    qint64 m_initialBytes = 0;
+    double m_initialFraction = 0;
+    qint64 m_usedInodes = 0;
+    qint64 m_usedBytes = 0;
+};
+
+QString childCatalogPath(const QString &parent, const QString &name) {
+    return parent == QStringLiteral("/") ? QStringLiteral("/") + name
+                                         : parent + QLatin1Char('/') + name;
+}
+
+QString childRelativePath(const QString &parent, const QString &name) {
+    return parent.isEmpty() ? name : parent + QLatin1Char('/') + name;
+}
+
+qint64 elapsedNs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Inserts timing into list (worst first) if it ranks among the top count.
+void keepWorst(QList<DirectoryTiming> &list,
+               const DirectoryTiming &timing,
+               int count,
+               bool (*worse)(const DirectoryTiming &, const DirectoryTiming &)) {
+    if (list.size() >= count && !worse(timing, list.last())) {
+        return;
+    }
+    list.insert(std::upper_bound(list.begin(), list.end(), timing, worse), timing);
+    if (list.size() > count) {
+        list.removeLast();
+    }
+}
+
+qint64 secsOrInvalid(const QDateTime &dateTime) {
+    return dateTime.isValid() ? dateTime.toSecsSinceEpoch() : -1;
+}
+
+QDateTime dateTimeFromSecs(qint64 secs) {
+    return secs >= 0 ? QDateTime::fromSecsSinceEpoch(secs, Qt::UTC) : QDateTime();
+}
+
+// Guards followSymlinks scans against link cycles and links back into the tree.
+class SymlinkGuard {
+public:
+    explicit SymlinkGuard(const QString &rootCanonical)
+        : m_rootCanonical(rootCanonical) {}
+
+    bool tryEnter(const QString &canonicalTarget) {
+        if (canonicalTarget.isEmpty() || canonicalTarget == m_rootCanonical
+            || canonicalTarget.startsWith(m_rootCanonical + QLatin1Char('/'))) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_followed.contains(canonicalTarget)) {
+            return false;
+        }
+        m_followed.insert(canonicalTarget);
+        return true;
+    }
+
+private:
+    QString m_rootCanonical;
+    QSet<QString> m_followed;
+    std::mutex m_mutex;
+};
+
+using StopPredicate = std::function<bool()>;
+
+// Per-worker state for turning one directory into a DirectoryListing.
+class DirectoryLister {
+public:
+    DirectoryLister(const ScanOptions &options,
+                    const KnownDirectories &known,
+                    const ExcludeMatcher &excludes,
+                    SymlinkGuard &symlinks,
+                    MimeTypeCache &mimeTypes,
+                    HardlinkTypes &hardlinkTypes,
+                    const MountTable &mounts,
+                    AdaptiveRateLimiter &throttle,
+                    TraversalOrder order,
+                    StopPredicate shouldStop)
+        : m_options(options)
+        , m_known(known)
+        , m_excludes(excludes)
+        , m_symlinks(symlinks)
+        , m_mimeTypes(mimeTypes)
+        , m_hardlinkTypes(hardlinkTypes)
+        , m_mounts(mounts)
+        , m_throttle(throttle)
+        , m_order(order)
+        , m_shouldStop(std::move(shouldStop)) {
+#ifdef KATALOGUE_HAVE_NATIVE_WALKER
+        if (m_options.nativeTraversal && m_options.ioUring && UringStatBatch::isSupported()) {
+            m_uring = std::make_unique<UringStatBatch>();
+            if (!m_uring->init(m_options.ioUringQueueDepth)) {
+                m_uring.reset();
+            }
+        }
+#endif
+    }
+
+    void list(const ScanWorkItem &item,
+              DirectoryListing &listing,
+              std::vector<ScanWorkItem> &children) {
+        listing.localPath = item.localPath;
+        listing.catalogPath = item.catalogPath;
+        listing.record = item.record;
+        listing.depth = item.depth;
+
+        const int entryDepth = item.depth + 1;
+        if (m_options.maxDepth >= 0 && entryDepth > m_options.maxDepth) {
+            return;
+        }
+        if (m_excludes.excludesContents(item.relativePath)) {
+            listing.complete = true;
+            return;
+        }
+#ifdef KATALOGUE_HAVE_NATIVE_WALKER
+        if (m_options.nativeTraversal) {
+            listNative(item, listing, children);
+            return;
+        }
+#endif
+        listQt(item, listing, children);
+    }
+
+private:
+    bool descendInto(int entryDepth) const {
+        return m_options.maxDepth < 0 || entryDepth < m_options.maxDepth;
+    }
+
+    // A directory's entry list only changes together with its mtime, so a
+    // quick rescan can trust the catalog for its files. Subdirectories are
+    // still listed since their own contents may have changed.
+    bool filesUnchanged(const QString &catalogPath, qint64 mtime, quint64 inode) const {
+        if (!m_options.quickRescan || mtime < 0) {
+            return false;
+        }
+        const auto it = m_known.constFind(catalogPathKey(catalogPath));
+        if (it == m_known.constEnd() || it->mtime != mtime) {
+            return false;
+        }
+        return it->inode == 0 || inode == 0 || it->inode == inode;
+    }
+
+    bool needsRelativePath() const {
+        return m_excludes.hasPathPatterns();
+    }
+
+    ScanWorkItem makeChild(const ScanWorkItem &parent,
+                           const ScannedEntry &entry,
+                           const QString &relativePath,
+                           QByteArray localPath,
+                           quint64 device) const {
+        ScanWorkItem child;
+        child.localPath = std::move(localPath);
+        child.relativePath = relativePath;
+        child.catalogPath = childCatalogPath(parent.catalogPath, entry.name);
+        child.record = entry.record;
+        child.depth = parent.depth + 1;
+        child.sortKey = entry.sortKey;
+        child.parentDevice = device;
+        return child;
+    }
+
+    // Whether the directory sits on another filesystem than its parent and
+    // that filesystem is one the options keep the scan out of.
+    bool skipsMount(const ScanWorkItem &item, quint64 device) const {
+        if (item.parentDevice == 0 || device == 0 || device == item.parentDevice) {
+            return false;
+        }
+        return m_options.oneFileSystem
+               || MountTable::matchesType(m_mounts.filesystemType(device), m_options.skipFilesystemTypes);
+    }
+
+    void listQt(const ScanWorkItem &item,
+                DirectoryListing &listing,
+                std::vector<ScanWorkItem> &children) {
+        const QFileInfo dirInfo(QFile::decodeName(item.localPath));
+        if (dirInfo.lastModified().isValid()) {
+            listing.mtime = dirInfo.lastModified().toSecsSinceEpoch();
+        }
+#if defined(__linux__)
+        struct stat dirStat;
+        if (::stat(item.localPath.constData(), &dirStat) == 0) {
+            listing.device = static_cast<quint64>(dirStat.st_dev);
+        }
+#endif
+        if (skipsMount(item, listing.device)) {
+            listing.mountSkipped = true;
+            listing.complete = true;
+            return;
+        }
+        listing.filesSkipped = filesUnchanged(item.catalogPath, listing.mtime, 0);
+
+        QDir::Filters filters = (listing.filesSkipped ? QDir::Dirs : QDir::AllEntries) | QDir::NoDotAndDotDot;
+        if (m_options.includeHidden) {
+            filters |= QDir::Hidden;
+        }
+        if (!m_options.followSymlinks) {
+            filters |= QDir::NoSymLinks;
+        }
+
+        const QDir dir(QFile::decodeName(item.localPath));
+        if (!dir.isReadable()) {
+            return;
+        }
+        // QDir stats every entry while listing, so the throttle can only be
+        // charged afterwards; that still paces the next directory.
+        const auto listStart = std::chrono::steady_clock::now();
+        const QFileInfoList infos = dir.entryInfoList(filters, QDir::NoSort);
+        listing.phases.readNs += elapsedNs(listStart);
+        listing.phases.directoriesRead += 1;
+        listing.phases.stats += infos.size();
+        if (m_throttle.isEnabled()) {
+            const int statCount = static_cast<int>(infos.size());
+            m_throttle.record(statCount, std::chrono::steady_clock::now() - listStart);
+            const auto waitStart = std::chrono::steady_clock::now();
+            const bool acquired = m_throttle.acquire(statCount, m_shouldStop);
+            listing.phases.throttleNs += elapsedNs(waitStart);
+            if (!acquired) {
+                return;
+            }
+        }
+        listing.entries.reserve(static_cast<size_t>(infos.size()));
+
+        for (const QFileInfo &info : infos) {
+            if (m_shouldStop()) {
+                return;
+            }
+
+            const QString name = info.fileName();
+            const QString relativePath = needsRelativePath() ? childRelativePath(item.relativePath, name)
+                                                             : QString();
+            if (m_excludes.isExcluded(relativePath, name)) {
+                continue;
+            }
+
+            if (info.isSymLink()) {
+                if (!m_options.followSymlinks) {
+                    continue;
+                }
+                if (info.isDir() && !m_symlinks.tryEnter(info.canonicalFilePath())) {
+                    continue;
+                }
+            }
+
+            ScannedEntry entry;
+            entry.name = name;
+            if (info.isDir()) {
+                entry.isDir = true;
+                if (descendInto(item.depth + 1)) {
+                    entry.record = std::make_shared<DirectoryRecord>();
+                    children.push_back(makeChild(item, entry, relativePath,
+                                                 QFile::encodeName(info.absoluteFilePath()),
+                                                 listing.device));
+                }
+            } else if (info.isFile()) {
+                entry.size = info.size();
+                entry.mtime = info.lastModified().toSecsSinceEpoch();
+                entry.ctime = info.birthTime().isValid() ? info.birthTime().toSecsSinceEpoch()
+                                                         : info.metadataChangeTime().toSecsSinceEpoch();
+                entry.fileType = m_mimeTypes.forName(name);
+                if (entry.fileType.isEmpty()) {
+                    const auto sniffStart = std::chrono::steady_clock::now();
+                    entry.fileType = m_mimeTypes.forFile(info.filePath(), name);
+                    listing.phases.sniffNs += elapsedNs(sniffStart);
+                    listing.phases.sniffs += 1;
+                }
+            } else {
+                continue;
+            }
+            listing.entries.push_back(std::move(entry));
+        }
+        listing.complete = true;
+    }
+
+#ifdef KATALOGUE_HAVE_NATIVE_WALKER
+    // A directory entry that survived the name filters, waiting for its stat.
+    struct PendingEntry {
+        size_t nameOffset = 0;
+        size_t nameLength = 0;
+        std::uint64_t inode = 0;
+        NativeEntryType type = NativeEntryType::Unknown;
+        QString name;
+        QString relativePath;
+    };
+
+    void listNative(const ScanWorkItem &item,
+                    DirectoryListing &listing,
+                    std::vector<ScanWorkItem> &children) {
+        const auto readStart = std::chrono::steady_clock::now();
+        if (!m_reader.open(item.localPath.constData())) {
+            return;
+        }
+        NativeStat dirStat;
+        if (nativeStatFd(m_reader.fd(), dirStat)) {
+            listing.mtime = dirStat.mtime;
+            listing.inode = dirStat.inode;
+            listing.device = dirStat.device;
+        }
+        if (skipsMount(item, listing.device)) {
+            m_reader.close();
+            listing.mountSkipped = true;
+            listing.complete = true;
+            return;
+        }
+        listing.filesSkipped = filesUnchanged(item.catalogPath, listing.mtime, listing.inode);
+
+        // Names are copied into one NUL-separated arena so they outlive the
+        // getdents buffer and can be handed to a whole batch of statx calls.
+        m_pending.clear();
+        m_nameArena.clear();
+        NativeDirEntry dirent;
+        while (m_reader.next(dirent)) {
+            if (m_shouldStop()) {
+                m_reader.close();
+                return;
+            }
+            if (!m_options.includeHidden && dirent.name[0] == '.') {
+                continue;
+            }
+            if (dirent.type == NativeEntryType::Other) {
+                continue;
+            }
+            if (listing.filesSkipped && dirent.type == NativeEntryType::Regular) {
+                continue;
+            }
+
+            PendingEntry pending;
+            pending.name = QFile::decodeName(QByteArray::fromRawData(dirent.name,
+                                                                     static_cast<qsizetype>(dirent.nameLength)));
+            pending.relativePath = needsRelativePath() ? childRelativePath(item.relativePath, pending.name)
+                                                       : QString();
+            if (m_excludes.isExcluded(pending.relativePath, pending.name)) {
+                continue;
+            }
+            pending.nameOffset = m_nameArena.size();
+            pending.nameLength = dirent.nameLength;
+            pending.inode = dirent.inode;
+            pending.type = dirent.type;
+            m_nameArena.append(dirent.name, dirent.nameLength);
+            m_nameArena.push_back('\0');
+            m_pending.push_back(std::move(pending));
+        }
+
+        const bool readFailed = m_reader.failed();
+        listing.phases.readNs += elapsedNs(readStart);
+        listing.phases.directoriesRead += 1;
+        // Inode tables are laid out by number, so stats in inode order read
+        // them front to back.
+        if (m_order != TraversalOrder::Directory) {
+            std::sort(m_pending.begin(), m_pending.end(), [](const PendingEntry &a, const PendingEntry &b) {
+                return a.inode < b.inode;
+            });
+        }
+        if (!statPending(listing.phases)) {
+            m_reader.close();
+            return;
+        }
+
+        // Child paths are built in place on top of the directory path and
+        // trimmed back after each entry.
+        m_pathBuffer.assign(item.localPath.constData(), static_cast<size_t>(item.localPath.size()));
+        m_pathBuffer.push_back('/');
+        const size_t baseLength = m_pathBuffer.size();
+        listing.entries.reserve(m_pending.size());
+
+        for (size_t i = 0; i < m_pending.size(); ++i) {
+            const PendingEntry &pending = m_pending[i];
+            m_pathBuffer.resize(baseLength);
+            m_pathBuffer.append(m_nameArena.data() + pending.nameOffset, pending.nameLength);
+
+            NativeStat st = m_stats[i];
+            NativeEntryType type = pending.type;
+            if (type == NativeEntryType::Unknown || type == NativeEntryType::Regular) {
+                if (!m_statOk[i]) {
+                    continue;
+                }
+                type = st.type;
+            }
+            if (type == NativeEntryType::Symlink) {
+                if (!m_options.followSymlinks
+                    || !nativeStatAt(m_reader.fd(), m_nameArena.data() + pending.nameOffset, true, st)) {
+                    continue;
+                }
+                type = st.type;
+                if (type == NativeEntryType::Directory
+                    && !m_symlinks.tryEnter(QFileInfo(QFile::decodeName(QByteArray::fromStdString(m_pathBuffer)))
+                                                .canonicalFilePath())) {
+                    continue;
+                }
+            }
+
+            ScannedEntry entry;
+            entry.name = pending.name;
+            if (m_order != TraversalOrder::Directory) {
+                entry.sortKey = sortKeyFor(pending, st, type);
+            }
+            if (type == NativeEntryType::Directory) {
+                entry.isDir = true;
+                if (descendInto(item.depth + 1)) {
+                    entry.record = std::make_shared<DirectoryRecord>();
+                    children.push_back(makeChild(item, entry, pending.relativePath,
+                                                 QByteArray(m_pathBuffer.data(),
+                                                            static_cast<qsizetype>(m_pathBuffer.size())),
+                                                 listing.device));
+                }
+            } else if (type == NativeEntryType::Regular && !listing.filesSkipped) {
+                entry.size = st.size;
+                entry.mtime = st.mtime;
+                entry.ctime = st.btime >= 0 ? st.btime : st.ctime;
+                entry.inode = st.inode;
+                entry.device = st.device;
+                entry.linkCount = st.linkCount;
+                entry.fileType = m_mimeTypes.forName(pending.name);
+                if (entry.fileType.isEmpty()) {
+                    // Another link to the same inode may already have been sniffed.
+                    const bool linked = entry.linkCount > 1 && entry.inode != 0;
+                    const InodeKey key(entry.device, entry.inode);
+                    if (!linked || !m_hardlinkTypes.find(key, entry.fileType)) {
+                        const auto sniffStart = std::chrono::steady_clock::now();
+                        entry.fileType = m_mimeTypes.forFile(
+                            QFile::decodeName(QByteArray::fromRawData(m_pathBuffer.data(),
+                                                                      static_cast<qsizetype>(m_pathBuffer.size()))),
+                            pending.name);
+                        listing.phases.sniffNs += elapsedNs(sniffStart);
+                        listing.phases.sniffs += 1;
+                        if (linked) {
+                            m_hardlinkTypes.insert(key, entry.fileType);
+                        }
+                    }
+                }
+            } else {
+                continue;
+            }
+            listing.entries.push_back(std::move(entry));
+        }
+        m_reader.close();
+        listing.complete = !readFailed;
+    }
+
+    // Directories are always keyed (they are about to be listed); files only
+    // matter when the hashing pipeline is going to read them.
+    quint64 sortKeyFor(const PendingEntry &pending, const NativeStat &st, NativeEntryType type) {
+        const quint64 inode = st.inode != 0 ? st.inode : pending.inode;
+        const bool wanted = type == NativeEntryType::Directory
+                            || (type == NativeEntryType::Regular && m_options.computeHashes);
+        if (m_order != TraversalOrder::Physical || !wanted) {
+            return inode;
+        }
+        std::uint64_t offset = 0;
+        return nativePhysicalOffset(m_reader.fd(), m_nameArena.data() + pending.nameOffset, offset) ? offset
+                                                                                                     : inode;
+    }
+
+    // d_type tells us about directories and symlinks for free; only regular
+    // files (for size and times) and DT_UNKNOWN entries need a stat. With
+    // io_uring the whole directory's worth is kept in flight at once.
+    // Returns false when the scan stopped while waiting for the throttle.
+    bool statPending(ScanPhaseStats &phases) {
+        m_statNames.clear();
+        m_statIndexes.clear();
+        for (size_t i = 0; i < m_pending.size(); ++i) {
+            const NativeEntryType type = m_pending[i].type;
+            if (type == NativeEntryType::Unknown || type == NativeEntryType::Regular) {
+                m_statNames.push_back(m_nameArena.data() + m_pending[i].nameOffset);
+                m_statIndexes.push_back(i);
+            }
+        }
+
+        m_stats.assign(m_pending.size(), NativeStat());
+        m_statOk.assign(m_pending.size(), 0);
+        if (m_statNames.empty()) {
+            return true;
+        }
+
+        const int statCount = static_cast<int>(m_statNames.size());
+        const auto waitStart = std::chrono::steady_clock::now();
+        const bool acquired = m_throttle.acquire(statCount, m_shouldStop);
+        phases.throttleNs += elapsedNs(waitStart);
+        if (!acquired) {
+            return false;
+        }
+        // With io_uring this is the batch time spread over its stats rather
+        // than a true per-request latency, which is what the throttle wants.
+        const auto statStart = std::chrono::steady_clock::now();
+
+        if (m_uring && m_uring->isValid()
+            && m_uring->statAll(m_reader.fd(), m_statNames, false, m_batchStats, m_batchOk)) {
+            for (size_t j = 0; j < m_statIndexes.size(); ++j) {
+                m_stats[m_statIndexes[j]] = m_batchStats[j];
+                m_statOk[m_statIndexes[j]] = m_batchOk[j];
+            }
+        } else {
+            for (size_t j = 0; j < m_statIndexes.size(); ++j) {
+                const size_t index = m_statIndexes[j];
+                m_statOk[index] = nativeStatAt(m_reader.fd(), m_statNames[j], false, m_stats[index]) ? 1 : 0;
+            }
+        }
+        m_throttle.record(statCount, std::chrono::steady_clock::now() - statStart);
+        phases.statNs += elapsedNs(statStart);
+        phases.stats += statCount;
+        return true;
+    }
+
+    NativeDirectoryReader m_reader;
+    std::unique_ptr<UringStatBatch> m_uring;
+    std::string m_pathBuffer;
+    std::string m_nameArena;
+    std::vector<PendingEntry> m_pending;
+    std::vector<const char *> m_statNames;
+    std::vector<size_t> m_statIndexes;
+    std::vector<NativeStat> m_stats;
+    std::vector<char> m_statOk;
+    std::vector<NativeStat> m_batchStats;
+    std::vector<char> m_batchOk;
+#endif
+
+    const ScanOptions &m_options;
+    const KnownDirectories &m_known;
+    const ExcludeMatcher &m_excludes;
+    SymlinkGuard &m_symlinks;
+    MimeTypeCache &m_mimeTypes;
+    HardlinkTypes &m_hardlinkTypes;
+    const MountTable &m_mounts;
+    AdaptiveRateLimiter &m_throttle;
+    const TraversalOrder m_order;
+    StopPredicate m_shouldStop;
+};
+
+// Current state of one path reported by a FilesystemWatcher, filled in the
+// way the listers fill directory entries. False when the path is gone or is
+// nothing a scan would record.
+bool statChangedPath(const QString &localPath,
+                     const ScanOptions &options,
+                     MimeTypeCache &mimeTypes,
+                     ScannedEntry &entry) {
+    entry.name = QFileInfo(localPath).fileName();
+#ifdef KATALOGUE_HAVE_NATIVE_WALKER
+    if (options.nativeTraversal) {
+        const QByteArray encoded = QFile::encodeName(localPath);
+        NativeStat st;
+        if (!nativeStatAt(AT_FDCWD, encoded.constData(), false, st)) {
+            return false;
+        }
+        if (st.type == NativeEntryType::Symlink
+            && (!options.followSymlinks || !nativeStatAt(AT_FDCWD, encoded.constData(), true, st))) {
+            return false;
+        }
+        if (st.type == NativeEntryType::Directory) {
+            entry.isDir = true;
+            return true;
+        }
+        if (st.type != NativeEntryType::Regular) {
+            return false;
+        }
+        entry.size = st.size;
+        entry.mtime = st.mtime;
+        entry.ctime = st.btime >= 0 ? st.btime : st.ctime;
+        entry.inode = st.inode;
+        entry.device = st.device;
+        entry.linkCount = st.linkCount;
+        entry.fileType = mimeTypes.forName(entry.name);
+        if (entry.fileType.isEmpty()) {
+            entry.fileType = mimeTypes.forFile(localPath, entry.name);
+        }
+        return true;
+    }
+#endif
+    const QFileInfo info(localPath);
+    if (info.isSymLink() && !options.followSymlinks) {
+        return false;
+    }
+    if (info.isDir()) {
+        entry.isDir = true;
+        return true;
+    }
+    if (!info.isFile()) {
+        return false;
+    }
+    entry.size = info.size();
+    entry.mtime = info.lastModified().toSecsSinceEpoch();
+    entry.ctime = info.birthTime().isValid() ? info.birthTime().toSecsSinceEpoch()
+                                             : info.metadataChangeTime().toSecsSinceEpoch();
+    entry.fileType = mimeTypes.forName(entry.name);
+    if (entry.fileType.isEmpty()) {
+        entry.fileType = mimeTypes.forFile(localPath, entry.name);
+    }
+    return true;
+}
+
+bool isAtOrBelow(const QString &catalogPath, const QString &directory) {
+    return directory == QStringLiteral("/") || catalogPath == directory
+           || (catalogPath.startsWith(directory) && catalogPath.at(directory.size()) == QLatin1Char('/'));
+}
+} // namespace
 
 KatalogueScanner::KatalogueScanner() = default;
 
+int KatalogueScanner::effectiveWorkerCount(const ScanOptions &options) {
+    if (options.workerThreads > 0) {
+        return options.workerThreads;
+    }
+    return qMax(1, QThread::idealThreadCount());
+}
+
 bool KatalogueScanner::scan(const QString &rootPath,
                             KatalogueDatabase &db,
                             VolumeInfo volumeInfo,
                             const ScanOptions &options,
                             ProgressCallback progress) {
-    m_cancelled.store(false);
-    m_cancelRequested.store(false);
+    m_lastVolumeId = -1;
 
-    if (!db.isOpen()) {
+    if (!db.isOpen() || isCancelRequested()) {
         return false;
     }
 
@@ -32,6 +1046,11 @@ bool KatalogueScanner::scan(const QString &rootPath,
                                : rootInfo.fileName();
     }
 
+    if (volumeInfo.physicalHint.isEmpty()) {
+        volumeInfo.physicalHint = rootInfo.absoluteFilePath();
+    }
+    volumeInfo.rootPath = rootInfo.absoluteFilePath();
+
     if (!volumeInfo.createdAt.isValid()) {
         volumeInfo.createdAt = QDateTime::currentDateTimeUtc();
     }
@@ -55,7 +1074,6 @@ bool KatalogueScanner::scan(const QString &rootPath,
         return false;
     }
 
-    QHash<QString, int> directoryIds;
     DirectoryInfo rootDir;
     rootDir.volumeId = volumeId;
     rootDir.name = QStringLiteral("/");
@@ -64,122 +1082,982 @@ bool KatalogueScanner::scan(const QString &rootPath,
     if (rootId < 0) {
         return false;
     }
-    directoryIds.insert(QStringLiteral("/"), rootId);
 
-    QDir rootDirHandle(rootPath);
-    QDir::Filters filters = QDir::AllEntries | QDir::NoDotAndDotDot;
-    if (options.includeHidden) {
-        filters |= QDir::Hidden;
+    return run(rootInfo.absoluteFilePath(), db, volumeId, rootId, options, std::move(progress), false);
+}
+
+bool KatalogueScanner::resume(int volumeId,
+                              KatalogueDatabase &db,
+                              const ScanOptions &options,
+                              ProgressCallback progress) {
+    m_lastVolumeId = -1;
+
+    if (!db.isOpen() || isCancelRequested()) {
+        return false;
+    }
+    const auto checkpoint = db.scanCheckpoint(volumeId);
+    if (!checkpoint) {
+        return false;
+    }
+    const QFileInfo rootInfo(checkpoint->rootPath);
+    if (!rootInfo.exists() || !rootInfo.isDir()) {
+        return false;
+    }
+
+    return run(rootInfo.absoluteFilePath(), db, volumeId, -1, options, std::move(progress), true);
+}
+
+int KatalogueScanner::lastVolumeId() const {
+    return m_lastVolumeId;
+}
+
+bool KatalogueScanner::run(const QString &rootPath,
+                           KatalogueDatabase &db,
+                           int volumeId,
+                           int rootId,
+                           const ScanOptions &options,
+                           ProgressCallback progress,
+                           bool resuming,
+                           const QString &subtreePath) {
+    m_lastVolumeId = volumeId;
+    const QFileInfo rootInfo(rootPath);
+    const QByteArray rootLocalPath = QFile::encodeName(rootPath);
+
+    // A resumed scan lists its frontier directories again, some of which
+    // may already be partly in the catalog, so it always diffs; so does a
+    // rescan of one subtree (rootId is then that directory's row). Only
+    // whole-volume scans keep a checkpoint.
+    const bool wholeVolume = subtreePath.isEmpty();
+    const bool incremental = resuming || !wholeVolume || options.incremental || options.quickRescan;
+    const bool checkpointing = resuming || (wholeVolume && options.checkpoints);
+    ScanStats stats;
+    std::vector<ScanWorkItem> seeds;
+
+    if (resuming) {
+        std::vector<int> seedParents;
+        if (const auto checkpoint = db.scanCheckpoint(volumeId)) {
+            stats.directories = checkpoint->directories;
+            stats.files = checkpoint->files;
+            stats.totalBytes = checkpoint->totalBytes;
+            stats.uniqueBytes = checkpoint->uniqueBytes;
+        }
+        const bool visited = db.visitCheckpointDirectories(volumeId, [&](const DirectoryInfo &dir, int depth) {
+            ScanWorkItem item;
+            item.catalogPath = dir.fullPath;
+            item.relativePath = dir.fullPath == QStringLiteral("/") ? QString() : dir.fullPath.mid(1);
+            item.localPath = dir.fullPath == QStringLiteral("/") ? rootLocalPath
+                                                                 : rootLocalPath + QFile::encodeName(dir.fullPath);
+            item.depth = depth;
+            item.record = std::make_shared<DirectoryRecord>();
+            item.record->id = dir.id;
+            item.record->storedMtime = secsOrInvalid(dir.mtime);
+            item.record->storedInode = dir.inode;
+            item.sortKey = dir.inode;
+            seeds.push_back(std::move(item));
+            seedParents.push_back(dir.parentId);
+        });
+        if (!visited) {
+            return false;
+        }
+        // A directory interrupted mid-listing is in the frontier together
+        // with the subdirectories it had reached; listing it again finds those.
+        QSet<int> seedIds;
+        for (const ScanWorkItem &seed : seeds) {
+            seedIds.insert(seed.record->id);
+        }
+        std::vector<ScanWorkItem> roots;
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            if (!seedIds.contains(seedParents[i])) {
+                roots.push_back(std::move(seeds[i]));
+            }
+        }
+        seeds = std::move(roots);
+    } else {
+        if (checkpointing && !db.beginScanCheckpoint(volumeId, rootPath, rootId)) {
+            return false;
+        }
+        // The mark outlives an interrupted scan, so a resumed one keeps
+        // deferring and indexes the volume when it completes.
+        if (wholeVolume && !incremental && options.deferSearchIndex && !db.setSearchIndexStale(volumeId)) {
+            return false;
+        }
+        ScanWorkItem rootItem;
+        rootItem.localPath = wholeVolume ? rootLocalPath : rootLocalPath + QFile::encodeName(subtreePath);
+        rootItem.catalogPath = wholeVolume ? QStringLiteral("/") : subtreePath;
+        rootItem.relativePath = wholeVolume ? QString() : subtreePath.mid(1);
+        rootItem.depth = wholeVolume ? 0 : static_cast<int>(subtreePath.count(QLatin1Char('/')));
+        rootItem.record = std::make_shared<DirectoryRecord>();
+        rootItem.record->id = rootId;
+        if (incremental) {
+            if (const auto stored = db.getDirectory(rootId)) {
+                rootItem.record->storedMtime = secsOrInvalid(stored->mtime);
+                rootItem.record->storedInode = stored->inode;
+            }
+        }
+        seeds.push_back(std::move(rootItem));
+    }
+
+    KnownDirectories knownDirectories;
+    if (options.quickRescan) {
+        db.visitVolumeDirectories(volumeId, [&knownDirectories](const DirectoryInfo &dir) {
+            KnownDirectory known;
+            known.mtime = secsOrInvalid(dir.mtime);
+            known.inode = dir.inode;
+            knownDirectories.insert(catalogPathKey(dir.fullPath), known);
+        });
     }
-    if (!options.followSymlinks) {
-        filters |= QDir::NoSymLinks;
+    // Directories modified at or after this second may change again within
+    // the same second, so their mtime is not recorded as a quick-rescan stamp.
+    const qint64 scanStartSecs = QDateTime::currentSecsSinceEpoch();
+
+    TraversalOrder order = options.traversalOrder;
+    if (order == TraversalOrder::Auto) {
+        order = isRotationalPath(rootPath) ? TraversalOrder::Inode : TraversalOrder::Directory;
     }
+    // One head can only be in one place: extra readers on a rotational disk
+    // just make it seek between their directories.
+    const bool ordered = order != TraversalOrder::Directory;
+
+    // Only this thread touches the database; the workers below just list
+    // directories and hand complete listings over through the queue.
+    const int workerCount = ordered && options.workerThreads <= 0 ? 1 : effectiveWorkerCount(options);
+    WorkStealingQueues workQueues(workerCount, ordered);
+    ListingQueue listings(static_cast<size_t>(workerCount) * 64);
+    std::atomic_bool abort{false};
+
+    SymlinkGuard symlinks(rootInfo.canonicalFilePath());
+    MimeTypeCache mimeTypes(options.mimeDetection);
+    HardlinkTypes hardlinkTypes;
+    const MountTable mounts;
+
+    auto shouldStop = [this, &abort]() {
+        return abort.load(std::memory_order_relaxed) || m_cancelled.load()
+               || m_cancelRequested.load(std::memory_order_relaxed);
+    };
+    const ExcludeMatcher excludes(options.excludePatterns);
+    AdaptiveRateLimiter throttle(options.targetStatLatencyMs, options.maxStatsPerSecond);
+
+    // Only threads owned by this scan are re-prioritized; the caller's
+    // thread keeps its own priority.
+    auto applyPriority = [&options]() {
+        return applyThreadPriority(options.ioPriority, options.ioPriorityLevel, options.niceness);
+    };
+
+    auto workerLoop = [&](int workerIndex) {
+        if (!applyPriority() && workerIndex == 0) {
+            qWarning() << "Could not apply the scan's I/O or CPU priority";
+        }
+        DirectoryLister lister(options, knownDirectories, excludes, symlinks, mimeTypes, hardlinkTypes, mounts, throttle,
+                               order, shouldStop);
+        while (!shouldStop()) {
+            ScanWorkItem item;
+            if (!workQueues.pop(workerIndex, item)) {
+                if (workQueues.isDrained()) {
+                    break;
+                }
+                workQueues.waitForWork();
+                continue;
+            }
+
+            DirectoryListing listing;
+            std::vector<ScanWorkItem> children;
+            const auto listStart = std::chrono::steady_clock::now();
+            lister.list(item, listing, children);
+            listing.wallNs = elapsedNs(listStart);
+
+            // The listing must be queued before its children become visible to
+            // other workers, so the writer always sees a parent before its subdirectories.
+            if (!listings.push(std::move(listing))) {
+                workQueues.finishItem();
+                break;
+            }
+            for (auto &child : children) {
+                workQueues.push(workerIndex, std::move(child));
+            }
+            workQueues.finishItem();
+        }
+        workQueues.wakeAll();
+        listings.producerFinished();
+    };
 
-    QDirIterator::IteratorFlags iteratorFlags = QDirIterator::Subdirectories;
-    if (options.followSymlinks) {
-        iteratorFlags |= QDirIterator::FollowSymlinks;
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        workQueues.push(static_cast<int>(i % static_cast<size_t>(workerCount)), std::move(seeds[i]));
     }
+    seeds.clear();
 
-    QDirIterator it(rootPath, filters, iteratorFlags);
-    QMimeDatabase mimeDb;
-    ScanStats stats;
+    listings.setProducers(workerCount);
+    std::vector<std::thread> workers;
+    workers.reserve(static_cast<size_t>(workerCount));
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(workerLoop, i);
+    }
+
+    // Hashing runs behind the writer: it submits files once their rows exist
+    // and records digests as they come back, within the same write batches.
+    std::unique_ptr<FileHasher> hasher;
+    if (options.computeHashes) {
+        FileHasher::Options hashOptions;
+        hashOptions.threads = ordered && options.hashThreads <= 0 ? 1 : options.hashThreads;
+        hashOptions.algorithm = options.hashAlgorithm;
+        hashOptions.threadSetup = applyPriority;
+        hashOptions.ordered = ordered;
+        hasher = std::make_unique<FileHasher>(hashOptions);
+    }
+    std::vector<FileHasher::Result> hashResults;
+    const bool sampledHashes = options.hashMode == HashMode::Sampled;
+
+    // Hardlinks seen by this scan: their size counts towards uniqueBytes
+    // once, and only the first link needing a digest is read; the others
+    // get a copy of its result, waiting for it if it is still in flight.
+    struct LinkDigest {
+        bool done = false;
+        QString hash;
+        QString fingerprint;
+        QList<int> waitingFiles;
+    };
+    QSet<InodeKey> countedInodes;
+    QHash<InodeKey, LinkDigest> linkDigests;
+    QHash<int, InodeKey> linkDigestsInFlight;
+    auto countBytes = [&](qint64 size, quint64 device, quint64 inode, quint32 linkCount) {
+        stats.totalBytes += size;
+        if (linkCount <= 1 || inode == 0) {
+            stats.uniqueBytes += size;
+            return;
+        }
+        const InodeKey key(device, inode);
+        if (!countedInodes.contains(key)) {
+            countedInodes.insert(key);
+            stats.uniqueBytes += size;
+        }
+    };
+
+    auto stopWorkers = [&]() {
+        abort.store(true);
+        if (hasher) {
+            hasher->cancel();
+        }
+        listings.close();
+        workQueues.wakeAll();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    };
 
     constexpr int batchSize = 500;
+    // A batch is also committed once it has been open this long, so other
+    // processes writing to the catalog are not locked out for long.
+    constexpr auto batchMaxAge = std::chrono::seconds(1);
+    // How often an idle writer holding a batch checks whether it is due.
+    constexpr auto batchPollInterval = std::chrono::milliseconds(50);
     int batchCount = 0;
-    db.beginBatch();
+    auto batchStart = std::chrono::steady_clock::now();
 
-    while (it.hasNext()) {
-        if (m_cancelled.load() || m_cancelRequested.load(std::memory_order_relaxed)) {
-            db.endBatch();
-            return false;
+    auto storeHashes = [&]() {
+        if (!hasher) {
+            return true;
         }
+        hasher->takeResults(hashResults);
+        for (const FileHasher::Result &result : hashResults) {
+            QList<int> fileIds{static_cast<int>(result.key)};
+            const auto inFlight = linkDigestsInFlight.constFind(fileIds.first());
+            if (inFlight != linkDigestsInFlight.constEnd()) {
+                LinkDigest &digest = linkDigests[*inFlight];
+                digest.done = true;
+                digest.hash = result.hash;
+                digest.fingerprint = result.fingerprint;
+                fileIds += std::exchange(digest.waitingFiles, {});
+                linkDigestsInFlight.erase(inFlight);
+            }
+            if (result.hash.isEmpty() && result.fingerprint.isEmpty()) {
+                continue;
+            }
+            for (const int fileId : std::as_const(fileIds)) {
+                if (!result.fingerprint.isEmpty() && !db.setFileFingerprint(fileId, result.fingerprint)) {
+                    return false;
+                }
+                if (!result.hash.isEmpty() && !db.setFileHash(fileId, result.hash)) {
+                    return false;
+                }
+            }
+            stats.hashedFiles += 1;
+            stats.hashedBytes += result.bytes;
+        }
+        hashResults.clear();
+        return true;
+    };
 
-        const QString path = it.next();
-        const QFileInfo info = it.fileInfo();
-        const QString relativePath = rootDirHandle.relativeFilePath(path);
-
-        if (relativePath.isEmpty() || relativePath == QStringLiteral(".")) {
-            continue;
+    ProgressReporter reporter(rootPath, wholeVolume, options.progressIntervalMs, stats);
+    QString currentPath = rootPath;
+    auto reportProgress = [&](bool finished = false) {
+        if (throttle.isEnabled()) {
+            stats.statsPerSecond = throttle.observedRate();
+            stats.statRateLimit = throttle.rate();
+            stats.statLatencyMs = throttle.meanLatencyMs();
         }
+        reporter.update(stats, finished);
+        return progress(currentPath, stats);
+    };
 
-        if (!withinDepth(relativePath, options.maxDepth)) {
-            continue;
+    // Committed together with each batch, so the catalog always holds a
+    // consistent resume point.
+    auto saveCheckpoint = [&]() {
+        return !checkpointing
+               || db.updateScanCheckpoint(volumeId, stats.directories, stats.files, stats.totalBytes, stats.uniqueBytes);
+    };
+
+    // A BEGIN that fails (busy catalog, full disk) fails the scan instead
+    // of letting the rows fall back to a commit each.
+    auto openBatch = [&]() {
+        if (db.inBatch()) {
+            return true;
+        }
+        if (!db.beginBatch()) {
+            return false;
         }
+        batchStart = std::chrono::steady_clock::now();
+        return true;
+    };
 
-        if (isExcluded(relativePath, info.fileName(), options)) {
-            continue;
+    auto commitBatch = [&]() {
+        if (!db.inBatch()) {
+            return true;
+        }
+        if (!storeHashes() || !saveCheckpoint() || !db.endBatch()) {
+            return false;
         }
+        batchCount = 0;
+        stats.phases.commits += 1;
+        return true;
+    };
 
-        if (info.isSymLink()) {
-            continue;
+    auto batchDue = [&]() {
+        return db.inBatch()
+               && (batchCount >= batchSize || std::chrono::steady_clock::now() - batchStart >= batchMaxAge
+                   || db.hasWaitingWriters());
+    };
+
+    auto abortScan = [&]() {
+        if (db.inBatch()) {
+            saveCheckpoint();
+            db.endBatch();
         }
+        stopWorkers();
+        return false;
+    };
 
-        if (info.isDir()) {
-            DirectoryInfo dirInfo;
-            dirInfo.volumeId = volumeId;
-            dirInfo.name = info.fileName();
-            dirInfo.fullPath = QDir::cleanPath(QStringLiteral("/") + relativePath);
+    DirectoryListing listing;
+    for (;;) {
+        // Nothing queued: the batch stays open while the traversal catches
+        // up, and is committed once it is due or another scan wants to write.
+        if (!listings.tryPop(listing)) {
+            ListingQueue::PopResult popped;
+            for (;;) {
+                if (batchDue()) {
+                    const auto commitStart = std::chrono::steady_clock::now();
+                    if (!commitBatch()) {
+                        return abortScan();
+                    }
+                    stats.phases.writeNs += elapsedNs(commitStart);
+                }
+                const auto timeout = db.inBatch() ? std::min(reporter.untilDue(), batchPollInterval)
+                                                  : reporter.untilDue();
+                popped = listings.pop(listing, timeout);
+                if (popped != ListingQueue::PopResult::TimedOut) {
+                    break;
+                }
+                if (progress && reporter.isDue() && !reportProgress()) {
+                    return abortScan();
+                }
+            }
+            if (popped == ListingQueue::PopResult::Drained) {
+                break;
+            }
+        }
+        const auto writeStart = std::chrono::steady_clock::now();
+        if (!openBatch()) {
+            return abortScan();
+        }
 
-            const QString parentRelative = QDir::cleanPath(QStringLiteral("/") +
-                                                           QFileInfo(relativePath).path());
-            dirInfo.parentId = directoryIds.value(parentRelative, rootId);
+        DirectoryRecord &self = *listing.record;
+        const int parentId = self.id;
 
-            const int dirId = db.upsertDirectory(dirInfo);
-            if (dirId < 0) {
-                db.endBatch();
-                return false;
+        // What the catalog already has for this directory, keyed by name.
+        // Entries still left after the listing is applied have disappeared.
+        QHash<QString, FileInfo> existingFiles;
+        QHash<QString, DirectoryInfo> existingDirectories;
+        if (incremental) {
+            for (const FileInfo &file : db.listFilesInDirectory(parentId)) {
+                existingFiles.insert(file.name, file);
+            }
+            for (const DirectoryInfo &dir : db.listDirectories(volumeId, parentId)) {
+                existingDirectories.insert(dir.name, dir);
             }
-            directoryIds.insert(dirInfo.fullPath, dirId);
-            stats.directories += 1;
-        } else if (info.isFile()) {
-            const QString parentRelative = QDir::cleanPath(QStringLiteral("/") +
-                                                           QFileInfo(relativePath).path());
-            const int parentId = directoryIds.value(parentRelative, rootId);
+        }
 
+        auto fileInfoFor = [parentId](const ScannedEntry &entry) {
             FileInfo fileInfo;
             fileInfo.directoryId = parentId;
-            fileInfo.name = info.fileName();
-            fileInfo.size = info.size();
-            fileInfo.mtime = info.lastModified().toUTC();
-            fileInfo.ctime = info.birthTime().isValid() ? info.birthTime().toUTC()
-                                                        : info.metadataChangeTime().toUTC();
-            fileInfo.fileType = mimeDb.mimeTypeForFile(info).name();
-
-            if (db.upsertFile(fileInfo) < 0) {
-                db.endBatch();
+            fileInfo.name = entry.name;
+            fileInfo.size = entry.size;
+            fileInfo.mtime = dateTimeFromSecs(entry.mtime);
+            fileInfo.ctime = dateTimeFromSecs(entry.ctime);
+            fileInfo.fileType = entry.fileType;
+            fileInfo.inode = entry.inode;
+            fileInfo.linkCount = entry.linkCount;
+            return fileInfo;
+        };
+
+        // Rows the catalog does not have yet are written through the bulk
+        // inserts, batchSize entries ahead of the loop below, which then only
+        // picks up their ids.
+        std::vector<int> insertedIds(listing.entries.size(), -1);
+        size_t insertedUpTo = 0;
+        auto insertNewRows = [&]() {
+            const size_t end = std::min(listing.entries.size(), insertedUpTo + batchSize);
+            std::vector<DirectoryInfo> directories;
+            std::vector<FileInfo> files;
+            std::vector<size_t> directoryEntries;
+            std::vector<size_t> fileEntries;
+            for (size_t index = insertedUpTo; index < end; ++index) {
+                const ScannedEntry &entry = listing.entries[index];
+                if (entry.isDir && !existingDirectories.contains(entry.name)) {
+                    DirectoryInfo dirInfo;
+                    dirInfo.volumeId = volumeId;
+                    dirInfo.parentId = parentId;
+                    dirInfo.name = entry.name;
+                    dirInfo.fullPath = childCatalogPath(listing.catalogPath, entry.name);
+                    directories.push_back(std::move(dirInfo));
+                    directoryEntries.push_back(index);
+                } else if (!entry.isDir && !existingFiles.contains(entry.name)) {
+                    files.push_back(fileInfoFor(entry));
+                    fileEntries.push_back(index);
+                }
+            }
+            insertedUpTo = end;
+            if (!db.insertDirectories(directories) || !db.insertFiles(files)) {
                 return false;
             }
+            for (size_t i = 0; i < directories.size(); ++i) {
+                insertedIds[directoryEntries[i]] = directories[i].id;
+            }
+            for (size_t i = 0; i < files.size(); ++i) {
+                insertedIds[fileEntries[i]] = files[i].id;
+            }
+            return true;
+        };
 
-            stats.files += 1;
-            stats.totalBytes += fileInfo.size;
-        } else {
-            continue;
+        for (size_t index = 0; index < listing.entries.size(); ++index) {
+            const ScannedEntry &entry = listing.entries[index];
+            if (m_cancelled.load() || m_cancelRequested.load(std::memory_order_relaxed)) {
+                return abortScan();
+            }
+            if (index == insertedUpTo && !insertNewRows()) {
+                return abortScan();
+            }
+
+            if (entry.isDir) {
+                const DirectoryInfo stored = existingDirectories.take(entry.name);
+                int dirId = stored.id;
+                if (dirId <= 0) {
+                    dirId = insertedIds[index];
+                    if (dirId < 0) {
+                        return abortScan();
+                    }
+                    if (incremental) {
+                        stats.added += 1;
+                    }
+                }
+                if (entry.record) {
+                    entry.record->id = dirId;
+                    entry.record->storedMtime = secsOrInvalid(stored.mtime);
+                    entry.record->storedInode = stored.inode;
+                    if (checkpointing && !db.addCheckpointDirectory(volumeId, dirId, listing.depth + 1)) {
+                        return abortScan();
+                    }
+                }
+                stats.directories += 1;
+            } else {
+                FileInfo fileInfo = fileInfoFor(entry);
+
+                bool unchanged = false;
+                bool hadDigest = false;
+                const auto existing = existingFiles.constFind(entry.name);
+                const bool known = existing != existingFiles.constEnd();
+                if (known) {
+                    fileInfo.id = existing->id;
+                    unchanged = existing->size == entry.size
+                                && secsOrInvalid(existing->mtime) == entry.mtime
+                                && secsOrInvalid(existing->ctime) == entry.ctime
+                                && (entry.inode == 0
+                                    || (existing->inode == entry.inode && existing->linkCount == entry.linkCount));
+                    hadDigest = sampledHashes ? !existing->fingerprint.isEmpty() : !existing->hash.isEmpty();
+                    existingFiles.erase(existing);
+                }
+
+                if (!unchanged) {
+                    const int fileId = known ? db.upsertFile(fileInfo) : insertedIds[index];
+                    if (fileId < 0) {
+                        return abortScan();
+                    }
+                    fileInfo.id = fileId;
+                    if (incremental && known) {
+                        stats.updated += 1;
+                    } else if (incremental) {
+                        stats.added += 1;
+                    }
+                }
+
+                const bool linked = entry.linkCount > 1 && entry.inode != 0;
+                const InodeKey inodeKey(entry.device, entry.inode);
+                const auto linkDigest = linked ? linkDigests.find(inodeKey) : linkDigests.end();
+                if (hasher && (!unchanged || !hadDigest) && linkDigest != linkDigests.end()) {
+                    if (!linkDigest->done) {
+                        linkDigest->waitingFiles.append(fileInfo.id);
+                    } else if ((!linkDigest->fingerprint.isEmpty()
+                                && !db.setFileFingerprint(fileInfo.id, linkDigest->fingerprint))
+                               || (!linkDigest->hash.isEmpty() && !db.setFileHash(fileInfo.id, linkDigest->hash))) {
+                        return abortScan();
+                    }
+                } else if (hasher && (!unchanged || !hadDigest)) {
+                    if (linked) {
+                        linkDigests.insert(inodeKey, LinkDigest());
+                        linkDigestsInFlight.insert(fileInfo.id, inodeKey);
+                    }
+                    FileHasher::Job job;
+                    job.key = fileInfo.id;
+                    job.sampled = sampledHashes;
+                    job.sortKey = entry.sortKey;
+                    job.path = listing.localPath + '/' + QFile::encodeName(entry.name);
+                    if (!hasher->submit(std::move(job))) {
+                        return abortScan();
+                    }
+                }
+
+                stats.files += 1;
+                countBytes(fileInfo.size, entry.device, entry.inode, entry.linkCount);
+            }
+
+            ++batchCount;
+            if (batchDue() && (!commitBatch() || !openBatch())) {
+                return abortScan();
+            }
+            if (progress && reporter.isDue()) {
+                currentPath = QFile::decodeName(listing.localPath) + QLatin1Char('/') + entry.name;
+                if (!reportProgress()) {
+                    return abortScan();
+                }
+            }
         }
 
-        ++batchCount;
-        if (batchCount >= batchSize) {
-            db.endBatch();
-            batchCount = 0;
+        // Files of an unchanged directory were never read; the catalog rows
+        // stand as they are.
+        if (listing.filesSkipped) {
+            for (const FileInfo &kept : std::as_const(existingFiles)) {
+                stats.files += 1;
+                countBytes(kept.size, listing.device, kept.inode, kept.linkCount);
+            }
+            existingFiles.clear();
+        }
 
-            if (progress) {
-                if (!progress(path, stats)) {
-                    return false;
+        // A directory that could not be read completely keeps its old rows.
+        if (incremental && listing.complete) {
+            for (const FileInfo &gone : std::as_const(existingFiles)) {
+                if (!db.deleteFile(gone.id)) {
+                    return abortScan();
+                }
+                stats.removed += 1;
+            }
+            for (const DirectoryInfo &gone : std::as_const(existingDirectories)) {
+                if (!db.deleteDirectory(gone.id)) {
+                    return abortScan();
                 }
+                stats.removed += 1;
             }
+        }
+
+        if (checkpointing && !db.removeCheckpointDirectory(parentId)) {
+            return abortScan();
+        }
+
+        // A skipped mount point's stamp would let a later quick rescan that
+        // does enter it trust an empty catalog.
+        if (listing.mountSkipped) {
+            stats.skippedMounts.append(listing.catalogPath);
+        } else if (listing.complete) {
+            const qint64 stampMtime = listing.mtime < scanStartSecs ? listing.mtime : -1;
+            if ((self.storedMtime != stampMtime || self.storedInode != listing.inode)
+                && !db.setDirectoryStamp(parentId, dateTimeFromSecs(stampMtime), listing.inode)) {
+                return abortScan();
+            }
+        }
 
-            db.beginBatch();
+        const qint64 writeNs = elapsedNs(writeStart);
+        stats.phases.add(listing.phases);
+        stats.phases.writeNs += writeNs;
+        if (options.slowDirectoryCount > 0) {
+            DirectoryTiming timing;
+            timing.path = listing.catalogPath;
+            timing.wallNs = listing.wallNs + writeNs;
+            timing.entries = static_cast<int>(listing.entries.size());
+            keepWorst(stats.slowestDirectories, timing, options.slowDirectoryCount,
+                      [](const DirectoryTiming &a, const DirectoryTiming &b) { return a.wallNs > b.wallNs; });
+            keepWorst(stats.largestDirectories, timing, options.slowDirectoryCount,
+                      [](const DirectoryTiming &a, const DirectoryTiming &b) { return a.entries > b.entries; });
         }
     }
 
-    db.endBatch();
+    // Traversal is done; let the hashing pool catch up, committing digests
+    // and reporting progress while it drains.
+    if (hasher) {
+        while (!hasher->waitForIdle(250)) {
+            if (m_cancelled.load() || m_cancelRequested.load(std::memory_order_relaxed)) {
+                return abortScan();
+            }
+            if (!openBatch() || !storeHashes() || (batchDue() && !commitBatch())) {
+                return abortScan();
+            }
+            currentPath = rootPath;
+            if (progress && reporter.isDue() && !reportProgress()) {
+                return abortScan();
+            }
+        }
+    }
+    if (!openBatch() || !storeHashes()) {
+        return abortScan();
+    }
+
+    stopWorkers();
+    if (m_cancelled.load() || m_cancelRequested.load(std::memory_order_relaxed)) {
+        saveCheckpoint();
+        db.endBatch();
+        return false;
+    }
+    if (checkpointing) {
+        db.clearScanCheckpoint(volumeId);
+    }
+    if (!db.endBatch()) {
+        return false;
+    }
+    stats.phases.commits += 1;
+
+    // Only does work when the volume was bulk-loaded (by this or an
+    // interrupted earlier scan).
+    if (wholeVolume) {
+        const auto indexStart = std::chrono::steady_clock::now();
+        if (!db.rebuildSearchIndex(volumeId)) {
+            qWarning() << "Search index of volume" << volumeId << "stays stale";
+        }
+        stats.phases.indexNs += elapsedNs(indexStart);
+    }
 
     if (progress) {
-        progress(rootPath, stats);
+        currentPath = rootPath;
+        reportProgress(true);
     }
 
     return true;
 }
 
+int KatalogueScanner::applyChanges(int volumeId,
+                                   const QString &rootPath,
+                                   const WatchChanges &changes,
+                                   KatalogueDatabase &db,
+                                   const ScanOptions &options) {
+    m_cancelled.store(false);
+    m_cancelRequested.store(false);
+    if (!db.isOpen()) {
+        return -1;
+    }
+
+    const QString root = QDir::cleanPath(rootPath);
+    auto catalogPathFor = [&root](const QString &path) {
+        if (path == root) {
+            return QStringLiteral("/");
+        }
+        if (root == QStringLiteral("/")) {
+            return path;
+        }
+        return path.startsWith(root + QLatin1Char('/')) ? path.mid(root.size()) : QString();
+    };
+    auto localPathFor = [&root](const QString &catalogPath) {
+        return root == QStringLiteral("/") ? catalogPath : root + catalogPath;
+    };
+
+    // Sorted, a directory comes before everything below it: nested subtrees
+    // collapse into their top one and paths inside a rescanned subtree need
+    // no separate update.
+    QStringList rescans;
+    {
+        QStringList subtrees;
+        for (const QString &path : changes.subtrees) {
+            const QString catalogPath = catalogPathFor(path);
+            if (!catalogPath.isEmpty()) {
+                subtrees.append(catalogPath);
+            }
+        }
+        std::sort(subtrees.begin(), subtrees.end());
+        for (const QString &subtree : std::as_const(subtrees)) {
+            if (std::none_of(rescans.cbegin(), rescans.cend(),
+                             [&subtree](const QString &top) { return isAtOrBelow(subtree, top); })) {
+                rescans.append(subtree);
+            }
+        }
+    }
+    QStringList paths;
+    for (const QString &path : changes.paths) {
+        const QString catalogPath = catalogPathFor(path);
+        if (!catalogPath.isEmpty() && catalogPath != QStringLiteral("/")) {
+            paths.append(catalogPath);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    const ExcludeMatcher excludes(options.excludePatterns);
+    MimeTypeCache mimeTypes(options.mimeDetection);
+    std::unique_ptr<FileHasher> hasher;
+    if (options.computeHashes) {
+        FileHasher::Options hashOptions;
+        hashOptions.threads = options.hashThreads;
+        hashOptions.algorithm = options.hashAlgorithm;
+        hasher = std::make_unique<FileHasher>(hashOptions);
+    }
+    const bool sampledHashes = options.hashMode == HashMode::Sampled;
+    int written = 0;
+
+    if (!db.beginBatch()) {
+        return -1;
+    }
+    for (const QString &catalogPath : std::as_const(paths)) {
+        if (std::any_of(rescans.cbegin(), rescans.cend(),
+                        [&catalogPath](const QString &top) { return isAtOrBelow(catalogPath, top); })) {
+            continue;
+        }
+        const qsizetype slash = catalogPath.lastIndexOf(QLatin1Char('/'));
+        const QString parentPath = slash == 0 ? QStringLiteral("/") : catalogPath.left(slash);
+        const QString name = catalogPath.mid(slash + 1);
+        // No row for the parent: it lies below something excluded, hidden
+        // or too deep, and the entry would not be cataloged either.
+        const auto parent = db.findDirectoryByPath(volumeId, parentPath);
+        if (!parent) {
+            continue;
+        }
+
+        const int depth = static_cast<int>(catalogPath.count(QLatin1Char('/')));
+        const bool wanted = (options.includeHidden || !name.startsWith(QLatin1Char('.')))
+                            && (options.maxDepth < 0 || depth <= options.maxDepth)
+                            && !excludes.excludesContents(parentPath == QStringLiteral("/") ? QString()
+                                                                                             : parentPath.mid(1))
+                            && !excludes.isExcluded(catalogPath.mid(1), name);
+        ScannedEntry entry;
+        const bool present = wanted && statChangedPath(localPathFor(catalogPath), options, mimeTypes, entry);
+
+        const auto storedFile = db.findFile(parent->id, name);
+        const auto storedDirectory = db.findDirectoryByPath(volumeId, catalogPath);
+        if (storedFile && (!present || entry.isDir)) {
+            if (!db.deleteFile(storedFile->id)) {
+                db.endBatch();
+                return -1;
+            }
+            ++written;
+        }
+        if (storedDirectory && (!present || !entry.isDir)) {
+            if (!db.deleteDirectory(storedDirectory->id)) {
+                db.endBatch();
+                return -1;
+            }
+            ++written;
+        }
+        if (!present) {
+            continue;
+        }
+
+        if (entry.isDir) {
+            if (!storedDirectory) {
+                DirectoryInfo dirInfo;
+                dirInfo.volumeId = volumeId;
+                dirInfo.parentId = parent->id;
+                dirInfo.name = name;
+                dirInfo.fullPath = catalogPath;
+                if (db.upsertDirectory(dirInfo) < 0) {
+                    db.endBatch();
+                    return -1;
+                }
+                ++written;
+                // A directory moved in arrives with its contents, and one
+                // created empty may have filled up before the events for
+                // its entries were wired up; a rescan catches both.
+                if (options.maxDepth < 0 || depth < options.maxDepth) {
+                    rescans.append(catalogPath);
+                }
+            }
+            continue;
+        }
+
+        FileInfo fileInfo;
+        fileInfo.directoryId = parent->id;
+        fileInfo.name = name;
+        fileInfo.size = entry.size;
+        fileInfo.mtime = dateTimeFromSecs(entry.mtime);
+        fileInfo.ctime = dateTimeFromSecs(entry.ctime);
+        fileInfo.fileType = entry.fileType;
+        fileInfo.inode = entry.inode;
+        fileInfo.linkCount = entry.linkCount;
+        if (storedFile) {
+            fileInfo.id = storedFile->id;
+            // Attribute-only events (chmod, touch without a change) end here.
+            if (storedFile->size == entry.size && secsOrInvalid(storedFile->mtime) == entry.mtime
+                && secsOrInvalid(storedFile->ctime) == entry.ctime && storedFile->inode == entry.inode
+                && storedFile->linkCount == entry.linkCount) {
+                continue;
+            }
+        }
+        fileInfo.id = db.upsertFile(fileInfo);
+        if (fileInfo.id < 0) {
+            db.endBatch();
+            return -1;
+        }
+        ++written;
+
+        if (hasher) {
+            FileHasher::Job job;
+            job.key = fileInfo.id;
+            job.sampled = sampledHashes;
+            job.path = QFile::encodeName(localPathFor(catalogPath));
+            if (!hasher->submit(std::move(job))) {
+                db.endBatch();
+                return -1;
+            }
+        }
+    }
+
+    if (hasher) {
+        // Digests that finished before a cancel are still stored.
+        while (!hasher->waitForIdle(250)) {
+            if (m_cancelRequested.load(std::memory_order_relaxed)) {
+                hasher->cancel();
+                break;
+            }
+        }
+        std::vector<FileHasher::Result> results;
+        hasher->takeResults(results);
+        for (const FileHasher::Result &result : results) {
+            const int fileId = static_cast<int>(result.key);
+            if ((!result.fingerprint.isEmpty() && !db.setFileFingerprint(fileId, result.fingerprint))
+                || (!result.hash.isEmpty() && !db.setFileHash(fileId, result.hash))) {
+                db.endBatch();
+                return -1;
+            }
+        }
+    }
+    if (!db.endBatch()) {
+        return -1;
+    }
+
+    ScanOptions rescanOptions = options;
+    rescanOptions.incremental = true;
+    rescanOptions.quickRescan = false;
+    rescanOptions.checkpoints = false;
+    for (const QString &rescan : std::as_const(rescans)) {
+        // A subtree reported after a queue overflow may be new as well; the
+        // nearest cataloged ancestor is listed instead.
+        QString subtree = rescan;
+        std::optional<DirectoryInfo> directory = db.findDirectoryByPath(volumeId, subtree);
+        while (!directory && subtree != QStringLiteral("/")) {
+            const qsizetype slash = subtree.lastIndexOf(QLatin1Char('/'));
+            subtree = slash == 0 ? QStringLiteral("/") : subtree.left(slash);
+            directory = db.findDirectoryByPath(volumeId, subtree);
+        }
+        if (!directory) {
+            return -1;
+        }
+        if (subtree != QStringLiteral("/") && !QFileInfo(localPathFor(subtree)).isDir()) {
+            if (!db.beginBatch()) {
+                return -1;
+            }
+            if (!db.deleteDirectory(directory->id)) {
+                db.abortBatch();
+                return -1;
+            }
+            if (!db.endBatch()) {
+                return -1;
+            }
+            ++written;
+            continue;
+        }
+
+        ScanStats rescanStats;
+        auto progress = [&rescanStats](const QString &, const ScanStats &stats) {
+            rescanStats = stats;
+            return true;
+        };
+        if (!run(root, db, volumeId, directory->id, rescanOptions, progress, false,
+                 subtree == QStringLiteral("/") ? QString() : subtree)) {
+            return -1;
+        }
+        written += rescanStats.added + rescanStats.updated + rescanStats.removed;
+    }
+    return written;
+}
+
+int KatalogueScanner::resolveHashCollisions(KatalogueDatabase &db, const ScanOptions &options) {
+    m_cancelRequested.store(false);
+    if (!db.isOpen()) {
+        return -1;
+    }
+
+    FileHasher::Options hashOptions;
+    hashOptions.threads = options.hashThreads;
+    hashOptions.algorithm = options.hashAlgorithm;
+    FileHasher hasher(hashOptions);
+
+    // Unreadable files (e.g. on an unmounted volume) keep an empty hash and
+    // stay in the candidate list, so page past them.
+    constexpr int pageSize = 256;
+    int skipped = 0;
+    int resolved = 0;
+    std::vector<FileHasher::Result> results;
+    for (;;) {
+        const auto candidates = db.fingerprintCollisions(pageSize, skipped);
+        if (candidates.isEmpty()) {
+            break;
+        }
+        for (const auto &candidate : candidates) {
+            FileHasher::Job job;
+            job.key = candidate.fileId;
+            job.path = QFile::encodeName(candidate.localPath);
+            if (!hasher.submit(std::move(job))) {
+                return resolved;
+            }
+        }
+        while (!hasher.waitForIdle(250)) {
+            if (m_cancelRequested.load(std::memory_order_relaxed)) {
+                hasher.cancel();
+                return resolved;
+            }
+        }
+
+        results.clear();
+        hasher.takeResults(results);
+        if (!db.beginBatch()) {
+            return resolved;
+        }
+        int stored = 0;
+        for (const auto &result : results) {
+            if (result.hash.isEmpty() || !db.setFileHash(static_cast<int>(result.key), result.hash)) {
+                ++skipped;
+                continue;
+            }
+            ++stored;
+        }
+        if (!db.endBatch()) {
+            return resolved;
+        }
+        resolved += stored;
+    }
+    return resolved;
+}
+
 void KatalogueScanner::cancel() {
     m_cancelled.store(true);
     requestCancel();
@@ -193,28 +2071,62 @@ bool KatalogueScanner::isCancelRequested() const {
     return m_cancelRequested.load(std::memory_order_relaxed);
 }
 
-bool KatalogueScanner::isExcluded(const QString &relativePath,
-                                  const QString &name,
-                                  const ScanOptions &options) const {
-    if (options.excludePatterns.isEmpty()) {
-        return false;
-    }
-
-    if (QDir::match(options.excludePatterns, relativePath)) {
-        return true;
-    }
+void KatalogueScanner::resetCancel() {
+    m_cancelled.store(false);
+    m_cancelRequested.store(false);
+}
 
-    return QDir::match(options.excludePatterns, name);
+void ScanPhaseStats::add(const ScanPhaseStats &other) {
+    readNs += other.readNs;
+    statNs += other.statNs;
+    throttleNs += other.throttleNs;
+    sniffNs += other.sniffNs;
+    writeNs += other.writeNs;
+    indexNs += other.indexNs;
+    directoriesRead += other.directoriesRead;
+    stats += other.stats;
+    sniffs += other.sniffs;
+    commits += other.commits;
 }
 
-bool KatalogueScanner::withinDepth(const QString &relativePath, int maxDepth) const {
-    if (maxDepth < 0) {
-        return true;
-    }
-    const QString cleaned = QDir::cleanPath(relativePath);
-    if (cleaned.isEmpty() || cleaned == QStringLiteral(".")) {
-        return true;
+QByteArray scanReportJson(const ScanStats &stats) {
+    auto milliseconds = [](qint64 ns) { return static_cast<double>(ns) / 1e6; };
+    auto directories = [&milliseconds](const QList<DirectoryTiming> &timings) {
+        QJsonArray array;
+        for (const DirectoryTiming &timing : timings) {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("path"), timing.path);
+            obj.insert(QStringLiteral("wallMs"), milliseconds(timing.wallNs));
+            obj.insert(QStringLiteral("entries"), timing.entries);
+            array.append(obj);
+        }
+        return array;
+    };
+
+    QJsonObject phases;
+    phases.insert(QStringLiteral("readMs"), milliseconds(stats.phases.readNs));
+    phases.insert(QStringLiteral("statMs"), milliseconds(stats.phases.statNs));
+    phases.insert(QStringLiteral("throttleMs"), milliseconds(stats.phases.throttleNs));
+    phases.insert(QStringLiteral("sniffMs"), milliseconds(stats.phases.sniffNs));
+    phases.insert(QStringLiteral("writeMs"), milliseconds(stats.phases.writeNs));
+    phases.insert(QStringLiteral("indexMs"), milliseconds(stats.phases.indexNs));
+    phases.insert(QStringLiteral("directoriesRead"), stats.phases.directoriesRead);
+    phases.insert(QStringLiteral("stats"), static_cast<double>(stats.phases.stats));
+    phases.insert(QStringLiteral("sniffs"), static_cast<double>(stats.phases.sniffs));
+    phases.insert(QStringLiteral("commits"), stats.phases.commits);
+
+    QJsonObject report;
+    report.insert(QStringLiteral("directories"), stats.directories);
+    report.insert(QStringLiteral("files"), stats.files);
+    report.insert(QStringLiteral("totalBytes"), static_cast<double>(stats.totalBytes));
+    report.insert(QStringLiteral("elapsedMs"), static_cast<double>(stats.elapsedMs));
+    report.insert(QStringLiteral("filesPerSecond"), stats.filesPerSecond);
+    report.insert(QStringLiteral("bytesPerSecond"), stats.bytesPerSecond);
+    report.insert(QStringLiteral("phases"), phases);
+    report.insert(QStringLiteral("slowestDirectories"), directories(stats.slowestDirectories));
+    report.insert(QStringLiteral("largestDirectories"), directories(stats.largestDirectories));
+    if (!stats.skippedMounts.isEmpty()) {
+        report.insert(QStringLiteral("skippedMounts"), QJsonArray::fromStringList(stats.skippedMounts));
     }
-    const QStringList parts = cleaned.split('/', Qt::SkipEmptyParts);
-    return parts.size() <= maxDepth;
+    return QJsonDocument(report).toJson(QJsonDocument::Indented);
 }
@@ -3,25 +3,172 @@
 #include <atomic>
 #include <functional>
 
+#include <QList>
 #include <QString>
 #include <QStringList>
 
 #include "katalogue_database.h"
+#include "katalogue_device.h"
+#include "katalogue_hasher.h"
+#include "katalogue_mime.h"
+#include "katalogue_throttle.h"
+#include "katalogue_watcher.h"
+
+enum class HashMode {
+    // Read every file completely.
+    Full,
+    // Store only a head/middle/tail fingerprint; full hashes are computed
+    // later for files whose fingerprints collide (resolveHashCollisions()).
+    Sampled
+};
+
+enum class TraversalOrder {
+    // Inode order on rotational media (see isRotationalPath()), directory order elsewhere.
+    Auto,
+    // Whatever order the filesystem returns entries in; parallel and depth-first.
+    Directory,
+    // Pending directories, per-directory stats and hash reads in ascending
+    // inode order, so a disk head sweeps instead of seeking back and forth.
+    Inode,
+    // Like Inode, but keyed by the FIEMAP offset of each directory's (and,
+    // when hashing, each file's) first extent. Costs an open per entry.
+    Physical
+};
 
 struct ScanOptions {
     int maxDepth = -1;
     bool followSymlinks = false;
     bool includeHidden = false;
+    MimeDetection mimeDetection = MimeDetection::Auto;
+    // Content-hash new and changed files into files.hash on a separate pool.
     bool computeHashes = false;
+    HashAlgorithm hashAlgorithm = HashAlgorithm::Xxh64;
+    HashMode hashMode = HashMode::Full;
+    // 0 picks FileHasher's default.
+    int hashThreads = 0;
+    // Number of traversal worker threads; 0 picks QThread::idealThreadCount().
+    int workerThreads = 0;
+    // Use the getdents64/statx walker on Linux instead of QDir listings.
+    bool nativeTraversal = true;
+    // Batch per-directory statx calls through io_uring (native walker only);
+    // silently falls back to synchronous stats where io_uring is unavailable.
+    bool ioUring = false;
+    int ioUringQueueDepth = 128;
+    // Ordered traversals need the native walker; they default to a single
+    // traversal and hashing thread unless workerThreads/hashThreads are set.
+    TraversalOrder traversalOrder = TraversalOrder::Auto;
+    // Diff against what the catalog already holds for the volume instead of
+    // rewriting it: rows are matched by (directory, name) and only changed
+    // entries are written, so file ids, notes and tags survive a rescan.
+    bool incremental = false;
+    // Incremental scan that also trusts the catalog for the files of any
+    // directory whose mtime (and inode) match the stored stamp.
+    bool quickRescan = false;
+    // Keep a resume point (unlisted directory frontier plus counters) in the
+    // catalog, committed with each batch; see KatalogueScanner::resume().
+    bool checkpoints = true;
+    // Full (non-incremental) scans leave the search index alone while they
+    // write and index the volume in one pass once their rows are committed;
+    // see KatalogueDatabase::setSearchIndexStale().
+    bool deferSearchIndex = true;
+    // Scheduling of the traversal and hashing threads; the level only
+    // applies to BestEffort, niceness 0 keeps the CPU priority.
+    IoPriorityClass ioPriority = IoPriorityClass::Default;
+    int ioPriorityLevel = 4;
+    int niceness = 0;
+    // Slow the traversal down whenever the mean time per stat rises above
+    // this many milliseconds (0 = off), never exceeding maxStatsPerSecond
+    // (0 = no cap). See AdaptiveRateLimiter.
+    double targetStatLatencyMs = 0;
+    double maxStatsPerSecond = 0;
+    // Time between progress callbacks; rows are still committed in batches
+    // of their own, independent of reporting.
+    int progressIntervalMs = 1000;
+    // Keep this many of the slowest and of the largest directories in
+    // ScanStats (0 = none).
+    int slowDirectoryCount = 0;
+    // Stay on the filesystem the scan started on: directories on another
+    // device (mount points, btrfs subvolumes) are recorded but not entered.
+    // Only honoured on Linux, where device numbers are read.
+    bool oneFileSystem = false;
+    // Mounted filesystems of these types (see MountTable::matchesType()) are
+    // never entered, even without oneFileSystem.
+    QStringList skipFilesystemTypes = defaultSkippedFilesystemTypes();
+    // Wildcards without a '/' match names at any depth, ones with a '/' the
+    // path relative to the scan root (see ExcludeMatcher).
     QStringList excludePatterns;
 };
 
+// Cumulative time per scan phase in nanoseconds, summed over all traversal
+// threads (so it can exceed the wall time), and how often each ran.
+struct ScanPhaseStats {
+    // getdents64, or QDir listings including their stats.
+    qint64 readNs = 0;
+    qint64 statNs = 0;
+    // Waiting for the stat throttle.
+    qint64 throttleNs = 0;
+    // Content sniffing only; extension lookups are too cheap to time.
+    qint64 sniffNs = 0;
+    // The writer thread: catalog queries, inserts and commits.
+    qint64 writeNs = 0;
+    // Indexing a bulk-loaded volume for search after the last commit.
+    qint64 indexNs = 0;
+    int directoriesRead = 0;
+    qint64 stats = 0;
+    qint64 sniffs = 0;
+    int commits = 0;
+
+    void add(const ScanPhaseStats &other);
+};
+
+struct DirectoryTiming {
+    QString path;
+    // From the start of its listing until its rows were written.
+    qint64 wallNs = 0;
+    int entries = 0;
+};
+
 struct ScanStats {
     int directories = 0;
     int files = 0;
+    // Apparent size of everything listed; uniqueBytes counts files with
+    // several hardlinks once (native walker only, equal to totalBytes
+    // otherwise).
     qint64 totalBytes = 0;
+    qint64 uniqueBytes = 0;
+    // Catalog rows written by an incremental scan.
+    int added = 0;
+    int updated = 0;
+    int removed = 0;
+    int hashedFiles = 0;
+    qint64 hashedBytes = 0;
+    // Filled in only while a stat limit is configured: the rate over the
+    // last measurement window, the current limit (0 = unthrottled) and the
+    // mean time per stat.
+    double statsPerSecond = 0;
+    double statRateLimit = 0;
+    double statLatencyMs = 0;
+    // Rates since this run started. For scans of a whole filesystem the
+    // share done is estimated from its used inodes and bytes (statvfs), and
+    // etaSeconds extrapolated from it; both are -1 while unknown. Excluded
+    // and hidden entries make the estimate err on the long side.
+    qint64 elapsedMs = 0;
+    double filesPerSecond = 0;
+    double bytesPerSecond = 0;
+    double fractionDone = -1;
+    qint64 etaSeconds = -1;
+    ScanPhaseStats phases;
+    // Worst first; filled in when ScanOptions::slowDirectoryCount is set.
+    QList<DirectoryTiming> slowestDirectories;
+    QList<DirectoryTiming> largestDirectories;
+    // Catalog paths of mount points that were not descended into.
+    QStringList skippedMounts;
 };
 
+// Phases, rates and slow directories as a JSON document for tuning exclude
+// patterns and hardware; written by the daemon at the end of a scan.
+QByteArray scanReportJson(const ScanStats &stats);
+
 class KatalogueScanner {
 public:
     KatalogueScanner();
@@ -35,16 +182,51 @@ public:
               const ScanOptions &options = {},
               ProgressCallback progress = {});
 
+    // Continues an interrupted scan of volumeId from the checkpoint left in
+    // the catalog. Returns false when there is none or the scan stops again.
+    bool resume(int volumeId,
+                KatalogueDatabase &db,
+                const ScanOptions &options = {},
+                ProgressCallback progress = {});
+    // Volume written by the most recent scan() or resume().
+    int lastVolumeId() const;
+
     void cancel();
     void requestCancel();
     bool isCancelRequested() const;
+    // scan() and resume() keep a cancel that arrived before they started;
+    // a scanner that is run again must be reset first.
+    void resetCancel();
+
+    // Brings the rows of volumeId in line with the current state of the
+    // changed paths below rootPath (see FilesystemWatcher): files are
+    // upserted or deleted one by one, while new directories and
+    // changes.subtrees are rescanned incrementally. Returns the number of
+    // catalog rows written, or -1 on failure.
+    int applyChanges(int volumeId,
+                     const QString &rootPath,
+                     const WatchChanges &changes,
+                     KatalogueDatabase &db,
+                     const ScanOptions &options);
+
+    // Computes full hashes for files whose sampled fingerprints collide with
+    // another file in the catalog. Returns the number of files hashed, or -1
+    // when the database is not open.
+    int resolveHashCollisions(KatalogueDatabase &db, const ScanOptions &options);
+
+    static int effectiveWorkerCount(const ScanOptions &options);
 
 private:
-    bool isExcluded(const QString &relativePath,
-                    const QString &name,
-                    const ScanOptions &options) const;
-    bool withinDepth(const QString &relativePath, int maxDepth) const;
+    bool run(const QString &rootPath,
+             KatalogueDatabase &db,
+             int volumeId,
+             int rootId,
+             const ScanOptions &options,
+             ProgressCallback progress,
+             bool resuming,
+             const QString &subtreePath = QString());
 
     std::atomic_bool m_cancelled{false};
     std::atomic_bool m_cancelRequested{false};
+    int m_lastVolumeId = -1;
 };
@@ -0,0 +1,151 @@
+#include "katalogue_throttle.h"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#if defined(__linux__)
+// From linux/ioprio.h, which not every libc ships.
+constexpr int ioprioClassShift = 13;
+constexpr int ioprioClassBestEffort = 2;
+constexpr int ioprioClassIdle = 3;
+constexpr int ioprioWhoProcess = 1;
+#endif
+
+// Latency is judged over windows of this length so a single slow stat does
+// not halve the rate.
+constexpr auto windowLength = std::chrono::milliseconds(250);
+constexpr double minimumRate = 20.0;
+// Sleep in short slices so cancellation is noticed quickly.
+constexpr auto maxSleep = std::chrono::milliseconds(50);
+} // namespace
+
+bool applyThreadPriority(IoPriorityClass ioClass, int level, int niceness) {
+#if defined(__linux__)
+    bool ok = true;
+    if (ioClass != IoPriorityClass::Default) {
+        const int klass = ioClass == IoPriorityClass::Idle ? ioprioClassIdle : ioprioClassBestEffort;
+        const int data = ioClass == IoPriorityClass::Idle ? 0 : std::clamp(level, 0, 7);
+        // With IOPRIO_WHO_PROCESS, 0 means the calling thread.
+        ok = ::syscall(SYS_ioprio_set, ioprioWhoProcess, 0, (klass << ioprioClassShift) | data) == 0;
+    }
+    if (niceness != 0) {
+        // Nice values are per thread on Linux.
+        const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+        ok = ::setpriority(PRIO_PROCESS, tid, std::clamp(niceness, -20, 19)) == 0 && ok;
+    }
+    return ok;
+#else
+    return ioClass == IoPriorityClass::Default && niceness == 0;
+#endif
+}
+
+AdaptiveRateLimiter::AdaptiveRateLimiter(double targetLatencyMs, double maxRate)
+    : m_targetLatencyMs(targetLatencyMs)
+    , m_maxRate(maxRate) {
+    m_rate = m_maxRate > 0 ? m_maxRate : 0;
+    m_lastRefill = Clock::now();
+    m_windowStart = m_lastRefill;
+}
+
+bool AdaptiveRateLimiter::isEnabled() const {
+    return m_targetLatencyMs > 0 || m_maxRate > 0;
+}
+
+bool AdaptiveRateLimiter::acquire(int count, const std::function<bool()> &shouldStop) {
+    if (!isEnabled() || count <= 0) {
+        return true;
+    }
+    for (;;) {
+        Clock::duration wait;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_rate <= 0) {
+                return true;
+            }
+            refillLocked(Clock::now());
+            if (m_tokens > 0) {
+                m_tokens -= count;
+                return true;
+            }
+            wait = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((1.0 - m_tokens) / m_rate));
+        }
+        if (shouldStop && shouldStop()) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::min<Clock::duration>(wait, maxSleep));
+    }
+}
+
+void AdaptiveRateLimiter::record(int count, std::chrono::nanoseconds elapsed) {
+    if (!isEnabled() || count <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_windowStats += count;
+    m_windowNanoseconds += static_cast<double>(elapsed.count());
+    const auto now = Clock::now();
+    if (now - m_windowStart >= windowLength) {
+        adjustLocked(now);
+    }
+}
+
+double AdaptiveRateLimiter::rate() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rate;
+}
+
+double AdaptiveRateLimiter::observedRate() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_observedRate;
+}
+
+double AdaptiveRateLimiter::meanLatencyMs() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_meanLatencyMs;
+}
+
+void AdaptiveRateLimiter::refillLocked(Clock::time_point now) {
+    const double seconds = std::chrono::duration<double>(now - m_lastRefill).count();
+    m_lastRefill = now;
+    // A quarter second worth of burst at most.
+    m_tokens = std::min(m_tokens + seconds * m_rate, std::max(1.0, m_rate / 4));
+}
+
+void AdaptiveRateLimiter::adjustLocked(Clock::time_point now) {
+    const double seconds = std::chrono::duration<double>(now - m_windowStart).count();
+    m_observedRate = static_cast<double>(m_windowStats) / seconds;
+    m_meanLatencyMs = m_windowNanoseconds / static_cast<double>(m_windowStats) / 1e6;
+    m_windowStart = now;
+    m_windowStats = 0;
+    m_windowNanoseconds = 0;
+
+    if (m_targetLatencyMs <= 0) {
+        return;
+    }
+    if (m_meanLatencyMs > m_targetLatencyMs) {
+        const double current = m_rate > 0 ? m_rate : m_observedRate;
+        refillLocked(now);
+        m_rate = std::max(current / 2, minimumRate);
+        m_tokens = std::min(m_tokens, 0.0);
+        return;
+    }
+    if (m_rate <= 0) {
+        return;
+    }
+    m_rate += std::max(minimumRate, m_rate / 20);
+    if (m_maxRate > 0) {
+        m_rate = std::min(m_rate, m_maxRate);
+    } else if (m_rate > m_observedRate * 4) {
+        // The workers are no longer asking for anything near the limit;
+        // lift it until latency says otherwise.
+        m_rate = 0;
+    }
+}
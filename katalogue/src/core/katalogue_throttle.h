@@ -0,0 +1,68 @@
+#pragma once
+
+// Keeps scans from starving other users of a volume: per-thread I/O and
+// CPU priority, and a rate limiter for the traversal's metadata calls that
+// follows the latency the storage is currently delivering.
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+enum class IoPriorityClass {
+    // Inherit whatever the daemon runs with.
+    Default,
+    BestEffort,
+    // Only gets disk time when nobody else wants it.
+    Idle
+};
+
+// Applies ioprio_set() and a nice value to the calling thread; level is the
+// best-effort priority (0 highest, 7 lowest) and niceness 0 leaves the CPU
+// priority alone. Returns false if the kernel refused either (Linux only).
+bool applyThreadPriority(IoPriorityClass ioClass, int level, int niceness);
+
+// AIMD limiter shared by the traversal workers. Callers take permits before
+// a batch of stats and report how long the batch took: while the mean time
+// per stat stays under the target the allowed rate creeps back up in small
+// steps, above it the rate is halved. It starts unthrottled (or at maxRate).
+class AdaptiveRateLimiter {
+public:
+    // targetLatencyMs <= 0 disables adaptation, maxRate <= 0 the fixed cap;
+    // with both off acquire() never blocks.
+    AdaptiveRateLimiter(double targetLatencyMs, double maxRate);
+
+    bool isEnabled() const;
+
+    // Blocks until count stats may be issued. Returns false once shouldStop() turns true.
+    bool acquire(int count, const std::function<bool()> &shouldStop);
+    void record(int count, std::chrono::nanoseconds elapsed);
+
+    // Allowed stats per second, 0 while unthrottled.
+    double rate() const;
+    // Stats per second actually issued over the last measurement window.
+    double observedRate() const;
+    double meanLatencyMs() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void refillLocked(Clock::time_point now);
+    void adjustLocked(Clock::time_point now);
+
+    const double m_targetLatencyMs;
+    const double m_maxRate;
+
+    mutable std::mutex m_mutex;
+    double m_rate = 0;
+    // May go negative: a batch larger than the bucket is let through and
+    // later callers wait until the debt is paid off.
+    double m_tokens = 0;
+    Clock::time_point m_lastRefill;
+
+    Clock::time_point m_windowStart;
+    std::int64_t m_windowStats = 0;
+    double m_windowNanoseconds = 0;
+    double m_observedRate = 0;
+    double m_meanLatencyMs = 0;
+};
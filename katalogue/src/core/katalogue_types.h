@@ -11,6 +11,9 @@ struct VolumeInfo {
     QString fsUuid;
     QString fsType;
     QString physicalHint;
+    // Absolute path the volume was last scanned from; empty for volumes
+    // that were imported or ingested rather than scanned.
+    QString rootPath;
     qint64 totalSize = 0;
     QDateTime createdAt;
     QDateTime updatedAt;
@@ -22,6 +25,10 @@ struct DirectoryInfo {
     int parentId = -1;
     QString name;
     QString fullPath;
+    // Directory mtime/inode as of the last complete listing; used by quick
+    // rescans to skip directories whose entries cannot have changed.
+    QDateTime mtime;
+    quint64 inode = 0;
 };
 
 struct FileInfo {
@@ -34,7 +41,12 @@ struct FileInfo {
     QDateTime ctime;
     QString fileType;
     QString hash;
+    // Sampled head/middle/tail digest; see FileHasher::fingerprintFile().
+    QString fingerprint;
     quint32 attrs = 0;
+    // 0 when unknown (catalogs from older versions, QDir-based scans).
+    quint64 inode = 0;
+    quint32 linkCount = 0;
 };
 
 struct SearchResult {
@@ -49,6 +61,18 @@ struct SearchResult {
     QDateTime mtime;
 };
 
+// Progress of an interrupted scan. The directories still to be listed are
+// kept next to it; see KatalogueDatabase::visitCheckpointDirectories().
+struct ScanCheckpoint {
+    int volumeId = -1;
+    QString rootPath;
+    int directories = 0;
+    int files = 0;
+    qint64 totalBytes = 0;
+    qint64 uniqueBytes = 0;
+    QDateTime updatedAt;
+};
+
 struct VirtualFolderInfo {
     int id = -1;
     int parentId = -1;
@@ -0,0 +1,304 @@
+#include "katalogue_uring.h"
+
+#ifdef KATALOGUE_HAVE_IO_URING
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+constexpr unsigned int uringStatxMask = STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_CTIME
+                                        | STATX_BTIME | STATX_INO | STATX_NLINK;
+
+int uringSetup(unsigned entries, io_uring_params *params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+unsigned loadAcquire(unsigned *value) {
+    return std::atomic_ref<unsigned>(*value).load(std::memory_order_acquire);
+}
+
+void storeRelease(unsigned *value, unsigned next) {
+    std::atomic_ref<unsigned>(*value).store(next, std::memory_order_release);
+}
+} // namespace
+
+struct UringStatBatch::Ring {
+    int fd = -1;
+    void *sqMap = nullptr;
+    void *cqMap = nullptr;
+    std::size_t sqMapSize = 0;
+    std::size_t cqMapSize = 0;
+    io_uring_sqe *sqes = nullptr;
+    std::size_t sqesSize = 0;
+
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned sqEntries = 0;
+
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+    unsigned cqEntries = 0;
+
+    std::vector<struct statx> buffers;
+
+    ~Ring() {
+        if (sqes) {
+            ::munmap(sqes, sqesSize);
+        }
+        if (cqMap && cqMap != sqMap) {
+            ::munmap(cqMap, cqMapSize);
+        }
+        if (sqMap) {
+            ::munmap(sqMap, sqMapSize);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool setup(unsigned depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = uringSetup(depth, &params);
+        if (fd < 0) {
+            return false;
+        }
+
+        sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+        }
+
+        sqMap = ::mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED) {
+            sqMap = nullptr;
+            return false;
+        }
+        if (singleMap) {
+            cqMap = sqMap;
+        } else {
+            cqMap = ::mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqMap == MAP_FAILED) {
+                cqMap = nullptr;
+                return false;
+            }
+        }
+
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqesMap = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqesMap == MAP_FAILED) {
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe *>(sqesMap);
+
+        auto *sq = static_cast<char *>(sqMap);
+        sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        sqEntries = params.sq_entries;
+
+        auto *cq = static_cast<char *>(cqMap);
+        cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        cqEntries = params.cq_entries;
+
+        buffers.resize(sqEntries);
+        return true;
+    }
+
+    void queueStatx(int dirFd, const char *name, int flags, unsigned slot, std::uint64_t userData) {
+        const unsigned tail = *sqTail;
+        const unsigned index = tail & *sqMask;
+        io_uring_sqe *sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = dirFd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(name);
+        sqe->len = uringStatxMask;
+        sqe->off = reinterpret_cast<std::uint64_t>(&buffers[slot]);
+        sqe->statx_flags = static_cast<std::uint32_t>(flags);
+        sqe->user_data = userData;
+        sqArray[index] = index;
+        storeRelease(sqTail, tail + 1);
+    }
+
+    // Submits what is still queued and throws away completions until
+    // outstanding requests have all come back.
+    bool drain(unsigned toSubmit, std::size_t outstanding) {
+        while (outstanding > 0) {
+            const int entered = uringEnter(fd, toSubmit, 1, IORING_ENTER_GETEVENTS);
+            if (entered < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            toSubmit -= std::min(toSubmit, static_cast<unsigned>(entered));
+            const unsigned head = *cqHead;
+            const unsigned tail = loadAcquire(cqTail);
+            outstanding -= std::min<std::size_t>(outstanding, tail - head);
+            storeRelease(cqHead, tail);
+        }
+        return true;
+    }
+};
+
+UringStatBatch::UringStatBatch() = default;
+
+UringStatBatch::~UringStatBatch() {
+    delete m_ring;
+}
+
+bool UringStatBatch::init(unsigned queueDepth) {
+    delete m_ring;
+    m_ring = new Ring;
+    if (!m_ring->setup(queueDepth)) {
+        delete m_ring;
+        m_ring = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool UringStatBatch::isValid() const {
+    return m_ring != nullptr;
+}
+
+bool UringStatBatch::statAll(int dirFd,
+                             const std::vector<const char *> &names,
+                             bool followSymlinks,
+                             std::vector<NativeStat> &results,
+                             std::vector<char> &ok) {
+    results.assign(names.size(), NativeStat());
+    ok.assign(names.size(), 0);
+    if (!m_ring) {
+        return false;
+    }
+
+    Ring &ring = *m_ring;
+    const int flags = (followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW) | AT_NO_AUTOMOUNT;
+    const unsigned capacity = std::min(ring.sqEntries, ring.cqEntries);
+
+    // user_data carries (slot << 32 | name index) so statx buffers can be
+    // recycled while other requests are still in flight.
+    std::vector<unsigned> freeSlots;
+    freeSlots.reserve(capacity);
+    for (unsigned slot = capacity; slot > 0; --slot) {
+        freeSlots.push_back(slot - 1);
+    }
+
+    std::size_t nextName = 0;
+    std::size_t completed = 0;
+    unsigned queued = 0;
+
+    while (completed < names.size()) {
+        while (nextName < names.size() && !freeSlots.empty()) {
+            const unsigned slot = freeSlots.back();
+            freeSlots.pop_back();
+            const std::uint64_t userData = (static_cast<std::uint64_t>(slot) << 32) | nextName;
+            ring.queueStatx(dirFd, names[nextName], flags, slot, userData);
+            ++nextName;
+            ++queued;
+        }
+
+        const int entered = uringEnter(ring.fd, queued, 1, IORING_ENTER_GETEVENTS);
+        if (entered < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Completions left in the ring would land in the next batch,
+            // indexing its smaller vectors. If they cannot be collected,
+            // give up on the ring so later batches stat synchronously; the
+            // kernel may still write into the statx buffers, so they are
+            // deliberately leaked rather than freed.
+            if (!ring.drain(queued, nextName - completed)) {
+                static_cast<void>(new std::vector<struct statx>(std::move(ring.buffers)));
+                delete m_ring;
+                m_ring = nullptr;
+            }
+            return false;
+        }
+        queued -= std::min(queued, static_cast<unsigned>(entered));
+
+        unsigned head = *ring.cqHead;
+        const unsigned tail = loadAcquire(ring.cqTail);
+        while (head != tail) {
+            const io_uring_cqe &cqe = ring.cqes[head & *ring.cqMask];
+            const unsigned slot = static_cast<unsigned>(cqe.user_data >> 32);
+            const std::size_t index = static_cast<std::size_t>(cqe.user_data & 0xffffffffu);
+            if (cqe.res == 0) {
+                nativeStatFromStatx(ring.buffers[slot], results[index]);
+                ok[index] = 1;
+            }
+            freeSlots.push_back(slot);
+            ++completed;
+            ++head;
+        }
+        storeRelease(ring.cqHead, head);
+    }
+    return true;
+}
+
+bool UringStatBatch::isSupported() {
+    static const bool supported = [] {
+        UringStatBatch probe;
+        if (!probe.init(4)) {
+            return false;
+        }
+        // Kernels before 5.6 accept the ring but reject IORING_OP_STATX.
+        std::vector<NativeStat> results;
+        std::vector<char> ok;
+        const std::vector<const char *> names{"/"};
+        return probe.statAll(AT_FDCWD, names, false, results, ok) && ok[0];
+    }();
+    return supported;
+}
+
+#else
+
+struct UringStatBatch::Ring {};
+
+UringStatBatch::UringStatBatch() = default;
+
+UringStatBatch::~UringStatBatch() = default;
+
+bool UringStatBatch::init(unsigned) {
+    return false;
+}
+
+bool UringStatBatch::isValid() const {
+    return false;
+}
+
+bool UringStatBatch::statAll(int, const std::vector<const char *> &, bool,
+                             std::vector<NativeStat> &, std::vector<char> &) {
+    return false;
+}
+
+bool UringStatBatch::isSupported() {
+    return false;
+}
+
+#endif // KATALOGUE_HAVE_IO_URING
@@ -0,0 +1,46 @@
+#pragma once
+
+// Minimal io_uring engine used by KatalogueScanner to keep many statx
+// requests in flight per directory. Talks to the kernel through the raw
+// syscalls so there is no liburing dependency; callers fall back to
+// synchronous nativeStatAt() whenever init() fails.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "katalogue_native_walker.h"
+
+#if defined(KATALOGUE_HAVE_NATIVE_WALKER) && __has_include(<linux/io_uring.h>)
+#define KATALOGUE_HAVE_IO_URING 1
+#endif
+
+class UringStatBatch {
+public:
+    UringStatBatch();
+    ~UringStatBatch();
+
+    UringStatBatch(const UringStatBatch &) = delete;
+    UringStatBatch &operator=(const UringStatBatch &) = delete;
+
+    // Sets up a ring with the given queue depth. Returns false when the
+    // kernel (or a seccomp policy) does not allow io_uring.
+    bool init(unsigned queueDepth = 128);
+    bool isValid() const;
+
+    // Stats every name relative to dirFd. ok[i] is set to 1 when results[i]
+    // holds valid data. Returns false if the ring itself failed, in which
+    // case the caller should redo the batch synchronously.
+    bool statAll(int dirFd,
+                 const std::vector<const char *> &names,
+                 bool followSymlinks,
+                 std::vector<NativeStat> &results,
+                 std::vector<char> &ok);
+
+    // Probes once per process whether io_uring with IORING_OP_STATX works.
+    static bool isSupported();
+
+private:
+    struct Ring;
+    Ring *m_ring = nullptr;
+};
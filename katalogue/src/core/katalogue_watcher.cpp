@@ -0,0 +1,396 @@
+#include "katalogue_watcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Beyond this many distinct paths a batch records the parent directory for
+// a rescan instead, so a mass change does not grow the batch without bound.
+constexpr int maxBatchPaths = 4096;
+constexpr int maxCachedHandles = 4096;
+
+#if defined(__linux__)
+constexpr uint32_t inotifyMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB
+                                 | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+// struct file_handle with room for the largest handle a filesystem hands out.
+struct HandleBuffer {
+    struct file_handle handle;
+    unsigned char bytes[MAX_HANDLE_SZ];
+};
+#endif
+} // namespace
+
+void WatchChanges::clear() {
+    paths.clear();
+    subtrees.clear();
+}
+
+FilesystemWatcher::FilesystemWatcher(const QString &rootPath) {
+    // fanotify resolves handles to canonical paths, so compare against one.
+    const QFileInfo rootInfo(rootPath);
+    m_rootPath = rootInfo.canonicalFilePath().isEmpty() ? QDir::cleanPath(rootInfo.absoluteFilePath())
+                                                        : rootInfo.canonicalFilePath();
+}
+
+FilesystemWatcher::~FilesystemWatcher() {
+    stop();
+}
+
+bool FilesystemWatcher::start() {
+    stop();
+#if defined(__linux__)
+    if (startFanotify()) {
+        m_backend = WatchBackend::Fanotify;
+        return true;
+    }
+    stop();
+    if (startInotify()) {
+        m_backend = WatchBackend::Inotify;
+        return true;
+    }
+    stop();
+    return false;
+#else
+    m_errorString = QStringLiteral("Watching is only supported on Linux");
+    return false;
+#endif
+}
+
+void FilesystemWatcher::stop() {
+#if defined(__linux__)
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    if (m_mountFd >= 0) {
+        ::close(m_mountFd);
+    }
+#endif
+    m_fd = -1;
+    m_mountFd = -1;
+    m_backend = WatchBackend::None;
+    m_handlePaths.clear();
+    m_watchPaths.clear();
+}
+
+QString FilesystemWatcher::rootPath() const {
+    return m_rootPath;
+}
+
+bool FilesystemWatcher::collect(WatchChanges &changes,
+                                std::chrono::milliseconds settle,
+                                const std::function<bool()> &shouldStop) {
+    if (m_fd < 0) {
+        return false;
+    }
+    while (changes.isEmpty()) {
+        if (shouldStop()) {
+            return false;
+        }
+        const int ready = pollEvents(250);
+        if (ready < 0 || (ready > 0 && !readEvents(changes))) {
+            return false;
+        }
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + settle;
+    for (;;) {
+        if (shouldStop()) {
+            return false;
+        }
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            return true;
+        }
+        const int ready = pollEvents(static_cast<int>(std::min<qint64>(remaining.count(), 250)));
+        if (ready < 0 || (ready > 0 && !readEvents(changes))) {
+            return false;
+        }
+    }
+}
+
+int FilesystemWatcher::pollEvents(int timeoutMs) {
+#if defined(__linux__)
+    struct pollfd descriptor = {m_fd, POLLIN, 0};
+    const int ready = ::poll(&descriptor, 1, timeoutMs);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    return ready > 0 ? 1 : 0;
+#else
+    Q_UNUSED(timeoutMs);
+    return -1;
+#endif
+}
+
+bool FilesystemWatcher::readEvents(WatchChanges &changes) {
+    if (m_handlePaths.size() > maxCachedHandles) {
+        m_handlePaths.clear();
+    }
+    return m_backend == WatchBackend::Fanotify ? readFanotifyEvents(changes) : readInotifyEvents(changes);
+}
+
+void FilesystemWatcher::record(WatchChanges &changes, const QString &path) const {
+    if (!contains(path)) {
+        return;
+    }
+    if (changes.paths.size() < maxBatchPaths || changes.paths.contains(path)) {
+        changes.paths.insert(path);
+        return;
+    }
+    const QString parent = path == m_rootPath ? path : QFileInfo(path).path();
+    changes.subtrees.insert(contains(parent) ? parent : m_rootPath);
+}
+
+bool FilesystemWatcher::contains(const QString &path) const {
+    if (m_rootPath == QStringLiteral("/")) {
+        return path.startsWith(QLatin1Char('/'));
+    }
+    return path == m_rootPath || (path.startsWith(m_rootPath) && path.at(m_rootPath.size()) == QLatin1Char('/'));
+}
+
+#if defined(__linux__)
+bool FilesystemWatcher::startFanotify() {
+    m_fd = ::fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME,
+                           O_RDONLY | O_CLOEXEC | O_LARGEFILE);
+    if (m_fd < 0) {
+        return false;
+    }
+    const QByteArray root = QFile::encodeName(m_rootPath);
+    const uint64_t mask = FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CLOSE_WRITE | FAN_ATTRIB
+                          | FAN_ONDIR;
+    if (::fanotify_mark(m_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask, AT_FDCWD, root.constData()) != 0) {
+        return false;
+    }
+    m_mountFd = ::open(root.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (m_mountFd < 0) {
+        return false;
+    }
+    // Turning handles back into paths needs CAP_DAC_READ_SEARCH on top of
+    // the CAP_SYS_ADMIN the mark needed; find out now rather than per event.
+    HandleBuffer probe;
+    probe.handle.handle_bytes = MAX_HANDLE_SZ;
+    int mountId = 0;
+    if (::name_to_handle_at(AT_FDCWD, root.constData(), &probe.handle, &mountId, 0) != 0) {
+        return false;
+    }
+    const int fd = ::open_by_handle_at(m_mountFd, &probe.handle, O_PATH | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ::close(fd);
+    return true;
+}
+
+bool FilesystemWatcher::startInotify() {
+    m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        m_errorString = QStringLiteral("inotify_init1 failed: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        return false;
+    }
+    addInotifyWatches(m_rootPath);
+    if (m_watchPaths.isEmpty()) {
+        if (m_errorString.isEmpty()) {
+            m_errorString = QStringLiteral("Cannot watch %1").arg(m_rootPath);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool FilesystemWatcher::readFanotifyEvents(WatchChanges &changes) {
+    // One buffer per call; poll() says straight away if more is waiting.
+    alignas(struct fanotify_event_metadata) char buffer[64 * 1024];
+    const ssize_t length = ::read(m_fd, buffer, sizeof(buffer));
+    if (length < 0) {
+        return errno == EAGAIN || errno == EINTR;
+    }
+    ssize_t remaining = length;
+    for (auto *event = reinterpret_cast<struct fanotify_event_metadata *>(buffer);
+         FAN_EVENT_OK(event, remaining); event = FAN_EVENT_NEXT(event, remaining)) {
+        if (event->vers != FANOTIFY_METADATA_VERSION) {
+            m_errorString = QStringLiteral("Unexpected fanotify metadata version");
+            return false;
+        }
+        if (event->mask & FAN_Q_OVERFLOW) {
+            changes.subtrees.insert(m_rootPath);
+            continue;
+        }
+        // A directory that moved or went away invalidates the cached
+        // paths of everything below it.
+        if ((event->mask & FAN_ONDIR) && (event->mask & (FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO))) {
+            m_handlePaths.clear();
+        }
+        if (event->event_len <= event->metadata_len) {
+            continue;
+        }
+        auto *info = reinterpret_cast<struct fanotify_event_info_fid *>(reinterpret_cast<char *>(event)
+                                                                         + event->metadata_len);
+        if (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME) {
+            continue;
+        }
+        auto *handle = reinterpret_cast<struct file_handle *>(info->handle);
+        const char *name = reinterpret_cast<const char *>(handle->f_handle + handle->handle_bytes);
+        const QString directory = resolveHandle(handle);
+        if (directory.isEmpty()) {
+            continue;
+        }
+        if (qstrcmp(name, ".") == 0) {
+            record(changes, directory);
+        } else {
+            record(changes, (directory == QStringLiteral("/") ? QString() : directory) + QLatin1Char('/')
+                                + QFile::decodeName(name));
+        }
+    }
+    return true;
+}
+
+// Directory handle -> current path, or an empty string for directories that
+// are gone or outside the root (a filesystem mark sees the whole filesystem).
+QString FilesystemWatcher::resolveHandle(const void *data) {
+    const auto *handle = static_cast<const struct file_handle *>(data);
+    const QByteArray key(static_cast<const char *>(data),
+                         static_cast<qsizetype>(sizeof(struct file_handle) + handle->handle_bytes));
+    const auto cached = m_handlePaths.constFind(key);
+    if (cached != m_handlePaths.constEnd()) {
+        return *cached;
+    }
+
+    HandleBuffer copy;
+    memcpy(&copy, data, std::min(static_cast<size_t>(key.size()), sizeof(copy)));
+    QString path;
+    const int fd = ::open_by_handle_at(m_mountFd, &copy.handle, O_PATH | O_CLOEXEC);
+    if (fd >= 0) {
+        char target[4096];
+        const QByteArray link = "/proc/self/fd/" + QByteArray::number(fd);
+        const ssize_t length = ::readlink(link.constData(), target, sizeof(target));
+        ::close(fd);
+        if (length > 0 && length < static_cast<ssize_t>(sizeof(target))) {
+            path = QFile::decodeName(QByteArray(target, static_cast<qsizetype>(length)));
+            if (path.endsWith(QStringLiteral(" (deleted)")) || !contains(path)) {
+                path.clear();
+            }
+        }
+    }
+    m_handlePaths.insert(key, path);
+    return path;
+}
+
+bool FilesystemWatcher::readInotifyEvents(WatchChanges &changes) {
+    // One buffer per call; poll() says straight away if more is waiting.
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    const ssize_t length = ::read(m_fd, buffer, sizeof(buffer));
+    if (length < 0) {
+        return errno == EAGAIN || errno == EINTR;
+    }
+    for (ssize_t offset = 0; offset < length;) {
+        const auto *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+        offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            changes.subtrees.insert(m_rootPath);
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            m_watchPaths.remove(event->wd);
+            continue;
+        }
+        const QString directory = m_watchPaths.value(event->wd);
+        if (directory.isEmpty()) {
+            continue;
+        }
+        const QString path = event->len > 0 ? (directory == QStringLiteral("/") ? QString() : directory)
+                                                  + QLatin1Char('/') + QFile::decodeName(event->name)
+                                            : directory;
+        // Watches follow the inode, so a directory moved away keeps
+        // reporting under its old path unless its watches are dropped.
+        if (event->mask & IN_ISDIR) {
+            if (event->mask & IN_MOVED_FROM) {
+                removeInotifyWatches(path);
+            }
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                addInotifyWatches(path);
+            }
+        }
+        record(changes, path);
+    }
+    return true;
+}
+
+void FilesystemWatcher::addInotifyWatches(const QString &directory) {
+    auto addWatch = [this](const QString &path) {
+        const int wd = ::inotify_add_watch(m_fd, QFile::encodeName(path).constData(), inotifyMask);
+        if (wd >= 0) {
+            m_watchPaths.insert(wd, path);
+            return true;
+        }
+        if (errno == ENOSPC && m_errorString.isEmpty()) {
+            m_errorString = QStringLiteral("inotify watch limit reached; raise fs.inotify.max_user_watches");
+            qWarning() << m_errorString;
+        }
+        return errno != ENOSPC;
+    };
+    if (!addWatch(directory)) {
+        return;
+    }
+    QDirIterator it(directory, QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::NoSymLinks,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (!addWatch(it.next())) {
+            return;
+        }
+    }
+}
+
+void FilesystemWatcher::removeInotifyWatches(const QString &directory) {
+    const QString prefix = directory + QLatin1Char('/');
+    for (auto it = m_watchPaths.begin(); it != m_watchPaths.end();) {
+        if (it.value() == directory || it.value().startsWith(prefix)) {
+            ::inotify_rm_watch(m_fd, it.key());
+            it = m_watchPaths.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+#else
+bool FilesystemWatcher::startFanotify() {
+    return false;
+}
+
+bool FilesystemWatcher::startInotify() {
+    return false;
+}
+
+bool FilesystemWatcher::readFanotifyEvents(WatchChanges &) {
+    return false;
+}
+
+bool FilesystemWatcher::readInotifyEvents(WatchChanges &) {
+    return false;
+}
+
+QString FilesystemWatcher::resolveHandle(const void *) {
+    return {};
+}
+
+void FilesystemWatcher::addInotifyWatches(const QString &) {}
+
+void FilesystemWatcher::removeInotifyWatches(const QString &) {}
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+// Change notifications for a scanned tree that stays mounted. Events are
+// only collected here, as paths; KatalogueScanner::applyChanges() reads
+// their current state back and updates the catalog.
+
+#include <chrono>
+#include <functional>
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+// Changes seen since the last batch, coalesced by path. All paths are
+// absolute and at or below the watched root.
+struct WatchChanges {
+    // Entries that were created, written, removed, renamed or had their
+    // attributes changed.
+    QSet<QString> paths;
+    // Directories to rescan completely, e.g. after the kernel queue
+    // overflowed and events were lost.
+    QSet<QString> subtrees;
+
+    bool isEmpty() const { return paths.isEmpty() && subtrees.isEmpty(); }
+    void clear();
+};
+
+enum class WatchBackend {
+    None,
+    // One filesystem-wide mark reporting (directory handle, name) pairs;
+    // needs CAP_SYS_ADMIN and CAP_DAC_READ_SEARCH.
+    Fanotify,
+    // One watch per directory; limited by fs.inotify.max_user_watches.
+    Inotify
+};
+
+// Linux only; start() fails elsewhere. Network filesystems (NFS, SMB)
+// only report changes made through this machine's own mount.
+class FilesystemWatcher {
+public:
+    explicit FilesystemWatcher(const QString &rootPath);
+    ~FilesystemWatcher();
+
+    FilesystemWatcher(const FilesystemWatcher &) = delete;
+    FilesystemWatcher &operator=(const FilesystemWatcher &) = delete;
+
+    // Tries fanotify first and falls back to inotify.
+    bool start();
+    void stop();
+    WatchBackend backend() const { return m_backend; }
+    // Canonical form of the root; reported paths start with it.
+    QString rootPath() const;
+    QString errorString() const { return m_errorString; }
+
+    // Waits for the first event, then keeps reading until settle has passed
+    // so that bursts (an unpacked archive, a save via rename) end up in one
+    // batch. Returns false when shouldStop() turned true or the watch broke.
+    bool collect(WatchChanges &changes,
+                 std::chrono::milliseconds settle,
+                 const std::function<bool()> &shouldStop);
+
+private:
+    bool startFanotify();
+    bool startInotify();
+    // 1 when events are waiting, 0 on timeout, -1 on error.
+    int pollEvents(int timeoutMs);
+    bool readEvents(WatchChanges &changes);
+    bool readFanotifyEvents(WatchChanges &changes);
+    bool readInotifyEvents(WatchChanges &changes);
+    void addInotifyWatches(const QString &directory);
+    void removeInotifyWatches(const QString &directory);
+    QString resolveHandle(const void *handle);
+    void record(WatchChanges &changes, const QString &path) const;
+    bool contains(const QString &path) const;
+
+    QString m_rootPath;
+    WatchBackend m_backend = WatchBackend::None;
+    QString m_errorString;
+    int m_fd = -1;
+    // Any descriptor on the watched filesystem, for open_by_handle_at().
+    int m_mountFd = -1;
+    // Directory handle -> path, dropped whenever a directory moves or goes away.
+    QHash<QByteArray, QString> m_handlePaths;
+    QHash<int, QString> m_watchPaths;
+};
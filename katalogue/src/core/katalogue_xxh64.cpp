@@ -0,0 +1,130 @@
+#include "katalogue_xxh64.h"
+
+#include <cstring>
+
+namespace {
+constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t prime3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+std::uint64_t rotl(std::uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// xxHash is defined over little-endian reads.
+std::uint64_t read64(const unsigned char *p) {
+    std::uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+std::uint32_t read32(const unsigned char *p) {
+    return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8)
+           | (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+std::uint64_t round(std::uint64_t acc, std::uint64_t input) {
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t value) {
+    acc ^= round(0, value);
+    return acc * prime1 + prime4;
+}
+} // namespace
+
+Xxh64::Xxh64(std::uint64_t seed) {
+    reset(seed);
+}
+
+void Xxh64::reset(std::uint64_t seed) {
+    m_seed = seed;
+    m_totalLength = 0;
+    m_bufferSize = 0;
+    m_v[0] = seed + prime1 + prime2;
+    m_v[1] = seed + prime2;
+    m_v[2] = seed;
+    m_v[3] = seed - prime1;
+}
+
+void Xxh64::update(const void *data, std::size_t length) {
+    const auto *p = static_cast<const unsigned char *>(data);
+    const unsigned char *const end = p + length;
+    m_totalLength += length;
+
+    if (m_bufferSize + length < sizeof(m_buffer)) {
+        std::memcpy(m_buffer + m_bufferSize, p, length);
+        m_bufferSize += length;
+        return;
+    }
+
+    if (m_bufferSize > 0) {
+        const std::size_t fill = sizeof(m_buffer) - m_bufferSize;
+        std::memcpy(m_buffer + m_bufferSize, p, fill);
+        p += fill;
+        for (int i = 0; i < 4; ++i) {
+            m_v[i] = round(m_v[i], read64(m_buffer + i * 8));
+        }
+        m_bufferSize = 0;
+    }
+
+    while (end - p >= 32) {
+        for (int i = 0; i < 4; ++i) {
+            m_v[i] = round(m_v[i], read64(p + i * 8));
+        }
+        p += 32;
+    }
+
+    m_bufferSize = static_cast<std::size_t>(end - p);
+    std::memcpy(m_buffer, p, m_bufferSize);
+}
+
+std::uint64_t Xxh64::digest() const {
+    std::uint64_t h;
+    if (m_totalLength >= 32) {
+        h = rotl(m_v[0], 1) + rotl(m_v[1], 7) + rotl(m_v[2], 12) + rotl(m_v[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            h = mergeRound(h, m_v[i]);
+        }
+    } else {
+        h = m_seed + prime5;
+    }
+    h += m_totalLength;
+
+    const unsigned char *p = m_buffer;
+    const unsigned char *const end = m_buffer + m_bufferSize;
+    while (end - p >= 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * prime1 + prime4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        h ^= static_cast<std::uint64_t>(read32(p)) * prime1;
+        h = rotl(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= static_cast<std::uint64_t>(*p) * prime5;
+        h = rotl(h, 11) * prime1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+std::uint64_t Xxh64::hash(const void *data, std::size_t length, std::uint64_t seed) {
+    Xxh64 state(seed);
+    state.update(data, length);
+    return state.digest();
+}
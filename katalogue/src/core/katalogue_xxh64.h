@@ -0,0 +1,25 @@
+#pragma once
+
+// Streaming XXH64 (xxHash, 64-bit variant) used for content hashes. Kept
+// dependency- and Qt-free; output matches the reference implementation.
+
+#include <cstddef>
+#include <cstdint>
+
+class Xxh64 {
+public:
+    explicit Xxh64(std::uint64_t seed = 0);
+
+    void reset(std::uint64_t seed = 0);
+    void update(const void *data, std::size_t length);
+    std::uint64_t digest() const;
+
+    static std::uint64_t hash(const void *data, std::size_t length, std::uint64_t seed = 0);
+
+private:
+    std::uint64_t m_totalLength = 0;
+    std::uint64_t m_v[4] = {};
+    unsigned char m_buffer[32] = {};
+    std::size_t m_bufferSize = 0;
+    std::uint64_t m_seed = 0;
+};
@@ -2,28 +2,168 @@
 
 #include <QDateTime>
 #include <QDir>
+#include <QDBusConnection>
 #include <QDBusError>
+#include <QDBusMessage>
 #include <QFileInfo>
+#include <QMutexLocker>
 #include <QStandardPaths>
 #include <QStorageInfo>
 
+#include "katalogue_device.h"
+
 namespace {
 QString defaultProjectPath() {
     const QString base = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     return QDir(base).filePath(QStringLiteral("catalog.kdcatalog"));
 }
+
+// Applies StartScanWithOptions() overrides; returns an error message for
+// values that cannot be used.
+QString applyScanOverrides(ScanOptions &options, const QVariantMap &overrides) {
+    for (auto it = overrides.constBegin(); it != overrides.constEnd(); ++it) {
+        bool ok = true;
+        if (it.key() == QLatin1String("io_priority")) {
+            const QString value = it.value().toString();
+            if (value == QLatin1String("idle")) {
+                options.ioPriority = IoPriorityClass::Idle;
+            } else if (value == QLatin1String("best-effort")) {
+                options.ioPriority = IoPriorityClass::BestEffort;
+            } else if (value == QLatin1String("default")) {
+                options.ioPriority = IoPriorityClass::Default;
+            } else {
+                ok = false;
+            }
+        } else if (it.key() == QLatin1String("io_priority_level")) {
+            options.ioPriorityLevel = it.value().toInt(&ok);
+            ok = ok && options.ioPriorityLevel >= 0 && options.ioPriorityLevel <= 7;
+        } else if (it.key() == QLatin1String("nice")) {
+            options.niceness = it.value().toInt(&ok);
+            ok = ok && options.niceness >= -20 && options.niceness <= 19;
+        } else if (it.key() == QLatin1String("target_stat_latency_ms")) {
+            options.targetStatLatencyMs = it.value().toDouble(&ok);
+            ok = ok && options.targetStatLatencyMs >= 0;
+        } else if (it.key() == QLatin1String("max_stats_per_second")) {
+            options.maxStatsPerSecond = it.value().toDouble(&ok);
+            ok = ok && options.maxStatsPerSecond >= 0;
+        } else if (it.key() == QLatin1String("progress_interval_ms")) {
+            options.progressIntervalMs = it.value().toInt(&ok);
+            ok = ok && options.progressIntervalMs >= 0;
+        } else if (it.key() == QLatin1String("slow_directory_count")) {
+            options.slowDirectoryCount = it.value().toInt(&ok);
+            ok = ok && options.slowDirectoryCount >= 0;
+        } else if (it.key() == QLatin1String("one_file_system")) {
+            ok = it.value().canConvert<bool>();
+            options.oneFileSystem = it.value().toBool();
+        } else {
+            return QStringLiteral("Unknown scan option: %1").arg(it.key());
+        }
+        if (!ok) {
+            return QStringLiteral("Invalid value for scan option %1").arg(it.key());
+        }
+    }
+    return {};
+}
+
+QVariantMap progressDetails(const ScanOptions &options, const ScanStats &stats) {
+    QVariantMap details;
+    if (options.targetStatLatencyMs > 0 || options.maxStatsPerSecond > 0) {
+        details.insert(QStringLiteral("stats_per_second"), stats.statsPerSecond);
+        details.insert(QStringLiteral("stat_rate_limit"), stats.statRateLimit);
+        details.insert(QStringLiteral("stat_latency_ms"), stats.statLatencyMs);
+        details.insert(QStringLiteral("throttled"), stats.statRateLimit > 0);
+    }
+    details.insert(QStringLiteral("elapsed_ms"), stats.elapsedMs);
+    details.insert(QStringLiteral("files_per_second"), stats.filesPerSecond);
+    details.insert(QStringLiteral("bytes_per_second"), stats.bytesPerSecond);
+    if (stats.fractionDone >= 0) {
+        details.insert(QStringLiteral("fraction_done"), stats.fractionDone);
+    }
+    if (stats.etaSeconds >= 0) {
+        details.insert(QStringLiteral("eta_seconds"), stats.etaSeconds);
+    }
+    return details;
+}
+
+QVariantList directoryTimings(const QList<DirectoryTiming> &timings) {
+    QVariantList list;
+    for (const DirectoryTiming &timing : timings) {
+        QVariantMap entry;
+        entry.insert(QStringLiteral("path"), timing.path);
+        entry.insert(QStringLiteral("wall_ms"), static_cast<double>(timing.wallNs) / 1e6);
+        entry.insert(QStringLiteral("entries"), timing.entries);
+        list.append(entry);
+    }
+    return list;
+}
+
+QVariantMap phaseDetails(const ScanPhaseStats &phases) {
+    QVariantMap details;
+    details.insert(QStringLiteral("read_ms"), static_cast<double>(phases.readNs) / 1e6);
+    details.insert(QStringLiteral("stat_ms"), static_cast<double>(phases.statNs) / 1e6);
+    details.insert(QStringLiteral("throttle_ms"), static_cast<double>(phases.throttleNs) / 1e6);
+    details.insert(QStringLiteral("sniff_ms"), static_cast<double>(phases.sniffNs) / 1e6);
+    details.insert(QStringLiteral("write_ms"), static_cast<double>(phases.writeNs) / 1e6);
+    details.insert(QStringLiteral("index_ms"), static_cast<double>(phases.indexNs) / 1e6);
+    details.insert(QStringLiteral("directories_read"), phases.directoriesRead);
+    details.insert(QStringLiteral("stats"), phases.stats);
+    details.insert(QStringLiteral("sniffs"), phases.sniffs);
+    details.insert(QStringLiteral("commits"), phases.commits);
+    return details;
+}
 } // namespace
 
 KatalogueDaemon::KatalogueDaemon(QObject *parent)
     : QObject(parent) {
     m_projectPath = defaultProjectPath();
-    m_scanThread.setObjectName(QStringLiteral("katalogue-scan-thread"));
+    m_maintenanceThread.setObjectName(QStringLiteral("katalogue-maintenance"));
+    // Reader threads (and with them their catalog connections) are kept for
+    // the daemon's lifetime instead of expiring between calls.
+    m_readerPool.setMaxThreadCount(qMax(1, m_settings.databaseReaderThreads()));
+    m_readerPool.setExpiryTimeout(-1);
+}
+
+template<typename Result>
+Result KatalogueDaemon::answerOnReader(std::function<Result()> query) const {
+    if (!calledFromDBus()) {
+        return query();
+    }
+    setDelayedReply(true);
+    m_readerPool.start([request = message(), bus = connection(), query = std::move(query)]() {
+        bus.send(request.createReply(QVariant::fromValue(query())));
+    });
+    return Result();
 }
 
 KatalogueDaemon::~KatalogueDaemon() {
-    if (m_scanThread.isRunning()) {
-        m_scanThread.quit();
-        m_scanThread.wait();
+    {
+        QMutexLocker locker(&m_jobsMutex);
+        for (auto &job : m_jobs) {
+            if (job.status == ScanJob::Status::Pending || job.status == ScanJob::Status::Running) {
+                job.status = ScanJob::Status::Cancelled;
+                job.scanner->requestCancel();
+            }
+        }
+    }
+    QHash<int, std::shared_ptr<VolumeWatch>> watches;
+    {
+        QMutexLocker locker(&m_watchesMutex);
+        watches.swap(m_watches);
+    }
+    for (const auto &watch : std::as_const(watches)) {
+        watch->stop.store(true);
+        watch->scanner->requestCancel();
+        watch->thread->wait();
+        delete watch->thread;
+    }
+    for (QThread *lane : std::as_const(m_scanLanes)) {
+        lane->quit();
+        lane->wait();
+        delete lane;
+    }
+    if (m_maintenanceThread.isRunning()) {
+        m_maintenanceThread.quit();
+        m_maintenanceThread.wait();
     }
 }
 
@@ -33,10 +173,14 @@ bool KatalogueDaemon::init() {
         return false;
     }
     QDir().mkpath(QFileInfo(m_projectPath).absolutePath());
+    const bool created = !QFileInfo::exists(m_projectPath);
     if (!m_db.openProject(m_projectPath)) {
         qCritical() << tr("Failed to open default project:") << m_db.lastErrorString();
         return false;
     }
+    if (created && m_settings.databaseSubstringIndex() && !m_db.setSubstringIndex(true)) {
+        qWarning() << "New catalog has no substring index";
+    }
     if (m_db.checkSchema() != KatalogueDatabase::SchemaStatus::Ok) {
         qCritical() << tr("Catalog schema problem:") << m_db.lastErrorString();
         return false;
@@ -57,6 +201,7 @@ QVariantMap KatalogueDaemon::OpenProject(const QString &path) {
         info.insert(QStringLiteral("volumeCount"), 0);
         info.insert(QStringLiteral("fileCount"), 0);
         info.insert(QStringLiteral("totalBytes"), static_cast<qint64>(0));
+        info.insert(QStringLiteral("uniqueBytes"), static_cast<qint64>(0));
         return info;
     }
 
@@ -64,9 +209,16 @@ QVariantMap KatalogueDaemon::OpenProject(const QString &path) {
     QDir().mkpath(fileInfo.absolutePath());
     const QString absPath = fileInfo.absoluteFilePath();
 
+    // Queries still running on the old catalog finish first; reopening
+    // drops their connections.
+    m_readerPool.waitForDone();
+    const bool created = !fileInfo.exists();
     const bool ok = m_db.openProject(absPath);
     if (ok) {
         m_projectPath = absPath;
+        if (created && m_settings.databaseSubstringIndex() && !m_db.setSubstringIndex(true)) {
+            qWarning() << "New catalog has no substring index";
+        }
     } else if (calledFromDBus()) {
         sendErrorReply(QDBusError::Failed,
                        tr("Failed to open catalog: %1").arg(m_db.lastErrorString()));
@@ -80,10 +232,12 @@ QVariantMap KatalogueDaemon::OpenProject(const QString &path) {
         info.insert(QStringLiteral("volumeCount"), stats->volumeCount);
         info.insert(QStringLiteral("fileCount"), static_cast<qint64>(stats->fileCount));
         info.insert(QStringLiteral("totalBytes"), static_cast<qint64>(stats->totalBytes));
+        info.insert(QStringLiteral("uniqueBytes"), static_cast<qint64>(stats->uniqueBytes));
     } else {
         info.insert(QStringLiteral("volumeCount"), 0);
         info.insert(QStringLiteral("fileCount"), static_cast<qint64>(0));
         info.insert(QStringLiteral("totalBytes"), static_cast<qint64>(0));
+        info.insert(QStringLiteral("uniqueBytes"), static_cast<qint64>(0));
     }
 
     return info;
@@ -97,27 +251,51 @@ QVariantMap KatalogueDaemon::GetProjectInfo() const {
         info.insert(QStringLiteral("volumeCount"), 0);
         info.insert(QStringLiteral("fileCount"), static_cast<qint64>(0));
         info.insert(QStringLiteral("totalBytes"), static_cast<qint64>(0));
+        info.insert(QStringLiteral("uniqueBytes"), static_cast<qint64>(0));
         return info;
     }
 
     info.insert(QStringLiteral("ok"), true);
     info.insert(QStringLiteral("path"), m_projectPath);
 
-    const auto stats = m_db.projectStats();
-    if (stats.has_value()) {
-        info.insert(QStringLiteral("volumeCount"), stats->volumeCount);
-        info.insert(QStringLiteral("fileCount"), static_cast<qint64>(stats->fileCount));
-        info.insert(QStringLiteral("totalBytes"), static_cast<qint64>(stats->totalBytes));
-    } else {
-        info.insert(QStringLiteral("volumeCount"), 0);
-        info.insert(QStringLiteral("fileCount"), static_cast<qint64>(0));
-        info.insert(QStringLiteral("totalBytes"), static_cast<qint64>(0));
-    }
-
-    return info;
+    return answerOnReader<QVariantMap>([this, info]() mutable {
+        const auto stats = m_db.projectStats();
+        if (stats.has_value()) {
+            info.insert(QStringLiteral("volumeCount"), stats->volumeCount);
+            info.insert(QStringLiteral("fileCount"), static_cast<qint64>(stats->fileCount));
+            info.insert(QStringLiteral("totalBytes"), static_cast<qint64>(stats->totalBytes));
+            info.insert(QStringLiteral("uniqueBytes"), static_cast<qint64>(stats->uniqueBytes));
+        } else {
+            info.insert(QStringLiteral("volumeCount"), 0);
+            info.insert(QStringLiteral("fileCount"), static_cast<qint64>(0));
+            info.insert(QStringLiteral("totalBytes"), static_cast<qint64>(0));
+            info.insert(QStringLiteral("uniqueBytes"), static_cast<qint64>(0));
+        }
+        QVariantList staleVolumes;
+        for (const int volumeId : m_db.staleSearchIndexVolumes()) {
+            staleVolumes.append(volumeId);
+        }
+        info.insert(QStringLiteral("stale_index_volumes"), staleVolumes);
+        info.insert(QStringLiteral("substring_index"), m_db.hasSubstringIndex());
+        info.insert(QStringLiteral("reclaimable_bytes"), m_db.reclaimableBytes());
+        return info;
+    });
 }
 
 uint KatalogueDaemon::StartScan(const QString &rootPath) {
+    return StartScanWithOptions(rootPath, {});
+}
+
+uint KatalogueDaemon::StartScanWithOptions(const QString &rootPath, const QVariantMap &options) {
+    ScanOptions scanOptions = scanOptionsFromSettings();
+    const QString optionsError = applyScanOverrides(scanOptions, options);
+    if (!optionsError.isEmpty()) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::InvalidArgs, optionsError);
+        }
+        return 0;
+    }
+
     if (!m_db.isOpen()) {
         if (!m_db.openProject(m_projectPath.isEmpty() ? defaultProjectPath()
                                                       : m_projectPath)) {
@@ -168,45 +346,137 @@ uint KatalogueDaemon::StartScan(const QString &rootPath) {
     ScanJob job;
     job.id = m_nextScanId++;
     job.rootPath = rootPath;
+    job.projectPath = m_projectPath;
+    job.deviceKey = deviceKeyForPath(rootPath);
+    job.scanner = std::make_shared<KatalogueScanner>();
     job.status = ScanJob::Status::Pending;
     job.volumeInfo = info;
-    job.options.includeHidden = m_settings.scannerIncludeHidden();
-    job.options.followSymlinks = m_settings.scannerFollowSymlinks();
-    job.options.computeHashes = m_settings.scannerComputeHashes();
-    job.options.maxDepth = m_settings.scannerMaxDepth();
-    job.options.excludePatterns = m_settings.scannerExcludePatterns();
+    job.options = scanOptions;
     job.existingVolume = existingVolume;
-    m_jobs.insert(job.id, job);
+    job.options.incremental = existingVolume && m_settings.scannerIncrementalRescan();
+    job.options.quickRescan = existingVolume && m_settings.scannerQuickRescan();
+    // A scan of this volume that was interrupted (paused, cancelled, daemon
+    // restart) picks up from its checkpoint.
+    if (existingVolume) {
+        const auto checkpoint = m_db.scanCheckpoint(info.id);
+        job.resume = checkpoint.has_value() && checkpoint->rootPath == rootInfo.absoluteFilePath();
+    }
+    {
+        QMutexLocker locker(&m_jobsMutex);
+        m_jobs.insert(job.id, job);
+    }
 
-    auto *worker = new QObject();
-    worker->moveToThread(&m_scanThread);
+    runOnThread(scanLane(job.deviceKey), [this, jobId = job.id]() {
+        runScan(jobId);
+    });
+    return job.id;
+}
 
-    if (!m_scanThread.isRunning()) {
-        m_scanThread.start();
+bool KatalogueDaemon::ResolveHashCollisions() {
+    if (!m_db.isOpen()) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::Failed, tr("Database is not open"));
+        }
+        return false;
     }
+    runOnThread(&m_maintenanceThread, [this, projectPath = m_projectPath, options = scanOptionsFromSettings()]() {
+        resolveHashCollisions(projectPath, options);
+    });
+    return true;
+}
 
-    QMetaObject::invokeMethod(worker, [this, jobId = job.id]() {
-        runScan(jobId);
-    }, Qt::QueuedConnection);
+bool KatalogueDaemon::SetSubstringIndex(bool enabled) {
+    if (!m_db.isOpen()) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::Failed, tr("Database is not open"));
+        }
+        return false;
+    }
+    runOnThread(&m_maintenanceThread, [this, projectPath = m_projectPath, enabled]() {
+        setSubstringIndex(projectPath, enabled);
+    });
+    return true;
+}
 
-    connect(&m_scanThread, &QThread::finished, worker, &QObject::deleteLater);
-    return job.id;
+bool KatalogueDaemon::CompactCatalog() {
+    if (!m_db.isOpen()) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::Failed, tr("Database is not open"));
+        }
+        return false;
+    }
+    runOnThread(&m_maintenanceThread, [this, projectPath = m_projectPath]() {
+        compactCatalog(projectPath);
+    });
+    return true;
 }
 
 bool KatalogueDaemon::CancelScan(uint scanId) {
-    if (!m_jobs.contains(scanId)) {
+    QMutexLocker locker(&m_jobsMutex);
+    auto it = m_jobs.find(scanId);
+    if (it == m_jobs.end()) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::Failed, tr("Scan ID not found"));
+        }
+        return false;
+    }
+    it->scanner->requestCancel();
+    it->status = ScanJob::Status::Cancelled;
+    return true;
+}
+
+bool KatalogueDaemon::PauseScan(uint scanId) {
+    QMutexLocker locker(&m_jobsMutex);
+    auto it = m_jobs.find(scanId);
+    if (it == m_jobs.end()) {
         if (calledFromDBus()) {
             sendErrorReply(QDBusError::Failed, tr("Scan ID not found"));
         }
         return false;
     }
-    m_scanner.requestCancel();
-    m_jobs[scanId].status = ScanJob::Status::Cancelled;
+    if (it->status != ScanJob::Status::Running && it->status != ScanJob::Status::Pending) {
+        return false;
+    }
+    if (it->status == ScanJob::Status::Running) {
+        it->scanner->requestCancel();
+    }
+    it->status = ScanJob::Status::Paused;
+    return true;
+}
+
+bool KatalogueDaemon::ResumeScan(uint scanId) {
+    QMutexLocker locker(&m_jobsMutex);
+    auto it = m_jobs.find(scanId);
+    if (it == m_jobs.end()) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::Failed, tr("Scan ID not found"));
+        }
+        return false;
+    }
+    if (it->status != ScanJob::Status::Paused && it->status != ScanJob::Status::Cancelled
+        && it->status != ScanJob::Status::Failed) {
+        return false;
+    }
+    // Jobs paused before they ever ran have no checkpoint and simply start.
+    it->resume = it->volumeInfo.id >= 0 && m_db.scanCheckpoint(it->volumeInfo.id).has_value();
+    if (!it->resume && it->status != ScanJob::Status::Paused) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::Failed, tr("Scan has no checkpoint to resume from"));
+        }
+        return false;
+    }
+    it->status = ScanJob::Status::Pending;
+    it->errorString.clear();
+
+    runOnThread(scanLane(it->deviceKey), [this, scanId]() {
+        runScan(scanId);
+    });
     return true;
 }
 
 QVariantMap KatalogueDaemon::GetScanStatus(uint scanId) const {
     QVariantMap result;
+    QMutexLocker locker(&m_jobsMutex);
     const auto it = m_jobs.constFind(scanId);
     if (it == m_jobs.constEnd()) {
         result.insert(QStringLiteral("status"), QStringLiteral("unknown"));
@@ -219,122 +489,162 @@ QVariantMap KatalogueDaemon::GetScanStatus(uint scanId) const {
     if (!job.errorString.isEmpty()) {
         result.insert(QStringLiteral("error"), job.errorString);
     }
+    result.insert(QStringLiteral("device"), job.deviceKey);
     result.insert(QStringLiteral("directories"), job.stats.directories);
     result.insert(QStringLiteral("files"), job.stats.files);
     result.insert(QStringLiteral("bytes"), static_cast<qint64>(job.stats.totalBytes));
+    result.insert(QStringLiteral("unique_bytes"), static_cast<qint64>(job.stats.uniqueBytes));
+    if (job.options.incremental || job.options.quickRescan) {
+        result.insert(QStringLiteral("added"), job.stats.added);
+        result.insert(QStringLiteral("updated"), job.stats.updated);
+        result.insert(QStringLiteral("removed"), job.stats.removed);
+    }
+    if (job.options.computeHashes) {
+        result.insert(QStringLiteral("hashed_files"), job.stats.hashedFiles);
+        result.insert(QStringLiteral("hashed_bytes"), job.stats.hashedBytes);
+    }
+    result.insert(progressDetails(job.options, job.stats));
+    result.insert(QStringLiteral("phases"), phaseDetails(job.stats.phases));
+    if (job.options.slowDirectoryCount > 0) {
+        result.insert(QStringLiteral("slowest_directories"), directoryTimings(job.stats.slowestDirectories));
+        result.insert(QStringLiteral("largest_directories"), directoryTimings(job.stats.largestDirectories));
+    }
+    if (!job.stats.skippedMounts.isEmpty()) {
+        result.insert(QStringLiteral("skipped_mounts"), job.stats.skippedMounts);
+    }
+    if (!job.reportPath.isEmpty()) {
+        result.insert(QStringLiteral("report_path"), job.reportPath);
+    }
     return result;
 }
 
 QVariantMap KatalogueDaemon::ListVolumes() const {
-    QVariantMap payload;
     if (!m_db.isOpen()) {
         if (calledFromDBus()) {
             sendErrorReply(QDBusError::Failed, tr("Database is not open"));
         }
+        QVariantMap payload;
         payload.insert(QStringLiteral("items"), QVariantList());
         return payload;
     }
-    const auto volumes = m_db.listVolumes();
-    QVariantList list;
-    list.reserve(volumes.size());
-    for (const auto &volume : volumes) {
-        QVariantMap entry;
-        entry.insert(QStringLiteral("id"), volume.id);
-        entry.insert(QStringLiteral("label"), volume.label);
-        entry.insert(QStringLiteral("description"), volume.description);
-        entry.insert(QStringLiteral("fs_uuid"), volume.fsUuid);
-        entry.insert(QStringLiteral("fs_type"), volume.fsType);
-        entry.insert(QStringLiteral("physical_hint"), volume.physicalHint);
-        entry.insert(QStringLiteral("total_size"), static_cast<qint64>(volume.totalSize));
-        entry.insert(QStringLiteral("created_at"), volume.createdAt.toSecsSinceEpoch());
-        entry.insert(QStringLiteral("updated_at"), volume.updatedAt.toSecsSinceEpoch());
-        list.append(entry);
-    }
-    payload.insert(QStringLiteral("items"), list);
-    return payload;
+    return answerOnReader<QVariantMap>([this]() {
+        const auto volumes = m_db.listVolumes();
+        QVariantList list;
+        list.reserve(volumes.size());
+        for (const auto &volume : volumes) {
+            QVariantMap entry;
+            entry.insert(QStringLiteral("id"), volume.id);
+            entry.insert(QStringLiteral("label"), volume.label);
+            entry.insert(QStringLiteral("description"), volume.description);
+            entry.insert(QStringLiteral("fs_uuid"), volume.fsUuid);
+            entry.insert(QStringLiteral("fs_type"), volume.fsType);
+            entry.insert(QStringLiteral("physical_hint"), volume.physicalHint);
+            entry.insert(QStringLiteral("root_path"), volume.rootPath);
+            entry.insert(QStringLiteral("total_size"), static_cast<qint64>(volume.totalSize));
+            entry.insert(QStringLiteral("created_at"), volume.createdAt.toSecsSinceEpoch());
+            entry.insert(QStringLiteral("updated_at"), volume.updatedAt.toSecsSinceEpoch());
+            list.append(entry);
+        }
+        QVariantMap payload;
+        payload.insert(QStringLiteral("items"), list);
+        return payload;
+    });
 }
 
 QList<QVariantMap> KatalogueDaemon::ListDirectories(int volumeId, int parentId) const {
-    QList<QVariantMap> entries;
     if (!m_db.isOpen()) {
         if (calledFromDBus()) {
             sendErrorReply(QDBusError::Failed, tr("Database is not open"));
         }
-        return entries;
-    }
-    const auto directories = m_db.listDirectories(volumeId, parentId);
-    entries.reserve(directories.size());
-    for (const auto &dir : directories) {
-        QVariantMap entry;
-        entry.insert(QStringLiteral("id"), dir.id);
-        entry.insert(QStringLiteral("volume_id"), dir.volumeId);
-        entry.insert(QStringLiteral("parent_id"), dir.parentId);
-        entry.insert(QStringLiteral("name"), dir.name);
-        entry.insert(QStringLiteral("full_path"), dir.fullPath);
-        entries.append(entry);
+        return {};
     }
-    return entries;
+    return answerOnReader<QList<QVariantMap>>([this, volumeId, parentId]() {
+        QList<QVariantMap> entries;
+        const auto directories = m_db.listDirectories(volumeId, parentId);
+        entries.reserve(directories.size());
+        for (const auto &dir : directories) {
+            QVariantMap entry;
+            entry.insert(QStringLiteral("id"), dir.id);
+            entry.insert(QStringLiteral("volume_id"), dir.volumeId);
+            entry.insert(QStringLiteral("parent_id"), dir.parentId);
+            entry.insert(QStringLiteral("name"), dir.name);
+            entry.insert(QStringLiteral("full_path"), dir.fullPath);
+            entries.append(entry);
+        }
+        return entries;
+    });
 }
 
 QList<QVariantMap> KatalogueDaemon::ListFiles(int directoryId) const {
-    QList<QVariantMap> entries;
     if (!m_db.isOpen()) {
         if (calledFromDBus()) {
             sendErrorReply(QDBusError::Failed, tr("Database is not open"));
         }
-        return entries;
+        return {};
     }
-    const auto files = m_db.listFilesInDirectory(directoryId);
-    QString volumeLabel;
-    const auto directory = m_db.getDirectory(directoryId);
-    if (directory.has_value()) {
-        const auto label = m_db.getVolumeLabel(directory->volumeId);
-        if (label.has_value()) {
-            volumeLabel = label.value();
+    return answerOnReader<QList<QVariantMap>>([this, directoryId]() {
+        QList<QVariantMap> entries;
+        const auto files = m_db.listFilesInDirectory(directoryId);
+        QString volumeLabel;
+        const auto directory = m_db.getDirectory(directoryId);
+        if (directory.has_value()) {
+            const auto label = m_db.getVolumeLabel(directory->volumeId);
+            if (label.has_value()) {
+                volumeLabel = label.value();
+            }
         }
-    }
-    entries.reserve(files.size());
-    for (const auto &file : files) {
-        QVariantMap entry;
-        entry.insert(QStringLiteral("id"), file.id);
-        entry.insert(QStringLiteral("directory_id"), file.directoryId);
-        entry.insert(QStringLiteral("name"), file.name);
-        entry.insert(QStringLiteral("full_path"), file.fullPath);
-        entry.insert(QStringLiteral("size"), static_cast<qint64>(file.size));
-        entry.insert(QStringLiteral("mtime"), file.mtime.isValid()
-                                              ? file.mtime.toString(Qt::ISODate)
-                                              : QString());
-        entry.insert(QStringLiteral("file_type"), file.fileType);
-        entry.insert(QStringLiteral("volume_label"), volumeLabel);
-        entries.append(entry);
-    }
-    return entries;
+        entries.reserve(files.size());
+        for (const auto &file : files) {
+            QVariantMap entry;
+            entry.insert(QStringLiteral("id"), file.id);
+            entry.insert(QStringLiteral("directory_id"), file.directoryId);
+            entry.insert(QStringLiteral("name"), file.name);
+            entry.insert(QStringLiteral("full_path"), file.fullPath);
+            entry.insert(QStringLiteral("size"), static_cast<qint64>(file.size));
+            entry.insert(QStringLiteral("mtime"), file.mtime.isValid()
+                                                  ? file.mtime.toString(Qt::ISODate)
+                                                  : QString());
+            entry.insert(QStringLiteral("file_type"), file.fileType);
+            entry.insert(QStringLiteral("volume_label"), volumeLabel);
+            entries.append(entry);
+        }
+        return entries;
+    });
 }
 
 QVariantMap KatalogueDaemon::SearchByName(const QString &query, int limit, int offset) const {
-    QVariantMap payload;
     if (!m_db.isOpen()) {
         if (calledFromDBus()) {
             sendErrorReply(QDBusError::Failed, tr("Database is not open"));
         }
+        QVariantMap payload;
         payload.insert(QStringLiteral("items"), QVariantList());
         return payload;
     }
-    const auto results = m_db.searchByName(query, limit, offset);
-    QVariantList list;
-    list.reserve(results.size());
-    for (const auto &result : results) {
-        QVariantMap entry;
-        entry.insert(QStringLiteral("file_id"), result.fileId);
-        entry.insert(QStringLiteral("file_name"), result.fileName);
-        entry.insert(QStringLiteral("full_path"), result.fullPath);
-        entry.insert(QStringLiteral("volume_label"), result.volumeLabel);
-        entry.insert(QStringLiteral("size"), static_cast<qint64>(result.size));
-        entry.insert(QStringLiteral("mtime"), result.mtime.toSecsSinceEpoch());
-        list.append(entry);
-    }
-    payload.insert(QStringLiteral("items"), list);
-    return payload;
+    return answerOnReader<QVariantMap>([this, query, limit, offset]() {
+        const auto results = m_db.searchByName(query, limit, offset);
+        QVariantList list;
+        list.reserve(results.size());
+        for (const auto &result : results) {
+            QVariantMap entry;
+            entry.insert(QStringLiteral("file_id"), result.fileId);
+            entry.insert(QStringLiteral("file_name"), result.fileName);
+            entry.insert(QStringLiteral("full_path"), result.fullPath);
+            entry.insert(QStringLiteral("volume_label"), result.volumeLabel);
+            entry.insert(QStringLiteral("size"), static_cast<qint64>(result.size));
+            entry.insert(QStringLiteral("mtime"), result.mtime.toSecsSinceEpoch());
+            list.append(entry);
+        }
+        QVariantMap payload;
+        payload.insert(QStringLiteral("items"), list);
+        // Volumes still being bulk-loaded are missing from the results.
+        QVariantList staleVolumes;
+        for (const int volumeId : m_db.staleSearchIndexVolumes()) {
+            staleVolumes.append(volumeId);
+        }
+        payload.insert(QStringLiteral("stale_index_volumes"), staleVolumes);
+        return payload;
+    });
 }
 
 QList<QVariantMap> KatalogueDaemon::Search(const QString &query,
@@ -342,12 +652,11 @@ QList<QVariantMap> KatalogueDaemon::Search(const QString &query,
                                            const QString &fileType,
                                            int limit,
                                            int offset) const {
-    QList<QVariantMap> entries;
     if (!m_db.isOpen()) {
         if (calledFromDBus()) {
             sendErrorReply(QDBusError::Failed, tr("Database is not open"));
         }
-        return entries;
+        return {};
     }
     KatalogueDatabase::SearchFilters filters;
     if (volumeId >= 0) {
@@ -357,24 +666,27 @@ QList<QVariantMap> KatalogueDaemon::Search(const QString &query,
         filters.fileType = fileType.toLower();
     }
 
-    const auto results = m_db.search(query, filters, limit, offset);
-    entries.reserve(results.size());
-    for (const auto &result : results) {
-        QVariantMap entry;
-        entry.insert(QStringLiteral("fileId"), result.fileId);
-        entry.insert(QStringLiteral("directoryId"), result.directoryId);
-        entry.insert(QStringLiteral("volumeId"), result.volumeId);
-        entry.insert(QStringLiteral("fileName"), result.fileName);
-        entry.insert(QStringLiteral("fullPath"), result.fullPath);
-        entry.insert(QStringLiteral("volumeLabel"), result.volumeLabel);
-        entry.insert(QStringLiteral("fileType"), result.fileType);
-        entry.insert(QStringLiteral("size"), static_cast<qint64>(result.size));
-        entry.insert(QStringLiteral("mtime"), result.mtime.isValid()
-                                             ? result.mtime.toString(Qt::ISODate)
-                                             : QString());
-        entries.append(entry);
-    }
-    return entries;
+    return answerOnReader<QList<QVariantMap>>([this, query, filters, limit, offset]() {
+        QList<QVariantMap> entries;
+        const auto results = m_db.search(query, filters, limit, offset);
+        entries.reserve(results.size());
+        for (const auto &result : results) {
+            QVariantMap entry;
+            entry.insert(QStringLiteral("fileId"), result.fileId);
+            entry.insert(QStringLiteral("directoryId"), result.directoryId);
+            entry.insert(QStringLiteral("volumeId"), result.volumeId);
+            entry.insert(QStringLiteral("fileName"), result.fileName);
+            entry.insert(QStringLiteral("fullPath"), result.fullPath);
+            entry.insert(QStringLiteral("volumeLabel"), result.volumeLabel);
+            entry.insert(QStringLiteral("fileType"), result.fileType);
+            entry.insert(QStringLiteral("size"), static_cast<qint64>(result.size));
+            entry.insert(QStringLiteral("mtime"), result.mtime.isValid()
+                                                 ? result.mtime.toString(Qt::ISODate)
+                                                 : QString());
+            entries.append(entry);
+        }
+        return entries;
+    });
 }
 
 QString KatalogueDaemon::GetFileNote(int fileId) const {
@@ -384,8 +696,9 @@ QString KatalogueDaemon::GetFileNote(int fileId) const {
         }
         return {};
     }
-    const auto note = m_db.getNoteForFile(fileId);
-    return note.value_or(QString());
+    return answerOnReader<QString>([this, fileId]() {
+        return m_db.getNoteForFile(fileId).value_or(QString());
+    });
 }
 
 void KatalogueDaemon::SetFileNote(int fileId, const QString &content) {
@@ -399,22 +712,24 @@ void KatalogueDaemon::SetFileNote(int fileId, const QString &content) {
 }
 
 QList<QVariantMap> KatalogueDaemon::GetFileTags(int fileId) const {
-    QList<QVariantMap> entries;
     if (!m_db.isOpen()) {
         if (calledFromDBus()) {
             sendErrorReply(QDBusError::Failed, tr("Database is not open"));
         }
-        return entries;
-    }
-    const auto tags = m_db.tagsForFile(fileId);
-    entries.reserve(tags.size());
-    for (const auto &tag : tags) {
-        QVariantMap entry;
-        entry.insert(QStringLiteral("key"), tag.first);
-        entry.insert(QStringLiteral("value"), tag.second);
-        entries.append(entry);
+        return {};
     }
-    return entries;
+    return answerOnReader<QList<QVariantMap>>([this, fileId]() {
+        QList<QVariantMap> entries;
+        const auto tags = m_db.tagsForFile(fileId);
+        entries.reserve(tags.size());
+        for (const auto &tag : tags) {
+            QVariantMap entry;
+            entry.insert(QStringLiteral("key"), tag.first);
+            entry.insert(QStringLiteral("value"), tag.second);
+            entries.append(entry);
+        }
+        return entries;
+    });
 }
 
 void KatalogueDaemon::AddFileTag(int fileId, const QString &key, const QString &value) {
@@ -438,23 +753,25 @@ void KatalogueDaemon::RemoveFileTag(int fileId, const QString &key, const QStrin
 }
 
 QList<QVariantMap> KatalogueDaemon::ListVirtualFolders(int parentId) const {
-    QList<QVariantMap> entries;
     if (!m_db.isOpen()) {
         if (calledFromDBus()) {
             sendErrorReply(QDBusError::Failed, tr("Database is not open"));
         }
-        return entries;
-    }
-    const auto folders = m_db.listVirtualFolders(parentId);
-    entries.reserve(folders.size());
-    for (const auto &folder : folders) {
-        QVariantMap entry;
-        entry.insert(QStringLiteral("id"), folder.id);
-        entry.insert(QStringLiteral("parentId"), folder.parentId);
-        entry.insert(QStringLiteral("name"), folder.name);
-        entries.append(entry);
+        return {};
     }
-    return entries;
+    return answerOnReader<QList<QVariantMap>>([this, parentId]() {
+        QList<QVariantMap> entries;
+        const auto folders = m_db.listVirtualFolders(parentId);
+        entries.reserve(folders.size());
+        for (const auto &folder : folders) {
+            QVariantMap entry;
+            entry.insert(QStringLiteral("id"), folder.id);
+            entry.insert(QStringLiteral("parentId"), folder.parentId);
+            entry.insert(QStringLiteral("name"), folder.name);
+            entries.append(entry);
+        }
+        return entries;
+    });
 }
 
 int KatalogueDaemon::CreateVirtualFolder(const QString &name, int parentId) {
@@ -488,31 +805,33 @@ void KatalogueDaemon::DeleteVirtualFolder(int folderId) {
 }
 
 QList<QVariantMap> KatalogueDaemon::ListVirtualFolderItems(int folderId) const {
-    QList<QVariantMap> entries;
     if (!m_db.isOpen()) {
         if (calledFromDBus()) {
             sendErrorReply(QDBusError::Failed, tr("Database is not open"));
         }
-        return entries;
+        return {};
     }
-    const auto items = m_db.listVirtualFolderItems(folderId);
-    entries.reserve(items.size());
-    for (const auto &item : items) {
-        QVariantMap entry;
-        entry.insert(QStringLiteral("fileId"), item.fileId);
-        entry.insert(QStringLiteral("directoryId"), item.directoryId);
-        entry.insert(QStringLiteral("volumeId"), item.volumeId);
-        entry.insert(QStringLiteral("fileName"), item.fileName);
-        entry.insert(QStringLiteral("fullPath"), item.fullPath);
-        entry.insert(QStringLiteral("volumeLabel"), item.volumeLabel);
-        entry.insert(QStringLiteral("fileType"), item.fileType);
-        entry.insert(QStringLiteral("size"), static_cast<qint64>(item.size));
-        entry.insert(QStringLiteral("mtime"), item.mtime.isValid()
-                                             ? item.mtime.toString(Qt::ISODate)
-                                             : QString());
-        entries.append(entry);
-    }
-    return entries;
+    return answerOnReader<QList<QVariantMap>>([this, folderId]() {
+        QList<QVariantMap> entries;
+        const auto items = m_db.listVirtualFolderItems(folderId);
+        entries.reserve(items.size());
+        for (const auto &item : items) {
+            QVariantMap entry;
+            entry.insert(QStringLiteral("fileId"), item.fileId);
+            entry.insert(QStringLiteral("directoryId"), item.directoryId);
+            entry.insert(QStringLiteral("volumeId"), item.volumeId);
+            entry.insert(QStringLiteral("fileName"), item.fileName);
+            entry.insert(QStringLiteral("fullPath"), item.fullPath);
+            entry.insert(QStringLiteral("volumeLabel"), item.volumeLabel);
+            entry.insert(QStringLiteral("fileType"), item.fileType);
+            entry.insert(QStringLiteral("size"), static_cast<qint64>(item.size));
+            entry.insert(QStringLiteral("mtime"), item.mtime.isValid()
+                                                 ? item.mtime.toString(Qt::ISODate)
+                                                 : QString());
+            entries.append(entry);
+        }
+        return entries;
+    });
 }
 
 void KatalogueDaemon::AddFileToVirtualFolder(int folderId, int fileId) {
@@ -545,51 +864,358 @@ void KatalogueDaemon::RenameVolume(int volumeId, const QString &newLabel) {
     m_db.renameVolume(volumeId, newLabel);
 }
 
-void KatalogueDaemon::runScan(uint scanId) {
-    auto it = m_jobs.find(scanId);
-    if (it == m_jobs.end()) {
+bool KatalogueDaemon::WatchVolume(int volumeId) {
+    if (!m_db.isOpen()) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::Failed, tr("Database is not open"));
+        }
+        return false;
+    }
+    QMutexLocker locker(&m_watchesMutex);
+    if (m_watches.contains(volumeId)) {
+        return true;
+    }
+    QString rootPath;
+    for (const VolumeInfo &volume : m_db.listVolumes()) {
+        if (volume.id == volumeId) {
+            rootPath = volume.rootPath;
+            break;
+        }
+    }
+    if (rootPath.isEmpty() || !QFileInfo(rootPath).isDir()) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::InvalidArgs, tr("Volume %1 is not mounted at its scanned path").arg(volumeId));
+        }
+        return false;
+    }
+
+    auto watch = std::make_shared<VolumeWatch>();
+    watch->volumeId = volumeId;
+    watch->rootPath = rootPath;
+    watch->projectPath = m_projectPath;
+    watch->options = scanOptionsFromSettings();
+    watch->settleMs = qMax(0, m_settings.watcherSettleMs());
+    watch->scanner = std::make_shared<KatalogueScanner>();
+    std::future<QString> started = watch->started.get_future();
+    watch->thread = QThread::create([this, watch]() { runWatch(watch); });
+    watch->thread->setObjectName(QStringLiteral("katalogue-watch-%1").arg(volumeId));
+    m_watches.insert(volumeId, watch);
+    watch->thread->start();
+    locker.unlock();
+
+    // The catalog connection and the watcher belong to the watch thread;
+    // wait for it to bring them up so a failure reaches the caller.
+    const QString error = started.get();
+    if (error.isEmpty()) {
+        return true;
+    }
+    // Unless UnwatchVolume() took the entry meanwhile, it is ours to drop.
+    locker.relock();
+    if (m_watches.value(volumeId) == watch) {
+        m_watches.remove(volumeId);
+        locker.unlock();
+        watch->thread->wait();
+        delete watch->thread;
+    }
+    if (calledFromDBus()) {
+        sendErrorReply(QDBusError::Failed, error);
+    }
+    return false;
+}
+
+bool KatalogueDaemon::UnwatchVolume(int volumeId) {
+    std::shared_ptr<VolumeWatch> watch;
+    {
+        QMutexLocker locker(&m_watchesMutex);
+        watch = m_watches.take(volumeId);
+    }
+    if (!watch) {
+        return false;
+    }
+    watch->stop.store(true);
+    watch->scanner->requestCancel();
+    watch->thread->wait();
+    delete watch->thread;
+    return true;
+}
+
+QList<QVariantMap> KatalogueDaemon::ListWatches() const {
+    QList<QVariantMap> result;
+    QMutexLocker locker(&m_watchesMutex);
+    for (const auto &watch : m_watches) {
+        QVariantMap entry;
+        entry.insert(QStringLiteral("volume_id"), watch->volumeId);
+        entry.insert(QStringLiteral("root_path"), watch->rootPath);
+        entry.insert(QStringLiteral("backend"), watch->backend == WatchBackend::Fanotify ? QStringLiteral("fanotify")
+                                                : watch->backend == WatchBackend::Inotify ? QStringLiteral("inotify")
+                                                                                          : QStringLiteral("none"));
+        entry.insert(QStringLiteral("changes"), watch->changes);
+        entry.insert(QStringLiteral("last_update"), watch->lastUpdate);
+        result.append(entry);
+    }
+    return result;
+}
+
+ScanOptions KatalogueDaemon::scanOptionsFromSettings() const {
+    ScanOptions options;
+    options.includeHidden = m_settings.scannerIncludeHidden();
+    options.followSymlinks = m_settings.scannerFollowSymlinks();
+    options.computeHashes = m_settings.scannerComputeHashes();
+    options.hashAlgorithm = m_settings.scannerHashAlgorithm() == QLatin1String("blake2b")
+                                ? HashAlgorithm::Blake2b
+                                : HashAlgorithm::Xxh64;
+    options.hashMode = m_settings.scannerHashMode() == QLatin1String("sampled")
+                           ? HashMode::Sampled
+                           : HashMode::Full;
+    const QString mimeDetection = m_settings.scannerMimeDetection();
+    options.mimeDetection = mimeDetection == QLatin1String("extension") ? MimeDetection::Extension
+                            : mimeDetection == QLatin1String("content") ? MimeDetection::Content
+                                                                        : MimeDetection::Auto;
+    const QString traversalOrder = m_settings.scannerTraversalOrder();
+    options.traversalOrder = traversalOrder == QLatin1String("directory") ? TraversalOrder::Directory
+                             : traversalOrder == QLatin1String("inode") ? TraversalOrder::Inode
+                             : traversalOrder == QLatin1String("physical") ? TraversalOrder::Physical
+                                                                           : TraversalOrder::Auto;
+    options.maxDepth = m_settings.scannerMaxDepth();
+    options.workerThreads = m_settings.scannerWorkerThreads();
+    options.ioUring = m_settings.scannerIoUring();
+    options.excludePatterns = m_settings.scannerExcludePatterns();
+    options.slowDirectoryCount = m_settings.scannerSlowDirectoryCount();
+    options.oneFileSystem = m_settings.scannerOneFileSystem();
+    options.skipFilesystemTypes = m_settings.scannerSkipFilesystemTypes();
+    return options;
+}
+
+void KatalogueDaemon::runOnThread(QThread *thread, std::function<void()> task) {
+    auto *worker = new QObject();
+    worker->moveToThread(thread);
+
+    if (!thread->isRunning()) {
+        thread->start();
+    }
+
+    QMetaObject::invokeMethod(worker, [task = std::move(task), worker]() {
+        task();
+        worker->deleteLater();
+    }, Qt::QueuedConnection);
+}
+
+// One thread per physical device: tasks queued on a lane run in order, so
+// scans of the same disk never compete for its heads while scans of
+// different disks proceed in parallel. Jobs whose device could not be
+// determined share one lane.
+QThread *KatalogueDaemon::scanLane(const QString &deviceKey) {
+    QThread *&lane = m_scanLanes[deviceKey];
+    if (!lane) {
+        lane = new QThread();
+        lane->setObjectName(deviceKey.isEmpty() ? QStringLiteral("katalogue-scan")
+                                                : QStringLiteral("katalogue-scan-%1").arg(deviceKey));
+    }
+    return lane;
+}
+
+void KatalogueDaemon::resolveHashCollisions(const QString &projectPath, const ScanOptions &options) {
+    // QSqlDatabase connections belong to the thread that opened them, so
+    // every background task works through its own.
+    KatalogueDatabase db;
+    KatalogueScanner scanner;
+    const int resolved = db.openProject(projectPath) ? scanner.resolveHashCollisions(db, options) : -1;
+    emit HashCollisionsResolved(qMax(0, resolved));
+}
+
+void KatalogueDaemon::setSubstringIndex(const QString &projectPath, bool enabled) {
+    KatalogueDatabase db;
+    if (!db.openProject(projectPath)) {
+        qWarning() << "Cannot open catalog for the substring index" << db.lastErrorString();
         return;
     }
+    if (!db.setSubstringIndex(enabled)) {
+        qWarning() << "Failed to change the substring index of" << projectPath;
+    }
+    emit SubstringIndexChanged(db.hasSubstringIndex());
+}
 
-    it->status = ScanJob::Status::Running;
-    it->errorString.clear();
-    emit ScanProgress(scanId, it->rootPath, it->stats.directories, it->stats.files, it->stats.totalBytes);
+void KatalogueDaemon::compactCatalog(const QString &projectPath) {
+    KatalogueDatabase db;
+    if (!db.openProject(projectPath)) {
+        qWarning() << "Cannot open catalog for compaction" << db.lastErrorString();
+        emit CatalogCompacted(-1);
+        return;
+    }
+    const qint64 reclaimable = db.reclaimableBytes();
+    emit CatalogCompacted(db.compact() ? qMax<qint64>(0, reclaimable) : -1);
+}
 
-    if (it->existingVolume) {
-        if (!m_db.clearVolumeContents(it->volumeInfo.id)) {
-            it->status = ScanJob::Status::Failed;
-            emit ScanFinished(scanId, statusToString(it->status));
+void KatalogueDaemon::runWatch(const std::shared_ptr<VolumeWatch> &watch) {
+    KatalogueDatabase db;
+    if (!db.openProject(watch->projectPath)) {
+        qWarning() << "Cannot open catalog for watching" << db.lastErrorString();
+        watch->started.set_value(tr("Cannot open catalog: %1").arg(db.lastErrorString()));
+        return;
+    }
+    FilesystemWatcher watcher(watch->rootPath);
+    if (!watcher.start()) {
+        qWarning() << "Cannot watch" << watch->rootPath << watcher.errorString();
+        watch->started.set_value(tr("Cannot watch %1: %2").arg(watch->rootPath, watcher.errorString()));
+        return;
+    }
+    {
+        QMutexLocker locker(&m_watchesMutex);
+        watch->backend = watcher.backend();
+    }
+    watch->started.set_value(QString());
+
+    const std::chrono::milliseconds settle(watch->settleMs);
+    WatchChanges changes;
+    while (watcher.collect(changes, settle, [&watch]() { return watch->stop.load(); })) {
+        const int written =
+            watch->scanner->applyChanges(watch->volumeId, watcher.rootPath(), changes, db, watch->options);
+        changes.clear();
+        if (written < 0) {
+            qWarning() << "Failed to apply changes below" << watch->rootPath;
+            continue;
+        }
+        {
+            QMutexLocker locker(&m_watchesMutex);
+            watch->changes += written;
+            watch->lastUpdate = QDateTime::currentSecsSinceEpoch();
+        }
+        if (written > 0) {
+            emit VolumeUpdated(watch->volumeId, written);
+        }
+    }
+}
+
+void KatalogueDaemon::writeScanReport(uint scanId) {
+    ScanStats stats;
+    {
+        QMutexLocker locker(&m_jobsMutex);
+        const auto it = m_jobs.constFind(scanId);
+        if (it == m_jobs.constEnd()) {
+            return;
+        }
+        stats = it->stats;
+    }
+    const QDir reports(QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+                           .filePath(QStringLiteral("scan-reports")));
+    QDir().mkpath(reports.path());
+    QFile file(reports.filePath(QStringLiteral("scan-%1-%2.json")
+                                    .arg(scanId)
+                                    .arg(QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyyMMdd-hhmmss")))));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(scanReportJson(stats)) < 0) {
+        qWarning() << "Failed to write scan report" << file.fileName();
+        return;
+    }
+    QMutexLocker locker(&m_jobsMutex);
+    const auto it = m_jobs.find(scanId);
+    if (it != m_jobs.end()) {
+        it->reportPath = file.fileName();
+    }
+}
+
+void KatalogueDaemon::runScan(uint scanId) {
+    ScanJob job;
+    {
+        QMutexLocker locker(&m_jobsMutex);
+        auto it = m_jobs.find(scanId);
+        if (it == m_jobs.end()) {
+            return;
+        }
+        // Paused or cancelled while still queued; ResumeScan() queues it again.
+        if (it->status == ScanJob::Status::Paused || it->status == ScanJob::Status::Cancelled) {
             return;
         }
+        // From here on CancelScan()/PauseScan() reach the scanner, even
+        // before scan() or resume() is entered.
+        it->scanner->resetCancel();
+        it->status = ScanJob::Status::Running;
+        it->errorString.clear();
+        job = *it;
     }
+    emit ScanProgress(scanId, job.rootPath, job.stats.directories, job.stats.files, job.stats.totalBytes);
+    emit ScanStatistics(scanId, progressDetails(job.options, job.stats));
 
-    const bool ok = m_scanner.scan(it->rootPath,
-                                   m_db,
-                                   it->volumeInfo,
-                                   it->options,
-                                   [this, scanId](const QString &path, const ScanStats &stats) {
-        auto jobIt = m_jobs.find(scanId);
-        if (jobIt == m_jobs.end()) {
-            return false;
+    // PauseScan()/CancelScan() only flag the job; the outcome is settled here.
+    auto finish = [this, scanId](ScanJob::Status status, QString errorString) {
+        {
+            QMutexLocker locker(&m_jobsMutex);
+            auto it = m_jobs.find(scanId);
+            if (it != m_jobs.end()) {
+                if (it->status == ScanJob::Status::Paused && status != ScanJob::Status::Finished) {
+                    status = ScanJob::Status::Paused;
+                    errorString = tr("Scan paused");
+                } else if (it->status == ScanJob::Status::Cancelled) {
+                    if (status != ScanJob::Status::Finished) {
+                        errorString = tr("Scan cancelled");
+                    }
+                    status = ScanJob::Status::Cancelled;
+                }
+                it->status = status;
+                it->errorString = errorString;
+            }
+        }
+        emit ScanFinished(scanId, statusToString(status));
+        return status;
+    };
+
+    KatalogueDatabase db;
+    if (!db.openProject(job.projectPath)) {
+        finish(ScanJob::Status::Failed, tr("Failed to open catalog: %1").arg(db.lastErrorString()));
+        return;
+    }
+
+    if (!job.resume && job.existingVolume && !job.options.incremental && !job.options.quickRescan) {
+        if (!db.clearVolumeContents(job.volumeInfo.id)) {
+            finish(ScanJob::Status::Failed, tr("Scan failed"));
+            return;
+        }
+    }
+
+    auto progress = [this, scanId](const QString &path, const ScanStats &stats) {
+        ScanOptions options;
+        {
+            QMutexLocker locker(&m_jobsMutex);
+            auto jobIt = m_jobs.find(scanId);
+            if (jobIt == m_jobs.end()) {
+                return false;
+            }
+            jobIt->stats = stats;
+            options = jobIt->options;
         }
-        jobIt->stats = stats;
         emit ScanProgress(scanId, path, stats.directories, stats.files, stats.totalBytes);
+        emit ScanStatistics(scanId, progressDetails(options, stats));
         return true;
-    });
+    };
+    KatalogueScanner &scanner = *job.scanner;
+    const bool ok = job.resume
+                        ? scanner.resume(job.volumeInfo.id, db, job.options, progress)
+                        : scanner.scan(job.rootPath, db, job.volumeInfo, job.options, progress);
+    if (scanner.lastVolumeId() >= 0) {
+        QMutexLocker locker(&m_jobsMutex);
+        auto it = m_jobs.find(scanId);
+        if (it != m_jobs.end()) {
+            it->volumeInfo.id = scanner.lastVolumeId();
+        }
+    }
 
+    ScanJob::Status status = ScanJob::Status::Finished;
+    QString errorString;
     if (!ok) {
-        if (m_scanner.isCancelRequested() || it->status == ScanJob::Status::Cancelled) {
-            it->status = ScanJob::Status::Cancelled;
-            it->errorString = tr("Scan cancelled");
-        } else {
-            it->status = ScanJob::Status::Failed;
-            it->errorString = tr("Scan failed");
-        }
-    } else if (it->status != ScanJob::Status::Cancelled) {
-        it->status = ScanJob::Status::Finished;
+        status = scanner.isCancelRequested() ? ScanJob::Status::Cancelled : ScanJob::Status::Failed;
+        errorString = scanner.isCancelRequested() ? tr("Scan cancelled") : tr("Scan failed");
     }
+    if (ok && job.options.slowDirectoryCount > 0) {
+        writeScanReport(scanId);
+    }
+    status = finish(status, errorString);
 
-    emit ScanFinished(scanId, statusToString(it->status));
+    // Sampled fingerprints only become useful once collisions are settled.
+    if (status == ScanJob::Status::Finished && job.options.computeHashes
+        && job.options.hashMode == HashMode::Sampled) {
+        runOnThread(&m_maintenanceThread, [this, projectPath = job.projectPath, options = job.options]() {
+            resolveHashCollisions(projectPath, options);
+        });
+    }
 }
 
 QString KatalogueDaemon::statusToString(ScanJob::Status status) const {
@@ -598,6 +1224,8 @@ QString KatalogueDaemon::statusToString(ScanJob::Status status) const {
         return QStringLiteral("pending");
     case ScanJob::Status::Running:
         return QStringLiteral("running");
+    case ScanJob::Status::Paused:
+        return QStringLiteral("paused");
     case ScanJob::Status::Finished:
         return QStringLiteral("finished");
     case ScanJob::Status::Cancelled:
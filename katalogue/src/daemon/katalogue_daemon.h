@@ -1,9 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <future>
 #include <memory>
 
+#include <QMutex>
 #include <QObject>
 #include <QThread>
+#include <QThreadPool>
 #include <QDBusContext>
 
 #include "katalogue_database.h"
@@ -14,6 +19,7 @@ struct ScanJob {
     enum class Status {
         Pending,
         Running,
+        Paused,
         Finished,
         Cancelled,
         Failed
@@ -26,7 +32,38 @@ struct ScanJob {
     VolumeInfo volumeInfo;
     ScanOptions options;
     bool existingVolume = false;
+    // Continue from the volume's scan checkpoint instead of starting over.
+    bool resume = false;
     QString errorString;
+    // Catalog the job writes to, fixed when it is started.
+    QString projectPath;
+    // JSON scan report, written when the job kept slow directories.
+    QString reportPath;
+    // Jobs on the same physical device run one after another on that
+    // device's lane; see deviceKeyForPath().
+    QString deviceKey;
+    // Each job has its own scanner so cancelling one leaves the others running.
+    std::shared_ptr<KatalogueScanner> scanner;
+};
+
+// A volume kept up to date from change notifications instead of rescans.
+struct VolumeWatch {
+    int volumeId = -1;
+    QString rootPath;
+    QString projectPath;
+    ScanOptions options;
+    int settleMs = 1000;
+    std::atomic_bool stop{false};
+    QThread *thread = nullptr;
+    // Cancelled together with stop so pending hashes do not hold it up.
+    std::shared_ptr<KatalogueScanner> scanner;
+    // Fulfilled by the watch thread once its catalog connection and
+    // watcher are up: empty on success, the reason otherwise.
+    std::promise<QString> started;
+    // Written by the watch thread; read under m_watchesMutex.
+    WatchBackend backend = WatchBackend::None;
+    qint64 changes = 0;
+    qint64 lastUpdate = 0;
 };
 
 class KatalogueDaemon : public QObject, protected QDBusContext {
@@ -42,7 +79,24 @@ public slots:
     QVariantMap OpenProject(const QString &path);
     QVariantMap GetProjectInfo() const;
     uint StartScan(const QString &rootPath);
+    // Per-job overrides on top of the settings: "io_priority" ("default",
+    // "best-effort", "idle"), "io_priority_level", "nice",
+    // "target_stat_latency_ms", "max_stats_per_second" and
+    // "progress_interval_ms" (time between ScanProgress signals),
+    // "slow_directory_count" (slowest/largest directories to report) and
+    // "one_file_system" (do not cross into other mounted filesystems).
+    uint StartScanWithOptions(const QString &rootPath, const QVariantMap &options);
     bool CancelScan(uint scanId);
+    bool PauseScan(uint scanId);
+    bool ResumeScan(uint scanId);
+    bool ResolveHashCollisions();
+    // Adds or drops the current catalog's trigram file name index in the
+    // background; SubstringIndexChanged reports the resulting state.
+    bool SetSubstringIndex(bool enabled);
+    // Compacts the current catalog in the background; CatalogCompacted
+    // reports the bytes reclaimed, or -1 on failure. GetProjectInfo's
+    // reclaimable_bytes tells whether it is worth it.
+    bool CompactCatalog();
     QVariantMap GetScanStatus(uint scanId) const;
     QVariantMap ListVolumes() const;
     QList<QVariantMap> ListDirectories(int volumeId, int parentId) const;
@@ -62,20 +116,59 @@ public slots:
     void AddFileToVirtualFolder(int folderId, int fileId);
     void RemoveFileFromVirtualFolder(int folderId, int fileId);
     void RenameVolume(int volumeId, const QString &newLabel);
+    // Keeps a scanned volume's catalog in sync with its root while it stays
+    // mounted at the path it was last scanned from.
+    bool WatchVolume(int volumeId);
+    bool UnwatchVolume(int volumeId);
+    QList<QVariantMap> ListWatches() const;
 
 signals:
-    void ScanProgress(uint scanId, const QString &path, int directories, int files, qint64 bytes);
+    void ScanProgress(uint scanId,
+                      const QString &path,
+                      int directories,
+                      int files,
+                      qint64 bytes);
+    // Sent right after each ScanProgress with the rate, estimate and
+    // throttle state of the scan.
+    void ScanStatistics(uint scanId, const QVariantMap &details);
     void ScanFinished(uint scanId, const QString &status);
+    void HashCollisionsResolved(int files);
+    void SubstringIndexChanged(bool enabled);
+    void CatalogCompacted(qint64 bytes);
+    void VolumeUpdated(int volumeId, int changes);
 
 private:
     void runScan(uint scanId);
+    void writeScanReport(uint scanId);
+    void resolveHashCollisions(const QString &projectPath, const ScanOptions &options);
+    void setSubstringIndex(const QString &projectPath, bool enabled);
+    void compactCatalog(const QString &projectPath);
+    void runWatch(const std::shared_ptr<VolumeWatch> &watch);
+    void runOnThread(QThread *thread, std::function<void()> task);
+    QThread *scanLane(const QString &deviceKey);
+    ScanOptions scanOptionsFromSettings() const;
     QString statusToString(ScanJob::Status status) const;
+    // Runs query on the reader pool and sends the D-Bus reply from there, so
+    // searches and listings neither block the bus nor wait for scan batches.
+    // Direct calls run it inline.
+    template<typename Result>
+    Result answerOnReader(std::function<Result()> query) const;
 
     KatalogueDatabase m_db;
+    // Browse, search and stats calls; each thread queries m_db through a
+    // read-only connection of its own. Declared after m_db so the threads,
+    // and their connections, are gone before it.
+    mutable QThreadPool m_readerPool;
     KatalogueSettings m_settings;
-    KatalogueScanner m_scanner;
-    QThread m_scanThread;
+    // Hash collision resolution, index changes and compaction; scans run
+    // on their device's lane.
+    QThread m_maintenanceThread;
+    QHash<QString, QThread *> m_scanLanes;
+    // Guards m_jobs, which the scan lanes update while D-Bus calls read it.
+    mutable QMutex m_jobsMutex;
     QHash<uint, ScanJob> m_jobs;
     uint m_nextScanId = 1;
+    mutable QMutex m_watchesMutex;
+    QHash<int, std::shared_ptr<VolumeWatch>> m_watches;
     QString m_projectPath;
 };
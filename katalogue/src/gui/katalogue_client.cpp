@@ -158,6 +158,18 @@ void KatalogueClient::setScannerMaxDepth(int depth) {
     emit settingsChanged();
 }
 
+int KatalogueClient::scannerWorkerThreads() const {
+    return m_settings.scannerWorkerThreads();
+}
+
+void KatalogueClient::setScannerWorkerThreads(int count) {
+    if (m_settings.scannerWorkerThreads() == count) {
+        return;
+    }
+    m_settings.setScannerWorkerThreads(count);
+    emit settingsChanged();
+}
+
 QString KatalogueClient::scannerExcludePatternsString() const {
     return m_settings.scannerExcludePatterns().join(QStringLiteral("\n"));
 }
@@ -524,6 +536,8 @@ void KatalogueClient::rebuildActiveScans() {
         entry.insert(QStringLiteral("directories"), static_cast<qulonglong>(info.directories));
         entry.insert(QStringLiteral("files"), static_cast<qulonglong>(info.files));
         entry.insert(QStringLiteral("bytes"), static_cast<qulonglong>(info.bytes));
+        entry.insert(QStringLiteral("statsPerSecond"), info.statsPerSecond);
+        entry.insert(QStringLiteral("etaSeconds"), info.etaSeconds);
         entry.insert(QStringLiteral("errorString"), info.errorString);
         list.append(entry);
     }
@@ -553,6 +567,21 @@ void KatalogueClient::onScanProgress(uint scanId,
     emit scanProgress(scanId, path, directories, files, bytes);
 }
 
+void KatalogueClient::onScanStatistics(uint scanId, const QVariantMap &details) {
+    auto it = m_scans.find(static_cast<int>(scanId));
+    if (it == m_scans.end()) {
+        return;
+    }
+    it->statsPerSecond = details.value(QStringLiteral("throttled")).toBool()
+                             ? details.value(QStringLiteral("stats_per_second")).toDouble()
+                             : -1;
+    const QVariant fraction = details.value(QStringLiteral("fraction_done"));
+    it->percent = fraction.isValid() ? qRound(fraction.toDouble() * 100) : -1;
+    it->etaSeconds = details.value(QStringLiteral("eta_seconds"), -1).toLongLong();
+    rebuildActiveScans();
+    emit activeScansChanged();
+}
+
 void KatalogueClient::onScanFinished(uint scanId, const QString &status) {
     const int id = static_cast<int>(scanId);
     if (!m_scans.contains(id)) {
@@ -567,6 +596,7 @@ void KatalogueClient::onScanFinished(uint scanId, const QString &status) {
     emit activeScansChanged();
     emit scanFinished(scanId, status);
     refreshVolumes();
+    refreshProjectInfo();
 }
 
 bool KatalogueClient::ensureInterface() {
@@ -596,6 +626,13 @@ void KatalogueClient::connectSignals() {
         QStringLiteral("ScanProgress"),
         this,
         SLOT(onScanProgress(uint,QString,int,int,qint64)));
+    QDBusConnection::sessionBus().connect(
+        QString::fromUtf8(kService),
+        QString::fromUtf8(kPath),
+        QString::fromUtf8(kInterface),
+        QStringLiteral("ScanStatistics"),
+        this,
+        SLOT(onScanStatistics(uint,QVariantMap)));
     QDBusConnection::sessionBus().connect(
         QString::fromUtf8(kService),
         QString::fromUtf8(kPath),
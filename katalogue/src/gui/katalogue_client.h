@@ -31,6 +31,7 @@ class KatalogueClient : public QObject {
     Q_PROPERTY(bool scannerFollowSymlinks READ scannerFollowSymlinks WRITE setScannerFollowSymlinks NOTIFY settingsChanged)
     Q_PROPERTY(bool scannerComputeHashes READ scannerComputeHashes WRITE setScannerComputeHashes NOTIFY settingsChanged)
     Q_PROPERTY(int scannerMaxDepth READ scannerMaxDepth WRITE setScannerMaxDepth NOTIFY settingsChanged)
+    Q_PROPERTY(int scannerWorkerThreads READ scannerWorkerThreads WRITE setScannerWorkerThreads NOTIFY settingsChanged)
     Q_PROPERTY(QString scannerExcludePatternsString READ scannerExcludePatternsString WRITE setScannerExcludePatternsString NOTIFY settingsChanged)
     Q_PROPERTY(bool uiConfirmVirtualFolderDelete READ uiConfirmVirtualFolderDelete WRITE setUiConfirmVirtualFolderDelete NOTIFY settingsChanged)
     Q_PROPERTY(QString appVersion READ appVersion CONSTANT)
@@ -63,6 +64,8 @@ public:
     void setScannerComputeHashes(bool value);
     int scannerMaxDepth() const;
     void setScannerMaxDepth(int depth);
+    int scannerWorkerThreads() const;
+    void setScannerWorkerThreads(int count);
     QString scannerExcludePatternsString() const;
     void setScannerExcludePatternsString(const QString &patterns);
     bool uiConfirmVirtualFolderDelete() const;
@@ -128,6 +131,10 @@ private:
         quint64 directories = 0;
         quint64 files = 0;
         quint64 bytes = 0;
+        // Stats per second reported by a throttled scan, -1 when not throttled.
+        double statsPerSecond = -1;
+        // Seconds left as estimated by the daemon, -1 when unknown.
+        qint64 etaSeconds = -1;
         QString errorString;
     };
 
@@ -136,7 +143,12 @@ private:
     void rebuildActiveScans();
 
 private slots:
-    void onScanProgress(uint scanId, const QString &path, int directories, int files, qint64 bytes);
+    void onScanProgress(uint scanId,
+                        const QString &path,
+                        int directories,
+                        int files,
+                        qint64 bytes);
+    void onScanStatistics(uint scanId, const QVariantMap &details);
     void onScanFinished(uint scanId, const QString &status);
 
 private:
@@ -177,6 +177,14 @@ Kirigami.ApplicationWindow {
                                               ? modelData["percent"] + "%"
                                               : ""
                                     }
+                                    Label {
+                                        visible: modelData["status"] === "running" && modelData["etaSeconds"] >= 0
+                                        text: qsTr("about %1 min left").arg(Math.ceil(modelData["etaSeconds"] / 60))
+                                    }
+                                    Label {
+                                        visible: modelData["statsPerSecond"] >= 0
+                                        text: qsTr("throttled to %1 stats/s").arg(Math.round(modelData["statsPerSecond"]))
+                                    }
                                     Button {
                                         text: qsTr("Cancel")
                                         visible: modelData["status"] === "running"
@@ -243,6 +251,13 @@ Kirigami.ApplicationWindow {
                                                             level: 3
                                                         }
 
+                                                        Kirigami.InlineMessage {
+                                                            width: parent.width
+                                                            type: Kirigami.MessageType.Warning
+                                                            visible: (KatalogueClient.projectInfo["stale_index_volumes"] || []).length > 0
+                                                            text: qsTr("Some volumes are still being indexed; their files may be missing from the results.")
+                                                        }
+
                                                         ListView {
                                                             width: parent.width
                                                             height: Math.min(200, contentHeight)
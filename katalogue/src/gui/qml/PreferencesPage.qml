@@ -47,6 +47,17 @@ Kirigami.ScrollablePage {
             }
         }
 
+        RowLayout {
+            spacing: Kirigami.Units.smallSpacing
+            Label { text: qsTr("Scanner threads (0 = automatic)") }
+            SpinBox {
+                from: 0
+                to: 64
+                value: KatalogueClient.scannerWorkerThreads
+                onValueModified: KatalogueClient.scannerWorkerThreads = value
+            }
+        }
+
         Label { text: qsTr("Exclude patterns (one per line, wildcards allowed)") }
         TextArea {
             text: KatalogueClient.scannerExcludePatternsString
@@ -1,10 +1,92 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <vector>
+
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDir>
 #include <QElapsedTimer>
+#include <QFile>
 #include <QTemporaryDir>
 
 #include "katalogue_database.h"
+#include "katalogue_scanner.h"
+
+// Resident set of this process right now, for the baseline a scan's
+// child starts from.
+static long currentRssKiB() {
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields.at(1).toLong() * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+}
+
+// Generates dirCount directories (fan-out 16, one file each) below root.
+static void makeTree(const QString &root, int dirCount) {
+    QStringList paths{QString()};
+    for (int d = 1; d < dirCount; ++d) {
+        paths.append(paths.at((d - 1) / 16) + QStringLiteral("/d%1").arg(d));
+    }
+    QDir dir(root);
+    for (const QString &path : std::as_const(paths)) {
+        dir.mkpath(root + path);
+        QFile file(root + path + QStringLiteral("/file.dat"));
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write("x");
+        }
+    }
+}
+
+// Scans a generated tree of dirCount directories and reports time and peak
+// RSS; the peak should not grow with dirCount. Each scan runs in a child
+// of its own, so its peak is not the high-water mark of an earlier one,
+// and the tree is built before the child starts.
+static void benchScan(int dirCount) {
+    QTemporaryDir tree;
+    QTemporaryDir dbDir;
+    if (!tree.isValid() || !dbDir.isValid()) {
+        qCritical() << "Failed to create temp dirs";
+        return;
+    }
+    makeTree(tree.path(), dirCount);
+
+    const long baseline = currentRssKiB();
+    const pid_t child = fork();
+    if (child < 0) {
+        qCritical() << "Failed to fork the scan";
+        return;
+    }
+    if (child == 0) {
+        KatalogueDatabase db;
+        if (!db.openProject(dbDir.filePath("scan.kdcatalog"))) {
+            qCritical() << "Failed to open project:" << db.lastErrorString();
+            _exit(1);
+        }
+        QElapsedTimer timer;
+        timer.start();
+        KatalogueScanner scanner;
+        if (!scanner.scan(tree.path(), db, {})) {
+            qWarning() << "Scan failed";
+            _exit(1);
+        }
+        qInfo() << "Scanned" << dirCount << "directories in" << timer.elapsed() << "ms";
+        // Skips the temporary directories' cleanup, which is the parent's.
+        _exit(0);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        qWarning() << "Scan of" << dirCount << "directories did not complete";
+        return;
+    }
+    qInfo() << "Scan of" << dirCount << "directories: peak RSS" << usage.ru_maxrss << "KiB,"
+            << usage.ru_maxrss - baseline << "KiB above the" << baseline << "KiB it started from";
+}
 
 static void benchInsert(KatalogueDatabase &db, int fileCount) {
     QElapsedTimer timer;
@@ -80,6 +162,79 @@ static void benchInsert(KatalogueDatabase &db, int fileCount) {
             << "(" << (fileCount * 1000 / qMax(insertMs, qint64(1))) << "files/sec)";
 }
 
+// Same tree as benchInsert() on a second volume, through the bulk inserts.
+static void benchBulkInsert(KatalogueDatabase &db, int fileCount) {
+    QElapsedTimer timer;
+    timer.start();
+
+    VolumeInfo volume;
+    volume.label = QStringLiteral("Bulk Bench Volume");
+    const int volumeId = db.upsertVolume(volume);
+    if (volumeId < 0) {
+        qCritical() << "Failed to create volume";
+        return;
+    }
+
+    std::vector<DirectoryInfo> dirs(1);
+    dirs[0].volumeId = volumeId;
+    dirs[0].name = QStringLiteral("/");
+    dirs[0].fullPath = QStringLiteral("/");
+    db.beginBatch();
+    if (!db.insertDirectories(dirs)) {
+        qCritical() << "Failed to create root directory";
+        db.endBatch();
+        return;
+    }
+    const int rootId = dirs[0].id;
+    const int dirCount = fileCount / 100;
+    dirs.resize(dirCount);
+    for (int d = 0; d < dirCount; ++d) {
+        dirs[d] = DirectoryInfo();
+        dirs[d].volumeId = volumeId;
+        dirs[d].parentId = rootId;
+        dirs[d].name = QStringLiteral("dir_%1").arg(d);
+        dirs[d].fullPath = QStringLiteral("/dir_%1").arg(d);
+    }
+    if (!db.insertDirectories(dirs)) {
+        qWarning() << "Bulk directory insert failed";
+    }
+    db.endBatch();
+    QList<int> dirIds{rootId};
+    for (const DirectoryInfo &dir : dirs) {
+        dirIds.append(dir.id);
+    }
+    qInfo() << "Bulk-created" << dirIds.size() << "directories in" << timer.elapsed() << "ms";
+
+    timer.restart();
+    std::vector<FileInfo> batch;
+    batch.reserve(500);
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    for (int i = 0; i < fileCount; ++i) {
+        FileInfo file;
+        file.directoryId = dirIds.at(i % dirIds.size());
+        file.name = QStringLiteral("file_%1.dat").arg(i);
+        file.size = (i % 1000) * 1024;
+        file.mtime = now;
+        file.fileType = QStringLiteral("application/octet-stream");
+        batch.push_back(std::move(file));
+
+        if (batch.size() == 500 || i == fileCount - 1) {
+            db.beginBatch();
+            const bool ok = db.insertFiles(batch);
+            db.endBatch();
+            batch.clear();
+            if (!ok) {
+                qWarning() << "Bulk insert failed at file" << i;
+                break;
+            }
+        }
+    }
+
+    const qint64 insertMs = timer.elapsed();
+    qInfo() << "Bulk-inserted" << fileCount << "files in" << insertMs << "ms"
+            << "(" << (fileCount * 1000 / qMax(insertMs, qint64(1))) << "files/sec)";
+}
+
 static void benchSearch(KatalogueDatabase &db) {
     QElapsedTimer timer;
     timer.start();
@@ -128,6 +283,10 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // Before any catalog is open here, so the scan children inherit none.
+    benchScan(2000);
+    benchScan(20000);
+
     const QString dbPath = tmp.filePath("bench.kdcatalog");
     KatalogueDatabase db;
     if (!db.openProject(dbPath)) {
@@ -136,6 +295,7 @@ int main(int argc, char *argv[]) {
     }
 
     benchInsert(db, fileCount);
+    benchBulkInsert(db, fileCount);
     benchSearch(db);
     benchListAllFiles(db);
     benchProjectStats(db);
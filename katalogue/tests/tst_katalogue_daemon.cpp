@@ -1,12 +1,15 @@
 #include <QtTest>
 
 #include "katalogue_daemon.h"
+#include "katalogue_device.h"
 
 class KatalogueDaemonTest : public QObject {
     Q_OBJECT
 private slots:
     void testScanAndSearch();
     void testEdgeCases();
+    void testPerJobCancellation();
+    void testCancelRightAfterStart();
 };
 
 void KatalogueDaemonTest::testScanAndSearch() {
@@ -71,6 +74,10 @@ void KatalogueDaemonTest::testEdgeCases() {
     const auto badStatus = daemon.GetScanStatus(99999);
     QCOMPARE(badStatus.value("status").toString(), QStringLiteral("unknown"));
 
+    // Pause/resume with invalid ID fail
+    QVERIFY(!daemon.PauseScan(99999));
+    QVERIFY(!daemon.ResumeScan(99999));
+
     // Search on empty catalog returns empty results
     const auto emptyResults = daemon.Search(QStringLiteral("anything"), -1, QString(), 50, 0);
     QVERIFY(emptyResults.isEmpty());
@@ -111,5 +118,77 @@ void KatalogueDaemonTest::testEdgeCases() {
     QVERIFY(daemon.GetFileTags(999).isEmpty());
 }
 
+void KatalogueDaemonTest::testPerJobCancellation() {
+    QTemporaryDir first;
+    QTemporaryDir second;
+    QVERIFY(first.isValid());
+    QVERIFY(second.isValid());
+    for (const QTemporaryDir *tmp : {&first, &second}) {
+        QFile file(QDir(tmp->path()).filePath("data.txt"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("hello");
+        file.close();
+    }
+
+    // Both directories live on the same filesystem, so they share a lane.
+    QVERIFY(!deviceKeyForPath(first.path()).isEmpty());
+    QCOMPARE(deviceKeyForPath(first.path()), deviceKeyForPath(second.path()));
+    QVERIFY(deviceKeyForPath(first.filePath("missing")).isEmpty());
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+
+    KatalogueDaemon daemon;
+    QVERIFY(daemon.OpenProject(dbDir.filePath("jobs.kdcatalog")).value("ok").toBool());
+
+    const uint firstId = daemon.StartScan(first.path());
+    const uint secondId = daemon.StartScan(second.path());
+    QVERIFY(firstId > 0);
+    QVERIFY(secondId > 0);
+    QVERIFY(daemon.CancelScan(firstId));
+
+    QElapsedTimer timer;
+    timer.start();
+    QString status;
+    while (timer.elapsed() < 10000) {
+        status = daemon.GetScanStatus(secondId).value("status").toString();
+        if (status == QLatin1String("finished") || status == QLatin1String("failed")) {
+            break;
+        }
+        QTest::qWait(50);
+    }
+    // Cancelling one job must not touch the other.
+    QCOMPARE(status, QStringLiteral("finished"));
+    QCOMPARE(daemon.GetScanStatus(firstId).value("status").toString(), QStringLiteral("cancelled"));
+    QCOMPARE(daemon.GetScanStatus(secondId).value("device").toString(), deviceKeyForPath(second.path()));
+}
+
+void KatalogueDaemonTest::testCancelRightAfterStart() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+    QDir dir(tmp.path());
+    QVERIFY(dir.mkpath("docs"));
+    QFile file(dir.filePath("docs/report.txt"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("hello");
+    file.close();
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+
+    KatalogueDaemon daemon;
+    QVERIFY(daemon.OpenProject(dbDir.filePath("cancel.kdcatalog")).value("ok").toBool());
+
+    // The cancel may land while the job is queued, opening the catalog or
+    // already scanning; in each case the scan must stop short.
+    const uint scanId = daemon.StartScan(tmp.path());
+    QVERIFY(scanId > 0);
+    QVERIFY(daemon.CancelScan(scanId));
+
+    QTest::qWait(500);
+    QCOMPARE(daemon.GetScanStatus(scanId).value("status").toString(), QStringLiteral("cancelled"));
+    QVERIFY(daemon.Search(QStringLiteral("report"), -1, QString(), 50, 0).isEmpty());
+}
+
 QTEST_MAIN(KatalogueDaemonTest)
 #include "tst_katalogue_daemon.moc"
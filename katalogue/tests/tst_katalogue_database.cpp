@@ -1,6 +1,11 @@
 #include <QtTest>
 
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <vector>
+
 #include "katalogue_database.h"
+#include "katalogue_ingest.h"
 
 class KatalogueDatabaseTest : public QObject {
     Q_OBJECT
@@ -11,6 +16,12 @@ private slots:
     void testNotesAndTags();
     void testVirtualFolders();
     void testProjectStatsAndListAllFiles();
+    void testIngestInventory();
+    void testReadersDuringBatch();
+    void testBulkInsert();
+    void testDeferredSearchIndex();
+    void testExternalContentIndex();
+    void testSubstringSearch();
 };
 
 void KatalogueDatabaseTest::testOpenProject() {
@@ -365,5 +376,352 @@ void KatalogueDatabaseTest::testProjectStatsAndListAllFiles() {
     QCOMPARE(vol2Files.first().fileName, QStringLiteral("file3.bin"));
 }
 
+void KatalogueDatabaseTest::testIngestInventory() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(tmp.filePath("ingest.kdcatalog")));
+
+    // find /data -printf '%p\t%s\t%T@\t%y\0', children before their parent,
+    // a tab in one name, a symlink and a malformed record; the last record
+    // has no terminator.
+    QByteArray inventory;
+    inventory += QByteArray("/data/docs/report.pdf\t2048\t1700000000.5\tf") + '\0';
+    inventory += QByteArray("/data/docs\t4096\t1700000000.0\td") + '\0';
+    inventory += QByteArray("/data\t4096\t1700000000.0\td") + '\0';
+    inventory += QByteArray("/data/a\tb.txt\t10\t1700000001\tf") + '\0';
+    inventory += QByteArray("/data/deep/er/notes.txt\t5\t1700000002\tf") + '\0';
+    inventory += QByteArray("/data/link\t7\t1700000003\tl") + '\0';
+    inventory += QByteArray("garbage") + '\0';
+    inventory += QByteArray("/data/empty\t4096\t1700000004\td");
+    QBuffer input(&inventory);
+    QVERIFY(input.open(QIODevice::ReadOnly));
+
+    VolumeInfo volume;
+    volume.label = QStringLiteral("Remote");
+    IngestOptions options;
+    options.stripPrefix = QStringLiteral("/data/");
+    InventoryIngester ingester;
+    QVERIFY(ingester.ingest(input, db, volume, options));
+
+    const IngestStats &stats = ingester.stats();
+    QCOMPARE(stats.records, qint64(8));
+    QCOMPARE(stats.files, qint64(3));
+    QCOMPARE(stats.totalBytes, qint64(2063));
+    QCOMPARE(stats.skipped, qint64(2));
+    QCOMPARE(stats.directories, 4);
+
+    const int volumeId = ingester.lastVolumeId();
+    QCOMPARE(db.getVolumeLabel(volumeId).value_or(QString()), QStringLiteral("Remote"));
+    const auto docs = db.findDirectoryByPath(volumeId, QStringLiteral("/docs"));
+    QVERIFY(docs.has_value());
+    const auto report = db.findFile(docs->id, QStringLiteral("report.pdf"));
+    QVERIFY(report.has_value());
+    QCOMPARE(report->size, qint64(2048));
+    QCOMPARE(report->mtime.toSecsSinceEpoch(), qint64(1700000000));
+    QCOMPARE(report->fileType, QStringLiteral("application/pdf"));
+    QVERIFY(db.findDirectoryByPath(volumeId, QStringLiteral("/deep/er")).has_value());
+    QVERIFY(db.findDirectoryByPath(volumeId, QStringLiteral("/empty")).has_value());
+    const auto root = db.findDirectoryByPath(volumeId, QStringLiteral("/"));
+    QVERIFY(root.has_value());
+    QVERIFY(db.findFile(root->id, QStringLiteral("a\tb.txt")).has_value());
+    QCOMPARE(db.listAllFiles(volumeId).size(), 3);
+
+    // A cancelled ingest leaves nothing behind, even after batches committed.
+    QByteArray large;
+    for (int i = 0; i < 20001; ++i) {
+        large += QByteArray("file") + QByteArray::number(i) + "\t1\t1700000000\tf\n";
+    }
+    QBuffer largeInput(&large);
+    QVERIFY(largeInput.open(QIODevice::ReadOnly));
+    IngestOptions lineOptions;
+    lineOptions.separator = '\n';
+    VolumeInfo cancelled;
+    cancelled.label = QStringLiteral("Cancelled");
+    QVERIFY(!ingester.ingest(largeInput, db, cancelled, lineOptions, [](const IngestStats &) { return false; }));
+    QCOMPARE(ingester.lastVolumeId(), -1);
+    QCOMPARE(db.listVolumes().size(), 1);
+    QVERIFY(db.staleSearchIndexVolumes().isEmpty());
+}
+
+void KatalogueDatabaseTest::testReadersDuringBatch() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+    const QString dbPath = tmp.filePath("readers.kdcatalog");
+
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbPath));
+    QVERIFY(QFileInfo::exists(dbPath + QStringLiteral("-wal")));
+
+    VolumeInfo committed;
+    committed.label = QStringLiteral("Committed");
+    QVERIFY(db.upsertVolume(committed) >= 0);
+
+    auto listFromOtherThread = [&db]() {
+        QList<VolumeInfo> volumes;
+        QThread *reader = QThread::create([&db, &volumes]() { volumes = db.listVolumes(); });
+        reader->start();
+        reader->wait();
+        delete reader;
+        return volumes;
+    };
+
+    // The writer's own thread sees its open batch; other threads read the
+    // last commit without waiting for it.
+    QVERIFY(db.beginBatch());
+    VolumeInfo pending;
+    pending.label = QStringLiteral("Pending");
+    QVERIFY(db.upsertVolume(pending) >= 0);
+    QCOMPARE(db.listVolumes().size(), 2);
+    const QList<VolumeInfo> duringBatch = listFromOtherThread();
+    QCOMPARE(duringBatch.size(), 1);
+    QCOMPARE(duringBatch.first().label, QStringLiteral("Committed"));
+
+    // A nested begin is refused without touching the open batch.
+    QVERIFY(!db.beginBatch());
+    QVERIFY(db.inBatch());
+
+    // Another connection waiting for the write turn is visible to the holder.
+    QVERIFY(!db.hasWaitingWriters());
+    bool otherCommitted = false;
+    QThread *writer = QThread::create([&dbPath, &otherCommitted]() {
+        KatalogueDatabase other;
+        otherCommitted = other.openProject(dbPath) && other.beginBatch() && other.endBatch();
+    });
+    writer->start();
+    QTRY_VERIFY(db.hasWaitingWriters());
+
+    QVERIFY(db.endBatch());
+    QVERIFY(!db.inBatch());
+    writer->wait();
+    delete writer;
+    QVERIFY(otherCommitted);
+    QCOMPARE(listFromOtherThread().size(), 2);
+}
+
+void KatalogueDatabaseTest::testBulkInsert() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(tmp.filePath("bulk.kdcatalog")));
+
+    VolumeInfo volume;
+    volume.label = QStringLiteral("Bulk");
+    const int volumeId = db.upsertVolume(volume);
+    QVERIFY(volumeId >= 0);
+
+    std::vector<DirectoryInfo> dirs(3);
+    const QStringList paths{QStringLiteral("/"), QStringLiteral("/b"), QStringLiteral("/a")};
+    for (int d = 0; d < 3; ++d) {
+        dirs[d].volumeId = volumeId;
+        dirs[d].name = paths.at(d).mid(1);
+        dirs[d].fullPath = paths.at(d);
+    }
+    QVERIFY(db.insertDirectories(dirs));
+    QVERIFY(dirs[0].id > 0 && dirs[1].id > 0 && dirs[2].id > 0);
+    QCOMPARE(db.findDirectoryByPath(volumeId, QStringLiteral("/a"))->id, dirs[2].id);
+
+    // More rows than one statement takes, in no particular order.
+    std::vector<FileInfo> files(150);
+    for (int i = 0; i < 150; ++i) {
+        files[i].directoryId = dirs[i % 2 + 1].id;
+        files[i].name = QStringLiteral("file_%1").arg(149 - i);
+        files[i].size = i;
+    }
+    QVERIFY(db.insertFiles(files));
+    QSet<int> ids;
+    for (const FileInfo &file : files) {
+        QVERIFY(file.id > 0);
+        ids.insert(file.id);
+    }
+    QCOMPARE(ids.size(), 150);
+    QCOMPARE(db.listFilesInDirectory(dirs[1].id).size(), 75);
+    QCOMPARE(db.findFile(dirs[2].id, QStringLiteral("file_0"))->id, files[149].id);
+
+    // Existing rows are updated in place and keep their ids.
+    std::vector<FileInfo> again{files[10]};
+    again[0].id = -1;
+    again[0].size = 4096;
+    QVERIFY(db.insertFiles(again));
+    QCOMPARE(again[0].id, files[10].id);
+    QCOMPARE(db.findFile(files[10].directoryId, files[10].name)->size, qint64(4096));
+
+    std::vector<DirectoryInfo> existing{dirs[1]};
+    existing[0].id = -1;
+    QVERIFY(db.insertDirectories(existing));
+    QCOMPARE(existing[0].id, dirs[1].id);
+
+    // Deleted rows leave free pages behind until the catalog is compacted.
+    QVERIFY(db.deleteVolume(volumeId));
+    QVERIFY(db.reclaimableBytes() > 0);
+    QVERIFY(db.compact());
+    QCOMPARE(db.reclaimableBytes(), qint64(0));
+}
+
+void KatalogueDatabaseTest::testDeferredSearchIndex() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(tmp.filePath("deferred.kdcatalog")));
+
+    VolumeInfo volume;
+    volume.label = QStringLiteral("Deferred");
+    const int volumeId = db.upsertVolume(volume);
+    QVERIFY(volumeId >= 0);
+    QVERIFY(db.setSearchIndexStale(volumeId));
+    QCOMPARE(db.staleSearchIndexVolumes(), QList<int>{volumeId});
+
+    DirectoryInfo root;
+    root.volumeId = volumeId;
+    root.name = QStringLiteral("/");
+    root.fullPath = QStringLiteral("/");
+    const int rootId = db.upsertDirectory(root);
+    QVERIFY(rootId >= 0);
+
+    std::vector<FileInfo> files(3);
+    for (int i = 0; i < 3; ++i) {
+        files[i].directoryId = rootId;
+        files[i].name = QStringLiteral("deferred_%1.txt").arg(i);
+    }
+    db.beginBatch();
+    QVERIFY(db.insertFiles(files));
+    db.endBatch();
+    QVERIFY(db.searchByName(QStringLiteral("deferred")).isEmpty());
+
+    QVERIFY(db.rebuildSearchIndex(volumeId));
+    QVERIFY(db.staleSearchIndexVolumes().isEmpty());
+    QCOMPARE(db.searchByName(QStringLiteral("deferred")).size(), 3);
+
+    // Rebuilding a volume that already has index rows replaces them.
+    QVERIFY(db.setSearchIndexStale(volumeId));
+    QVERIFY(db.rebuildSearchIndex(volumeId));
+    QCOMPARE(db.searchByName(QStringLiteral("deferred")).size(), 3);
+    // Unmarked volumes are left as they are.
+    QVERIFY(db.rebuildSearchIndex(volumeId));
+}
+
+void KatalogueDatabaseTest::testExternalContentIndex() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+    const QString dbPath = tmp.filePath("external.kdcatalog");
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbPath));
+
+    VolumeInfo volume;
+    volume.label = QStringLiteral("External");
+    const int volumeId = db.upsertVolume(volume);
+    QVERIFY(volumeId >= 0);
+
+    std::vector<DirectoryInfo> dirs(3);
+    const QStringList paths{QStringLiteral("/"), QStringLiteral("/photos"), QStringLiteral("/photos/raw")};
+    for (int d = 0; d < 3; ++d) {
+        dirs[d].volumeId = volumeId;
+        dirs[d].name = paths.at(d).mid(paths.at(d).lastIndexOf(QLatin1Char('/')) + 1);
+        dirs[d].fullPath = paths.at(d);
+    }
+    QVERIFY(db.insertDirectories(dirs));
+    std::vector<FileInfo> files(6);
+    for (int i = 0; i < 6; ++i) {
+        files[i].directoryId = dirs[i % 3].id;
+        files[i].name = QStringLiteral("holiday_%1.jpg").arg(i);
+    }
+    QVERIFY(db.insertFiles(files));
+    QCOMPARE(db.searchByName(QStringLiteral("holiday")).size(), 6);
+
+    // Deletes hand FTS5 the indexed values, including those of files a
+    // directory takes with it.
+    QVERIFY(db.deleteFile(files[0].id));
+    QVERIFY(db.deleteDirectory(dirs[2].id));
+    QCOMPARE(db.searchByName(QStringLiteral("holiday")).size(), 3);
+    QVERIFY(db.setSearchIndexStale(volumeId));
+    QVERIFY(db.deleteFile(files[1].id));
+    QVERIFY(db.rebuildSearchIndex(volumeId));
+    QCOMPARE(db.searchByName(QStringLiteral("holiday")).size(), 2);
+
+    {
+        QSqlDatabase raw = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("external-check"));
+        raw.setDatabaseName(dbPath);
+        QVERIFY(raw.open());
+        QSqlQuery query(raw);
+        QVERIFY(query.exec(QStringLiteral("INSERT INTO file_fts(file_fts, rank) VALUES ('integrity-check', 1)")));
+        // No shadow table holding a second copy of the names.
+        QVERIFY(query.exec(QStringLiteral("SELECT count(*) FROM sqlite_master WHERE name = 'file_fts_content'")));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 0);
+    }
+    QSqlDatabase::removeDatabase(QStringLiteral("external-check"));
+}
+
+void KatalogueDatabaseTest::testSubstringSearch() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(tmp.filePath("substring.kdcatalog")));
+
+    VolumeInfo volume;
+    volume.label = QStringLiteral("Camera");
+    const int volumeId = db.upsertVolume(volume);
+    QVERIFY(volumeId >= 0);
+    DirectoryInfo root;
+    root.volumeId = volumeId;
+    root.name = QStringLiteral("/");
+    root.fullPath = QStringLiteral("/");
+    const int rootId = db.upsertDirectory(root);
+    QVERIFY(rootId >= 0);
+
+    FileInfo photo;
+    photo.directoryId = rootId;
+    photo.name = QStringLiteral("DSC_2023_IMG0042.jpg");
+    QVERIFY(db.insertFile(photo) >= 0);
+
+    // The word index only matches from the start of a token.
+    QVERIFY(!db.hasSubstringIndex());
+    QVERIFY(db.searchByName(QStringLiteral("023_IMG")).isEmpty());
+
+    QVERIFY(db.setSubstringIndex(true));
+    QVERIFY(db.hasSubstringIndex());
+    QCOMPARE(db.searchByName(QStringLiteral("023_IMG")).size(), 1);
+    QCOMPARE(db.searchByName(QStringLiteral("mg004")).size(), 1);
+    QCOMPARE(db.searchByName(QStringLiteral("dsc")).size(), 1);
+    QVERIFY(db.searchByName(QStringLiteral("2023_IMG0043")).isEmpty());
+
+    // Kept up to date by the triggers, and deferred like the word index.
+    QVERIFY(db.setSearchIndexStale(volumeId));
+    FileInfo next;
+    next.directoryId = rootId;
+    next.name = QStringLiteral("DSC_2024_IMG0100.jpg");
+    QVERIFY(db.insertFile(next) >= 0);
+    QVERIFY(db.searchByName(QStringLiteral("024_IMG")).isEmpty());
+    QVERIFY(db.rebuildSearchIndex(volumeId));
+    QCOMPARE(db.searchByName(QStringLiteral("024_IMG")).size(), 1);
+    QCOMPARE(db.searchByName(QStringLiteral("_IMG0")).size(), 2);
+
+    // Two characters outside the BMP are four UTF-16 units but too short
+    // for a trigram, so they still go to the word index.
+    FileInfo wide;
+    wide.directoryId = rootId;
+    wide.name = QStringLiteral("\U00020000\U00020001 notes.txt");
+    QVERIFY(db.insertFile(wide) >= 0);
+    QCOMPARE(db.searchByName(QStringLiteral("\U00020000\U00020001")).size(), 1);
+
+    // Both indexes only hand over their first limit + offset candidates.
+    QCOMPARE(db.search(QStringLiteral("_IMG0"), {}, 1, 1).size(), 1);
+    QVERIFY(db.search(QStringLiteral("_IMG0"), {}, 1, 2).isEmpty());
+    KatalogueDatabase::SearchFilters otherVolume;
+    otherVolume.volumeId = volumeId + 1;
+    QVERIFY(db.search(QStringLiteral("_IMG0"), otherVolume, 10, 0).isEmpty());
+
+    // Another connection to the catalog notices the index going away.
+    KatalogueDatabase other;
+    QVERIFY(other.openProject(tmp.filePath("substring.kdcatalog")));
+    QVERIFY(other.hasSubstringIndex());
+
+    QVERIFY(db.setSubstringIndex(false));
+    QVERIFY(!db.hasSubstringIndex());
+    QVERIFY(!other.hasSubstringIndex());
+    QVERIFY(db.searchByName(QStringLiteral("023_IMG")).isEmpty());
+}
+
 QTEST_MAIN(KatalogueDatabaseTest)
 #include "tst_katalogue_database.moc"
@@ -1,15 +1,64 @@
 #include <QtTest>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "katalogue_database.h"
 #include "katalogue_scanner.h"
 
+namespace {
+
+bool writeFile(const QDir &dir, const QString &name, const QByteArray &content) {
+    QFile file(dir.filePath(name));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(content);
+    return true;
+}
+
+// Ids of every cataloged file, by file name.
+QHash<QString, int> fileIds(const KatalogueDatabase &db) {
+    QHash<QString, int> ids;
+    for (const auto &result : db.listAllFiles()) {
+        ids.insert(result.fileName, result.fileId);
+    }
+    return ids;
+}
+
+// Progress callback that keeps the last stats a scan reported.
+KatalogueScanner::ProgressCallback keepStats(ScanStats &stats) {
+    return [&stats](const QString &, const ScanStats &reported) {
+        stats = reported;
+        return true;
+    };
+}
+
+} // namespace
+
 class KatalogueScannerTest : public QObject {
     Q_OBJECT
 private slots:
     void testScanTree();
     void testMaxDepth();
     void testExcludePatterns();
+    void testExcludedDirectoriesArePruned();
     void testScanNonexistentPath();
+    void testParallelScan();
+    void testThrottledScan();
+    void testTimedProgress();
+    void testPhaseStatsAndSlowDirectories();
+    void testMountBoundaries();
+    void testNativeAndQtTraversalAgree();
+    void testOrderedTraversalsAgree();
+    void testIncrementalRescan();
+    void testQuickRescanSkipsUnchangedDirectories();
+    void testResumeFromCheckpoint();
+    void testApplyWatchChanges();
+    void testComputeHashes();
+    void testHardlinksCountedOnce();
+    void testSampledHashesResolveCollisions();
+    void testMimeDetectionTiers();
 };
 
 void KatalogueScannerTest::testScanTree() {
@@ -47,10 +96,14 @@ void KatalogueScannerTest::testScanTree() {
     ScanOptions options;
     options.includeHidden = false;
 
-    QVERIFY(scanner.scan(rootPath, db, {}, options));
+    VolumeInfo shelved;
+    shelved.physicalHint = QStringLiteral("Shelf A");
+    QVERIFY(scanner.scan(rootPath, db, shelved, options));
 
     const auto volumes = db.listVolumes();
     QCOMPARE(volumes.size(), 1);
+    QCOMPARE(volumes.first().physicalHint, QStringLiteral("Shelf A"));
+    QCOMPARE(volumes.first().rootPath, QFileInfo(rootPath).absoluteFilePath());
 
     const int volumeId = volumes.first().id;
     const auto roots = db.listDirectories(volumeId, -1);
@@ -130,6 +183,57 @@ void KatalogueScannerTest::testExcludePatterns() {
     QVERIFY(skipped.isEmpty());
 }
 
+void KatalogueScannerTest::testExcludedDirectoriesArePruned() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    QVERIFY(dir.mkpath("app/node_modules/left-pad"));
+    QVERIFY(dir.mkpath("build/obj"));
+    QVERIFY(dir.mkpath("src/build"));
+    const QStringList files = {
+        QStringLiteral("app/main.js"),
+        QStringLiteral("app/node_modules/left-pad/index.js"),
+        QStringLiteral("build/output.bin"),
+        QStringLiteral("build/obj/unit.o"),
+        QStringLiteral("src/build/generated.c"),
+        QStringLiteral("src/Notes.TMP"),
+    };
+    for (const QString &path : files) {
+        QFile file(dir.filePath(path));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("x");
+    }
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("prune.kdcatalog")));
+
+    KatalogueScanner scanner;
+    ScanOptions options;
+    options.excludePatterns = {QStringLiteral("node_modules"), QStringLiteral("/build/*"), QStringLiteral("*.tmp")};
+    QVERIFY(scanner.scan(rootPath, db, {}, options));
+
+    QVERIFY(!db.searchByName(QStringLiteral("main")).isEmpty());
+    QVERIFY(db.searchByName(QStringLiteral("index")).isEmpty());
+    QVERIFY(db.searchByName(QStringLiteral("left")).isEmpty());
+    // The anchored pattern empties the top-level build/ only.
+    QVERIFY(db.searchByName(QStringLiteral("output")).isEmpty());
+    QVERIFY(db.searchByName(QStringLiteral("unit")).isEmpty());
+    QVERIFY(!db.searchByName(QStringLiteral("generated")).isEmpty());
+    QVERIFY(db.searchByName(QStringLiteral("Notes")).isEmpty());
+
+    QStringList directories;
+    for (const auto &directory : db.listVolumeDirectories(db.listVolumes().first().id)) {
+        directories.append(directory.fullPath);
+    }
+    QVERIFY(directories.contains(QStringLiteral("/build")));
+    QVERIFY(!directories.contains(QStringLiteral("/build/obj")));
+    QVERIFY(!directories.contains(QStringLiteral("/app/node_modules")));
+}
+
 void KatalogueScannerTest::testScanNonexistentPath() {
     QTemporaryDir dbDir;
     QVERIFY(dbDir.isValid());
@@ -151,5 +255,782 @@ void KatalogueScannerTest::testScanNonexistentPath() {
     QVERIFY(!scanner.scan(f.fileName(), db, {}));
 }
 
+void KatalogueScannerTest::testParallelScan() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    for (int d = 0; d < 8; ++d) {
+        const QString sub = QStringLiteral("dir%1/nested").arg(d);
+        QVERIFY(dir.mkpath(sub));
+        for (int f = 0; f < 10; ++f) {
+            QFile file(dir.filePath(QStringLiteral("%1/item%2.txt").arg(sub).arg(f)));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("abc");
+            file.close();
+        }
+    }
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    const QString dbPath = dbDir.filePath("parallel.kdcatalog");
+
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbPath));
+
+    KatalogueScanner scanner;
+    ScanOptions options;
+    options.workerThreads = 4;
+
+    ScanStats finalStats;
+    QVERIFY(scanner.scan(rootPath, db, {}, options, keepStats(finalStats)));
+
+    QCOMPARE(finalStats.directories, 16);
+    QCOMPARE(finalStats.files, 80);
+    QCOMPARE(finalStats.totalBytes, qint64(240));
+
+    const auto all = db.listAllFiles();
+    QCOMPARE(all.size(), 80);
+    for (const auto &result : all) {
+        QVERIFY(result.fullPath.contains(QStringLiteral("/nested/item")));
+    }
+}
+
+void KatalogueScannerTest::testThrottledScan() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    for (int d = 0; d < 10; ++d) {
+        const QString sub = QStringLiteral("dir%1").arg(d);
+        QVERIFY(dir.mkpath(sub));
+        for (int f = 0; f < 40; ++f) {
+            QFile file(dir.filePath(QStringLiteral("%1/item%2.txt").arg(sub).arg(f)));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("abc");
+            file.close();
+        }
+    }
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+
+    // A fixed cap of 1000/s: the bucket lets a quarter second (250 stats)
+    // through at once, so the other 150 take at least ~150 ms.
+    {
+        KatalogueDatabase db;
+        QVERIFY(db.openProject(dbDir.filePath("capped.kdcatalog")));
+
+        KatalogueScanner scanner;
+        ScanOptions options;
+        options.workerThreads = 2;
+        options.maxStatsPerSecond = 1000;
+        options.ioPriority = IoPriorityClass::BestEffort;
+        options.ioPriorityLevel = 7;
+
+        ScanStats finalStats;
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(scanner.scan(rootPath, db, {}, options, keepStats(finalStats)));
+        QVERIFY(timer.elapsed() >= 100);
+        QCOMPARE(finalStats.files, 400);
+        QCOMPARE(finalStats.statRateLimit, 1000.0);
+    }
+
+    // An unreachable latency target throttles down to the floor rate but
+    // must still produce a complete catalog.
+    {
+        KatalogueDatabase db;
+        QVERIFY(db.openProject(dbDir.filePath("adaptive.kdcatalog")));
+
+        KatalogueScanner scanner;
+        ScanOptions options;
+        options.targetStatLatencyMs = 0.000001;
+        options.ioPriority = IoPriorityClass::Idle;
+        options.niceness = 5;
+
+        ScanStats finalStats;
+        QVERIFY(scanner.scan(rootPath, db, {}, options, keepStats(finalStats)));
+        QCOMPARE(finalStats.directories, 10);
+        QCOMPARE(finalStats.files, 400);
+        QCOMPARE(db.listAllFiles().size(), 400);
+    }
+}
+
+void KatalogueScannerTest::testTimedProgress() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    for (int f = 0; f < 100; ++f) {
+        QFile file(dir.filePath(QStringLiteral("slow%1.txt").arg(f)));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("abcd");
+    }
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("progress.kdcatalog")));
+
+    // Far fewer rows than a batch, but slow enough to span several intervals.
+    KatalogueScanner scanner;
+    ScanOptions options;
+    options.workerThreads = 1;
+    options.maxStatsPerSecond = 200;
+    options.progressIntervalMs = 50;
+    int calls = 0;
+    ScanStats finalStats;
+    QVERIFY(scanner.scan(rootPath, db, {}, options, [&](const QString &, const ScanStats &stats) {
+        ++calls;
+        finalStats = stats;
+        return true;
+    }));
+    QVERIFY(calls >= 3);
+    QCOMPARE(finalStats.files, 100);
+    QVERIFY(finalStats.elapsedMs > 0);
+    QVERIFY(finalStats.filesPerSecond > 0);
+    QCOMPARE(finalStats.bytesPerSecond, finalStats.filesPerSecond * 4);
+    // A directory below a mount point gives no usage-based estimate.
+    QCOMPARE(finalStats.fractionDone, -1.0);
+    QCOMPARE(finalStats.etaSeconds, qint64(-1));
+}
+
+void KatalogueScannerTest::testPhaseStatsAndSlowDirectories() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    const QList<int> sizes{3, 30, 10};
+    for (int d = 0; d < sizes.size(); ++d) {
+        const QString sub = QStringLiteral("dir%1").arg(d);
+        QVERIFY(dir.mkpath(sub));
+        for (int f = 0; f < sizes.at(d); ++f) {
+            QFile file(dir.filePath(QStringLiteral("%1/entry%2.txt").arg(sub).arg(f)));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("x");
+        }
+    }
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("phases.kdcatalog")));
+
+    KatalogueScanner scanner;
+    ScanOptions options;
+    options.slowDirectoryCount = 2;
+    ScanStats finalStats;
+    QVERIFY(scanner.scan(rootPath, db, {}, options, keepStats(finalStats)));
+
+    const ScanPhaseStats &phases = finalStats.phases;
+    QCOMPARE(phases.directoriesRead, 4);
+    QVERIFY(phases.stats >= 43);
+    QVERIFY(phases.readNs > 0);
+    QVERIFY(phases.writeNs > 0);
+    QVERIFY(phases.commits > 0);
+
+    QCOMPARE(finalStats.largestDirectories.size(), 2);
+    QCOMPARE(finalStats.largestDirectories.at(0).path, QStringLiteral("/dir1"));
+    QCOMPARE(finalStats.largestDirectories.at(0).entries, 30);
+    QCOMPARE(finalStats.largestDirectories.at(1).path, QStringLiteral("/dir2"));
+    QCOMPARE(finalStats.slowestDirectories.size(), 2);
+    QVERIFY(finalStats.slowestDirectories.at(0).wallNs >= finalStats.slowestDirectories.at(1).wallNs);
+
+    const QJsonObject report = QJsonDocument::fromJson(scanReportJson(finalStats)).object();
+    QCOMPARE(report.value("files").toInt(), 43);
+    QCOMPARE(report.value("phases").toObject().value("directoriesRead").toInt(), 4);
+    QCOMPARE(report.value("largestDirectories").toArray().first().toObject().value("path").toString(),
+             QStringLiteral("/dir1"));
+}
+
+void KatalogueScannerTest::testMountBoundaries() {
+    const QStringList skipped = defaultSkippedFilesystemTypes();
+    QVERIFY(MountTable::matchesType(QStringLiteral("proc"), skipped));
+    QVERIFY(MountTable::matchesType(QStringLiteral("fuse.sshfs"), skipped));
+    QVERIFY(!MountTable::matchesType(QStringLiteral("fuseblk"), skipped));
+    QVERIFY(!MountTable::matchesType(QStringLiteral("ext4"), skipped));
+    QVERIFY(!MountTable::matchesType(QString(), skipped));
+
+    const MountTable mounts;
+    struct stat procStat;
+    if (!mounts.isEmpty() && ::stat("/proc/self", &procStat) == 0) {
+        QCOMPARE(mounts.filesystemType(static_cast<quint64>(procStat.st_dev)), QStringLiteral("proc"));
+    }
+
+    // Nothing here crosses a mount, so both walkers must see everything.
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+    QDir dir(tmp.path());
+    QVERIFY(dir.mkpath("a/b"));
+    QFile file(dir.filePath("a/b/file.txt"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("x");
+    file.close();
+
+    for (const bool native : {true, false}) {
+        QTemporaryDir dbDir;
+        QVERIFY(dbDir.isValid());
+        KatalogueDatabase db;
+        QVERIFY(db.openProject(dbDir.filePath("mounts.kdcatalog")));
+
+        KatalogueScanner scanner;
+        ScanOptions options;
+        options.nativeTraversal = native;
+        options.oneFileSystem = true;
+        ScanStats finalStats;
+        QVERIFY(scanner.scan(tmp.path(), db, {}, options, keepStats(finalStats)));
+        QCOMPARE(finalStats.directories, 2);
+        QCOMPARE(finalStats.files, 1);
+        QVERIFY(finalStats.skippedMounts.isEmpty());
+    }
+}
+
+void KatalogueScannerTest::testNativeAndQtTraversalAgree() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    QVERIFY(dir.mkpath("photos/2023"));
+    QVERIFY(dir.mkpath(".cache"));
+
+    const QStringList files = {
+        QStringLiteral("photos/2023/DSC_0001.jpg"),
+        QStringLiteral("photos/readme.txt"),
+        QStringLiteral(".cache/blob"),
+        QStringLiteral("top.bin"),
+    };
+    for (const QString &name : files) {
+        QFile file(dir.filePath(name));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(name.toUtf8());
+        file.close();
+    }
+
+    auto scanWith = [&rootPath](bool native, bool ioUring) {
+        QTemporaryDir dbDir;
+        KatalogueDatabase db;
+        if (!dbDir.isValid() || !db.openProject(dbDir.filePath("walker.kdcatalog"))) {
+            return QStringList();
+        }
+        KatalogueScanner scanner;
+        ScanOptions options;
+        options.nativeTraversal = native;
+        options.ioUring = ioUring;
+        options.workerThreads = 2;
+        if (!scanner.scan(rootPath, db, {}, options)) {
+            return QStringList();
+        }
+        QStringList paths;
+        for (const auto &result : db.listAllFiles()) {
+            paths.append(result.fullPath + QLatin1Char(':') + QString::number(result.size));
+        }
+        paths.sort();
+        return paths;
+    };
+
+    const QStringList nativePaths = scanWith(true, false);
+    const QStringList qtPaths = scanWith(false, false);
+    QCOMPARE(nativePaths.size(), 3);
+    QCOMPARE(nativePaths, qtPaths);
+
+    // Falls back to synchronous statx where io_uring is unavailable, so the
+    // result must match either way.
+    QCOMPARE(scanWith(true, true), nativePaths);
+}
+
+void KatalogueScannerTest::testOrderedTraversalsAgree() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    for (int d = 0; d < 6; ++d) {
+        const QString sub = QStringLiteral("archive%1/disc%2").arg(d % 3).arg(d);
+        QVERIFY(dir.mkpath(sub));
+        for (int f = 0; f < 5; ++f) {
+            QFile file(dir.filePath(QStringLiteral("%1/track%2.flac").arg(sub).arg(f)));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(QByteArray(100 + f, char('a' + d)));
+            file.close();
+        }
+    }
+
+    auto scanWith = [&rootPath](TraversalOrder order) {
+        QTemporaryDir dbDir;
+        KatalogueDatabase db;
+        if (!dbDir.isValid() || !db.openProject(dbDir.filePath("ordered.kdcatalog"))) {
+            return QStringList();
+        }
+        KatalogueScanner scanner;
+        ScanOptions options;
+        options.traversalOrder = order;
+        options.computeHashes = true;
+        if (!scanner.scan(rootPath, db, {}, options)) {
+            return QStringList();
+        }
+        QStringList rows;
+        for (const auto &result : db.listAllFiles()) {
+            const auto files = db.listFilesInDirectory(result.directoryId);
+            for (const auto &file : files) {
+                if (file.id == result.fileId) {
+                    rows.append(result.fullPath + QLatin1Char(':') + file.hash);
+                }
+            }
+        }
+        rows.sort();
+        return rows;
+    };
+
+    const QStringList directoryOrder = scanWith(TraversalOrder::Directory);
+    QCOMPARE(directoryOrder.size(), 30);
+    for (const QString &row : directoryOrder) {
+        QVERIFY(row.contains(QStringLiteral(":xxh64:")));
+    }
+    QCOMPARE(scanWith(TraversalOrder::Inode), directoryOrder);
+    // Falls back to inode keys where FIEMAP is unsupported (tmpfs, overlays).
+    QCOMPARE(scanWith(TraversalOrder::Physical), directoryOrder);
+}
+
+void KatalogueScannerTest::testIncrementalRescan() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    QVERIFY(dir.mkpath("olddir"));
+
+    QVERIFY(writeFile(dir, QStringLiteral("keep.txt"), "a"));
+    QVERIFY(writeFile(dir, QStringLiteral("change.txt"), "b"));
+    QVERIFY(writeFile(dir, QStringLiteral("gone.txt"), "c"));
+    QVERIFY(writeFile(dir, QStringLiteral("olddir/inner.txt"), "d"));
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("incremental.kdcatalog")));
+
+    KatalogueScanner scanner;
+    QVERIFY(scanner.scan(rootPath, db, {}, {}));
+
+    const QHash<QString, int> before = fileIds(db);
+    QCOMPARE(before.size(), 4);
+    QVERIFY(db.setNoteForFile(before.value("keep.txt"), QStringLiteral("keep me")));
+
+    QVERIFY(writeFile(dir, QStringLiteral("change.txt"), "bbbb"));
+    QVERIFY(dir.remove("gone.txt"));
+    QVERIFY(QDir(dir.filePath("olddir")).removeRecursively());
+    QVERIFY(writeFile(dir, QStringLiteral("new.txt"), "e"));
+
+    ScanOptions options;
+    options.incremental = true;
+    ScanStats finalStats;
+    QVERIFY(scanner.scan(rootPath, db, db.listVolumes().first(), options, keepStats(finalStats)));
+
+    const QHash<QString, int> after = fileIds(db);
+    QCOMPARE(after.size(), 3);
+    QCOMPARE(after.value("keep.txt"), before.value("keep.txt"));
+    QCOMPARE(after.value("change.txt"), before.value("change.txt"));
+    QVERIFY(after.contains("new.txt"));
+    QCOMPARE(db.getNoteForFile(after.value("keep.txt")).value_or(QString()), QStringLiteral("keep me"));
+
+    const auto volumeId = db.listVolumes().first().id;
+    const auto roots = db.listDirectories(volumeId, -1);
+    QCOMPARE(roots.size(), 1);
+    QVERIFY(db.listDirectories(volumeId, roots.first().id).isEmpty());
+    QVERIFY(db.searchByName(QStringLiteral("inner")).isEmpty());
+
+    QCOMPARE(finalStats.added, 1);
+    QCOMPARE(finalStats.updated, 1);
+    QCOMPARE(finalStats.removed, 2);
+    QCOMPARE(finalStats.files, 3);
+}
+
+void KatalogueScannerTest::testQuickRescanSkipsUnchangedDirectories() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    QVERIFY(dir.mkpath("still"));
+    QVERIFY(dir.mkpath("busy"));
+
+    QVERIFY(writeFile(dir, QStringLiteral("still/old.txt"), "1"));
+    QVERIFY(writeFile(dir, QStringLiteral("busy/first.txt"), "2"));
+
+    // Directory stamps from the current second are not trusted.
+    QTest::qWait(1100);
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("quick.kdcatalog")));
+
+    KatalogueScanner scanner;
+    QVERIFY(scanner.scan(rootPath, db, {}, {}));
+
+    // Rewriting a file in place leaves its directory mtime alone, so a quick
+    // rescan keeps the catalog row; adding a file changes the directory.
+    QVERIFY(writeFile(dir, QStringLiteral("still/old.txt"), "changed"));
+    QVERIFY(writeFile(dir, QStringLiteral("busy/second.txt"), "3"));
+
+    ScanOptions options;
+    options.quickRescan = true;
+    ScanStats finalStats;
+    QVERIFY(scanner.scan(rootPath, db, db.listVolumes().first(), options, keepStats(finalStats)));
+
+    QHash<QString, qint64> sizes;
+    for (const auto &result : db.listAllFiles()) {
+        sizes.insert(result.fileName, result.size);
+    }
+    QCOMPARE(sizes.size(), 3);
+    QCOMPARE(sizes.value("old.txt"), qint64(1));
+    QVERIFY(sizes.contains("second.txt"));
+    QCOMPARE(finalStats.files, 3);
+    QCOMPARE(finalStats.added, 1);
+    QCOMPARE(finalStats.removed, 0);
+}
+
+void KatalogueScannerTest::testResumeFromCheckpoint() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    for (int d = 0; d < 20; ++d) {
+        const QString sub = QStringLiteral("dir%1").arg(d);
+        QVERIFY(dir.mkpath(sub));
+        for (int f = 0; f < 100; ++f) {
+            QFile file(dir.filePath(QStringLiteral("%1/file%2.txt").arg(sub).arg(f)));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("data");
+        }
+    }
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("resume.kdcatalog")));
+
+    // Stop after the first full batch, as if the drive went away.
+    KatalogueScanner scanner;
+    ScanOptions options;
+    options.progressIntervalMs = 0;
+    QVERIFY(!scanner.scan(rootPath, db, {}, options, [](const QString &, const ScanStats &stats) {
+        return stats.files < 500;
+    }));
+    const int volumeId = scanner.lastVolumeId();
+    QVERIFY(volumeId >= 0);
+    const auto checkpoint = db.scanCheckpoint(volumeId);
+    QVERIFY(checkpoint.has_value());
+    QCOMPARE(checkpoint->rootPath, QFileInfo(rootPath).absoluteFilePath());
+    QVERIFY(checkpoint->files > 0);
+    QVERIFY(db.projectStats()->fileCount < 2000);
+
+    ScanStats finalStats;
+    QVERIFY(scanner.resume(volumeId, db, {}, keepStats(finalStats)));
+    QCOMPARE(db.projectStats()->fileCount, qint64(2000));
+    QCOMPARE(db.listDirectories(volumeId, db.listDirectories(volumeId, -1).first().id).size(), 20);
+    QVERIFY(finalStats.files >= 2000);
+    QVERIFY(!db.scanCheckpoint(volumeId).has_value());
+
+    // Nothing left to resume.
+    QVERIFY(!scanner.resume(volumeId, db));
+}
+
+void KatalogueScannerTest::testApplyWatchChanges() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = QFileInfo(tmp.path()).canonicalFilePath();
+    QDir dir(rootPath);
+    QVERIFY(dir.mkpath("sub"));
+
+    QVERIFY(writeFile(dir, QStringLiteral("keep.txt"), "a"));
+    QVERIFY(writeFile(dir, QStringLiteral("change.txt"), "b"));
+    QVERIFY(writeFile(dir, QStringLiteral("sub/gone.txt"), "c"));
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("watch.kdcatalog")));
+
+    KatalogueScanner scanner;
+    QVERIFY(scanner.scan(rootPath, db, {}, {}));
+    const int volumeId = db.listVolumes().first().id;
+
+    const QHash<QString, int> before = fileIds(db);
+    QCOMPARE(before.size(), 3);
+
+    QVERIFY(writeFile(dir, QStringLiteral("change.txt"), "bbbb"));
+    QVERIFY(dir.remove("sub/gone.txt"));
+    QVERIFY(dir.mkpath("moved/deeper"));
+    QVERIFY(writeFile(dir, QStringLiteral("moved/deeper/inside.txt"), "d"));
+    QVERIFY(writeFile(dir, QStringLiteral("new.txt"), "e"));
+
+    // What a watcher reports for the above; the unchanged keep.txt and a
+    // path outside the root must be left alone.
+    WatchChanges changes;
+    changes.paths = {dir.filePath("change.txt"), dir.filePath("sub/gone.txt"), dir.filePath("moved"),
+                     dir.filePath("new.txt"), dir.filePath("keep.txt"), QStringLiteral("/elsewhere/file")};
+    QCOMPARE(scanner.applyChanges(volumeId, rootPath, changes, db, {}), 5);
+
+    const QHash<QString, int> after = fileIds(db);
+    QCOMPARE(after.size(), 5);
+    QCOMPARE(after.value("keep.txt"), before.value("keep.txt"));
+    QCOMPARE(after.value("change.txt"), before.value("change.txt"));
+    QVERIFY(after.contains("new.txt"));
+    QVERIFY(after.contains("inside.txt"));
+    QVERIFY(!after.contains("gone.txt"));
+    QVERIFY(db.findDirectoryByPath(volumeId, QStringLiteral("/moved/deeper")).has_value());
+    const auto root = db.findDirectoryByPath(volumeId, QStringLiteral("/"));
+    QVERIFY(root.has_value());
+    QCOMPARE(db.findFile(root->id, QStringLiteral("change.txt"))->size, qint64(4));
+
+    // A lost event queue ends in a rescan of the root.
+    QVERIFY(QDir(dir.filePath("moved")).removeRecursively());
+    changes.clear();
+    changes.subtrees.insert(rootPath);
+    QVERIFY(scanner.applyChanges(volumeId, rootPath, changes, db, {}) > 0);
+    QVERIFY(!db.findDirectoryByPath(volumeId, QStringLiteral("/moved")).has_value());
+    QCOMPARE(fileIds(db).size(), 3);
+
+#if defined(__linux__)
+    FilesystemWatcher watcher(rootPath);
+    if (!watcher.start()) {
+        QSKIP("No change notifications available");
+    }
+    QVERIFY(writeFile(dir, QStringLiteral("watched.txt"), "f"));
+    QElapsedTimer timer;
+    timer.start();
+    changes.clear();
+    QVERIFY(watcher.collect(changes, std::chrono::milliseconds(100),
+                            [&timer]() { return timer.hasExpired(5000); }));
+    QVERIFY(changes.paths.contains(dir.filePath("watched.txt")));
+    QCOMPARE(scanner.applyChanges(volumeId, watcher.rootPath(), changes, db, {}), 1);
+    QVERIFY(fileIds(db).contains("watched.txt"));
+#endif
+}
+
+void KatalogueScannerTest::testComputeHashes() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    const QList<QPair<QString, QByteArray>> files = {
+        {QStringLiteral("abc.txt"), QByteArray("abc")},
+        {QStringLiteral("copy.txt"), QByteArray("abc")},
+        {QStringLiteral("large.bin"), QByteArray(3 * 1024 * 1024 + 17, 'x')},
+    };
+    for (const auto &entry : files) {
+        QFile file(dir.filePath(entry.first));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(entry.second);
+    }
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("hashes.kdcatalog")));
+
+    KatalogueScanner scanner;
+    ScanOptions options;
+    options.computeHashes = true;
+    options.hashThreads = 2;
+    ScanStats finalStats;
+    QVERIFY(scanner.scan(rootPath, db, {}, options, keepStats(finalStats)));
+
+    const auto roots = db.listDirectories(db.listVolumes().first().id, -1);
+    QCOMPARE(roots.size(), 1);
+    QHash<QString, QString> hashes;
+    for (const auto &file : db.listFilesInDirectory(roots.first().id)) {
+        hashes.insert(file.name, file.hash);
+    }
+    // Reference XXH64 digest of "abc" with seed 0.
+    QCOMPARE(hashes.value("abc.txt"), QStringLiteral("xxh64:44bc2cf5ad770999"));
+    QCOMPARE(hashes.value("copy.txt"), hashes.value("abc.txt"));
+    QVERIFY(hashes.value("large.bin").startsWith(QStringLiteral("xxh64:")));
+    QCOMPARE(finalStats.hashedFiles, 3);
+    QCOMPARE(finalStats.hashedBytes, qint64(3 + 3 + 3 * 1024 * 1024 + 17));
+}
+
+void KatalogueScannerTest::testHardlinksCountedOnce() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    QVERIFY(dir.mkpath("snapshot.1"));
+    QFile original(dir.filePath("data.bin"));
+    QVERIFY(original.open(QIODevice::WriteOnly));
+    original.write(QByteArray(1000, 'x'));
+    original.close();
+    QFile single(dir.filePath("other.bin"));
+    QVERIFY(single.open(QIODevice::WriteOnly));
+    single.write(QByteArray(24, 'y'));
+    single.close();
+    QCOMPARE(::link(QFile::encodeName(dir.filePath("data.bin")).constData(),
+                    QFile::encodeName(dir.filePath("snapshot.1/data.bin")).constData()),
+             0);
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("hardlinks.kdcatalog")));
+
+    KatalogueScanner scanner;
+    ScanOptions options;
+    options.computeHashes = true;
+    ScanStats finalStats;
+    QVERIFY(scanner.scan(rootPath, db, {}, options, keepStats(finalStats)));
+
+    QCOMPARE(finalStats.files, 3);
+    QCOMPARE(finalStats.totalBytes, qint64(2024));
+    const auto stats = db.projectStats();
+    QVERIFY(stats.has_value());
+    QCOMPARE(stats->totalBytes, qint64(2024));
+#if !defined(__linux__)
+    QSKIP("Hardlinks are only recognized by the native walker");
+#endif
+    QCOMPARE(finalStats.uniqueBytes, qint64(1024));
+    QCOMPARE(stats->uniqueBytes, qint64(1024));
+    // The second link gets the digest of the first without being read again.
+    QCOMPARE(finalStats.hashedFiles, 2);
+
+    const int volumeId = db.listVolumes().first().id;
+    const auto roots = db.listDirectories(volumeId, -1);
+    QCOMPARE(roots.size(), 1);
+    QString rootHash;
+    for (const auto &file : db.listFilesInDirectory(roots.first().id)) {
+        if (file.name == QStringLiteral("data.bin")) {
+            QCOMPARE(file.linkCount, quint32(2));
+            QVERIFY(file.inode != 0);
+            rootHash = file.hash;
+        }
+    }
+    QVERIFY(!rootHash.isEmpty());
+    const auto snapshots = db.listDirectories(volumeId, roots.first().id);
+    QCOMPARE(snapshots.size(), 1);
+    const auto linked = db.listFilesInDirectory(snapshots.first().id);
+    QCOMPARE(linked.size(), 1);
+    QCOMPARE(linked.first().hash, rootHash);
+}
+
+void KatalogueScannerTest::testSampledHashesResolveCollisions() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    const QByteArray large(1024 * 1024, 'a');
+    // Differs from the others outside the head, middle and tail samples.
+    QByteArray different = large;
+    different[100 * 1024] = 'b';
+    const QList<QPair<QString, QByteArray>> files = {
+        {QStringLiteral("a.bin"), large},
+        {QStringLiteral("b.bin"), large},
+        {QStringLiteral("c.bin"), different},
+        {QStringLiteral("small.txt"), QByteArray("abc")},
+    };
+    for (const auto &entry : files) {
+        QFile file(dir.filePath(entry.first));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(entry.second);
+    }
+
+    QTemporaryDir dbDir;
+    QVERIFY(dbDir.isValid());
+    KatalogueDatabase db;
+    QVERIFY(db.openProject(dbDir.filePath("sampled.kdcatalog")));
+
+    KatalogueScanner scanner;
+    ScanOptions options;
+    options.computeHashes = true;
+    options.hashMode = HashMode::Sampled;
+    QVERIFY(scanner.scan(rootPath, db, {}, options));
+
+    const auto roots = db.listDirectories(db.listVolumes().first().id, -1);
+    QCOMPARE(roots.size(), 1);
+    auto filesByName = [&db, &roots]() {
+        QHash<QString, FileInfo> byName;
+        for (const auto &file : db.listFilesInDirectory(roots.first().id)) {
+            byName.insert(file.name, file);
+        }
+        return byName;
+    };
+
+    auto sampled = filesByName();
+    QVERIFY(!sampled.value("a.bin").fingerprint.isEmpty());
+    QCOMPARE(sampled.value("b.bin").fingerprint, sampled.value("a.bin").fingerprint);
+    QCOMPARE(sampled.value("c.bin").fingerprint, sampled.value("a.bin").fingerprint);
+    QVERIFY(sampled.value("a.bin").hash.isEmpty());
+    QCOMPARE(sampled.value("small.txt").hash, QStringLiteral("xxh64:44bc2cf5ad770999"));
+
+    QCOMPARE(scanner.resolveHashCollisions(db, options), 3);
+
+    const auto resolved = filesByName();
+    QVERIFY(!resolved.value("a.bin").hash.isEmpty());
+    QCOMPARE(resolved.value("b.bin").hash, resolved.value("a.bin").hash);
+    QVERIFY(resolved.value("c.bin").hash != resolved.value("a.bin").hash);
+}
+
+void KatalogueScannerTest::testMimeDetectionTiers() {
+    QTemporaryDir tmp;
+    QVERIFY(tmp.isValid());
+
+    const QString rootPath = tmp.path();
+    QDir dir(rootPath);
+    const QList<QPair<QString, QByteArray>> files = {
+        {QStringLiteral("photo.jpg"), QByteArray("not really a jpeg")},
+        {QStringLiteral("document"), QByteArray("%PDF-1.4\n%\xe2\xe3\xcf\xd3\n")},
+        {QStringLiteral("archive.tar.gz"), QByteArray("\x1f\x8b\x08\x00", 4)},
+    };
+    for (const auto &entry : files) {
+        QFile file(dir.filePath(entry.first));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(entry.second);
+    }
+
+    auto scanTypes = [&rootPath](MimeDetection detection) {
+        QTemporaryDir dbDir;
+        KatalogueDatabase db;
+        QHash<QString, QString> types;
+        if (!db.openProject(dbDir.filePath("mime.kdcatalog"))) {
+            return types;
+        }
+        KatalogueScanner scanner;
+        ScanOptions options;
+        options.mimeDetection = detection;
+        if (!scanner.scan(rootPath, db, {}, options)) {
+            return types;
+        }
+        const auto roots = db.listDirectories(db.listVolumes().first().id, -1);
+        for (const auto &file : db.listFilesInDirectory(roots.first().id)) {
+            types.insert(file.name, file.fileType);
+        }
+        return types;
+    };
+
+    // Extension-only never looks inside, so the extensionless PDF stays generic.
+    const auto byExtension = scanTypes(MimeDetection::Extension);
+    QCOMPARE(byExtension.value("photo.jpg"), QStringLiteral("image/jpeg"));
+    QCOMPARE(byExtension.value("document"), QStringLiteral("application/octet-stream"));
+    QCOMPARE(byExtension.value("archive.tar.gz"), QStringLiteral("application/x-compressed-tar"));
+
+    const auto automatic = scanTypes(MimeDetection::Auto);
+    QCOMPARE(automatic.value("photo.jpg"), QStringLiteral("image/jpeg"));
+    QCOMPARE(automatic.value("document"), QStringLiteral("application/pdf"));
+
+    const auto byContent = scanTypes(MimeDetection::Content);
+    QVERIFY(byContent.value("photo.jpg") != QStringLiteral("image/jpeg"));
+    QCOMPARE(byContent.value("document"), QStringLiteral("application/pdf"));
+}
+
 QTEST_MAIN(KatalogueScannerTest)
 #include "tst_katalogue_scanner.moc"